@@ -0,0 +1,135 @@
+/**
+ * \file clock.cpp
+ * \brief Coarse process-wide clock shared by all worker threads
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <atomic>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+#include <ipfixprobe/clock.hpp>
+
+namespace ipxp {
+
+static std::atomic<uint64_t> clock_real_ns(0);
+static std::atomic<uint64_t> clock_mono_ns(0);
+static std::atomic<bool> clock_running(false);
+static std::thread *clock_thread = nullptr;
+
+static uint64_t read_realtime()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_REALTIME, &ts);
+   return ts_from_nsec(ts.tv_sec, ts.tv_nsec);
+}
+
+static uint64_t read_monotonic()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return static_cast<uint64_t>(ts.tv_sec) * NANO_SEC + ts.tv_nsec;
+}
+
+static void timekeeper(uint32_t resolution)
+{
+   while (clock_running.load(std::memory_order_relaxed)) {
+      clock_real_ns.store(read_realtime(), std::memory_order_relaxed);
+      clock_mono_ns.store(read_monotonic(), std::memory_order_relaxed);
+      usleep(resolution);
+   }
+}
+
+void clock_start(uint32_t resolution)
+{
+   if (clock_thread != nullptr) {
+      return;
+   }
+   clock_real_ns.store(read_realtime());
+   clock_mono_ns.store(read_monotonic());
+   clock_running = true;
+   clock_thread = new std::thread(timekeeper, resolution);
+}
+
+void clock_stop()
+{
+   if (clock_thread == nullptr) {
+      return;
+   }
+   clock_running = false;
+   clock_thread->join();
+   delete clock_thread;
+   clock_thread = nullptr;
+}
+
+void clock_realtime(struct timeval *tv)
+{
+   timestamp_t ts = clock_realtime_ns();
+   tv->tv_sec = ts_sec(ts);
+   tv->tv_usec = ts_usec(ts);
+}
+
+timestamp_t clock_realtime_ns()
+{
+   if (!clock_running.load(std::memory_order_relaxed)) {
+      return read_realtime();
+   }
+   return clock_real_ns.load(std::memory_order_relaxed);
+}
+
+uint64_t clock_monotonic()
+{
+   if (!clock_running.load(std::memory_order_relaxed)) {
+      return read_monotonic();
+   }
+   return clock_mono_ns.load(std::memory_order_relaxed);
+}
+
+timestamp_t clock_realtime_precise_ns()
+{
+   return read_realtime();
+}
+
+uint64_t clock_monotonic_precise()
+{
+   return read_monotonic();
+}
+
+}
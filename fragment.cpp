@@ -0,0 +1,162 @@
+/**
+ * \file fragment.cpp
+ * \brief Table assigning transport ports to IP fragments
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstring>
+
+#include <ipfixprobe/fragment.hpp>
+
+namespace ipxp {
+
+#define FRAG_TABLE_ROW_SIZE 4 // entries of one row, colliding packets replace the oldest one
+
+FragmentTable::FragmentTable() : m_entries(nullptr), m_rows(0)
+{
+   set_size(FRAG_TABLE_DEFAULT_SIZE);
+}
+
+FragmentTable::~FragmentTable()
+{
+   delete[] m_entries;
+}
+
+void FragmentTable::set_size(uint32_t size)
+{
+   delete[] m_entries;
+   m_entries = nullptr;
+   m_rows = 0;
+   if (size == 0) {
+      return;
+   }
+
+   if (size > FRAG_TABLE_MAX_SIZE) {
+      size = FRAG_TABLE_MAX_SIZE;
+   }
+
+   // Number of rows is a power of two
+   uint64_t rows = 1;
+   while (rows * FRAG_TABLE_ROW_SIZE < size) {
+      rows <<= 1;
+   }
+   m_entries = new Entry[rows * FRAG_TABLE_ROW_SIZE]();
+   m_rows = rows;
+}
+
+FragmentTable::Entry *FragmentTable::get_row(const Packet &pkt) const
+{
+   uint32_t hash = pkt.ip_frag_id ^ (static_cast<uint32_t>(pkt.ip_proto) << 24);
+   if (pkt.ip_version == IP::v4) {
+      hash ^= pkt.src_ip.v4 * 0x85EBCA6B;
+      hash ^= pkt.dst_ip.v4 * 0xC2B2AE35;
+   } else {
+      const uint32_t *src = reinterpret_cast<const uint32_t *>(pkt.src_ip.v6);
+      const uint32_t *dst = reinterpret_cast<const uint32_t *>(pkt.dst_ip.v6);
+      hash ^= (src[0] ^ src[1] ^ src[2] ^ src[3]) * 0x85EBCA6B;
+      hash ^= (dst[0] ^ dst[1] ^ dst[2] ^ dst[3]) * 0xC2B2AE35;
+   }
+   hash ^= hash >> 16;
+   hash *= 0x9E3779B1;
+   hash ^= hash >> 15;
+   return &m_entries[(hash & (m_rows - 1)) * FRAG_TABLE_ROW_SIZE];
+}
+
+bool FragmentTable::match(const Entry &entry, const Packet &pkt)
+{
+   if (entry.id != pkt.ip_frag_id || entry.ip_proto != pkt.ip_proto || entry.ip_version != pkt.ip_version) {
+      return false;
+   }
+   if (pkt.ip_version == IP::v4) {
+      return entry.src_ip.v4 == pkt.src_ip.v4 && entry.dst_ip.v4 == pkt.dst_ip.v4;
+   }
+   return !memcmp(entry.src_ip.v6, pkt.src_ip.v6, sizeof(pkt.src_ip.v6)) &&
+      !memcmp(entry.dst_ip.v6, pkt.dst_ip.v6, sizeof(pkt.dst_ip.v6));
+}
+
+void FragmentTable::insert(const Packet &pkt)
+{
+   if (m_entries == nullptr) {
+      return;
+   }
+
+   Entry *row = get_row(pkt);
+   Entry *entry = &row[0];
+   for (unsigned i = 0; i < FRAG_TABLE_ROW_SIZE; i++) {
+      if (row[i].ip_version == 0 || match(row[i], pkt)) {
+         entry = &row[i];
+         break;
+      }
+      if (static_cast<int32_t>(row[i].ts - entry->ts) < 0) {
+         entry = &row[i];
+      }
+   }
+
+   entry->src_ip = pkt.src_ip;
+   entry->dst_ip = pkt.dst_ip;
+   entry->id = pkt.ip_frag_id;
+   entry->ts = ts_sec(pkt.ts);
+   entry->src_port = pkt.src_port;
+   entry->dst_port = pkt.dst_port;
+   entry->ip_version = pkt.ip_version;
+   entry->ip_proto = pkt.ip_proto;
+}
+
+bool FragmentTable::lookup(Packet &pkt)
+{
+   if (m_entries == nullptr) {
+      return false;
+   }
+
+   Entry *row = get_row(pkt);
+   for (unsigned i = 0; i < FRAG_TABLE_ROW_SIZE; i++) {
+      if (row[i].ip_version != 0 && match(row[i], pkt)) {
+         if (static_cast<uint32_t>(ts_sec(pkt.ts)) - row[i].ts > FRAG_TABLE_TIMEOUT) {
+            row[i].ip_version = 0;
+            return false;
+         }
+         pkt.src_port = row[i].src_port;
+         pkt.dst_port = row[i].dst_port;
+         return true;
+      }
+   }
+   return false;
+}
+
+}
@@ -0,0 +1,164 @@
+/**
+ * \file clock.hpp
+ * \brief Coarse process-wide clock shared by all worker threads
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_CLOCK_HPP
+#define IPXP_CLOCK_HPP
+
+#include <cstdint>
+#include <sys/time.h>
+
+namespace ipxp {
+
+#define CLOCK_DEFAULT_RESOLUTION 1000 /**< Default clock update period in microseconds. */
+
+#define NANO_SEC 1000000000ULL /**< Number of nanoseconds in second. */
+
+/**
+ * \brief Wall-clock timestamp in nanoseconds since Unix epoch.
+ *
+ * Used for packet and flow timestamps, 64 bits are enough until year 2554.
+ */
+typedef uint64_t timestamp_t;
+
+/**
+ * \brief Create timestamp from seconds and nanoseconds.
+ */
+inline timestamp_t ts_from_nsec(uint64_t sec, uint64_t nsec)
+{
+   return sec * NANO_SEC + nsec;
+}
+
+/**
+ * \brief Create timestamp from seconds and microseconds.
+ */
+inline timestamp_t ts_from_usec(uint64_t sec, uint64_t usec)
+{
+   return sec * NANO_SEC + usec * 1000;
+}
+
+/**
+ * \brief Create timestamp from timeval structure.
+ */
+inline timestamp_t ts_from_timeval(const struct timeval &tv)
+{
+   return ts_from_usec(tv.tv_sec, tv.tv_usec);
+}
+
+/**
+ * \brief Get whole seconds of timestamp.
+ */
+inline uint64_t ts_sec(timestamp_t ts)
+{
+   return ts / NANO_SEC;
+}
+
+/**
+ * \brief Get nanoseconds part of timestamp.
+ */
+inline uint32_t ts_nsec(timestamp_t ts)
+{
+   return ts % NANO_SEC;
+}
+
+/**
+ * \brief Get microseconds part of timestamp.
+ */
+inline uint32_t ts_usec(timestamp_t ts)
+{
+   return ts_nsec(ts) / 1000;
+}
+
+/**
+ * \brief Convert timestamp to milliseconds since Unix epoch.
+ */
+inline uint64_t ts_to_msec(timestamp_t ts)
+{
+   return ts / 1000000;
+}
+
+/**
+ * \brief Start timekeeper thread which periodically updates the coarse clock.
+ * \param [in] resolution Clock update period in microseconds.
+ */
+void clock_start(uint32_t resolution = CLOCK_DEFAULT_RESOLUTION);
+
+/**
+ * \brief Stop timekeeper thread.
+ */
+void clock_stop();
+
+/**
+ * \brief Get coarse wall-clock time.
+ *
+ * Value is read from memory when timekeeper thread is running, system clock is queried otherwise.
+ * \param [out] tv Current time.
+ */
+void clock_realtime(struct timeval *tv);
+
+/**
+ * \brief Get coarse wall-clock time as timestamp.
+ * \return Nanoseconds since Unix epoch.
+ */
+timestamp_t clock_realtime_ns();
+
+/**
+ * \brief Get coarse monotonic time.
+ * \return Nanoseconds from an unspecified starting point.
+ */
+uint64_t clock_monotonic();
+
+/**
+ * \brief Get precise wall-clock time, system clock is always queried.
+ * \return Nanoseconds since Unix epoch.
+ */
+timestamp_t clock_realtime_precise_ns();
+
+/**
+ * \brief Get precise monotonic time, system clock is always queried.
+ *
+ * For users which need finer time than the coarse clock resolution, e.g. packet pacing and short waits.
+ * \return Nanoseconds from the same starting point as clock_monotonic().
+ */
+uint64_t clock_monotonic_precise();
+
+}
+#endif /* IPXP_CLOCK_HPP */
@@ -53,6 +53,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <sys/time.h>
+#include <string>
 
 #ifdef WITH_NEMEA
 #include <unirec/unirec.h>
@@ -63,6 +64,7 @@
 
 #include <arpa/inet.h>
 #include "ipaddr.hpp"
+#include "clock.hpp"
 
 namespace ipxp {
 
@@ -261,8 +263,8 @@ struct Record {
  * \brief Flow record struct constaining basic flow record data and extension headers.
  */
 struct Flow : public Record {
-   struct timeval time_first;
-   struct timeval time_last;
+   timestamp_t time_first;
+   timestamp_t time_last;
    uint64_t src_bytes;
    uint64_t dst_bytes;
    uint32_t src_packets;
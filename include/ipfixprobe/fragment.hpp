@@ -0,0 +1,109 @@
+/**
+ * \file fragment.hpp
+ * \brief Table assigning transport ports to IP fragments
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_FRAGMENT_HPP
+#define IPXP_FRAGMENT_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "packet.hpp"
+
+namespace ipxp {
+
+#define FRAG_TABLE_DEFAULT_SIZE 8192 /**< Default number of tracked fragmented packets. */
+#define FRAG_TABLE_MAX_SIZE 1048576 /**< Maximal number of tracked fragmented packets. */
+#define FRAG_TABLE_TIMEOUT 30 /**< Time in seconds after which fragments are not assigned to the first fragment. */
+
+/**
+ * \brief Bounded table remembering transport ports of first fragments.
+ *
+ * Following fragments of the same packet get ports of the first fragment, so they are accounted to the right flow.
+ * Packets are not reassembled. Fragments received before the first fragment keep zero ports.
+ */
+class FragmentTable
+{
+public:
+   FragmentTable();
+   ~FragmentTable();
+
+   /**
+    * \brief Set maximal number of tracked packets and allocate the table.
+    * \param [in] size Number of packets up to FRAG_TABLE_MAX_SIZE, 0 disables tracking.
+    * \throw std::bad_alloc when the table can not be allocated.
+    */
+   void set_size(uint32_t size);
+
+   /**
+    * \brief Remember ports of first fragment.
+    * \param [in] pkt First fragment with parsed transport header.
+    */
+   void insert(const Packet &pkt);
+
+   /**
+    * \brief Assign ports of first fragment to following fragment.
+    * \param [in,out] pkt Following fragment.
+    * \return True when first fragment was found.
+    */
+   bool lookup(Packet &pkt);
+
+private:
+   struct Entry {
+      ipaddr_t src_ip;
+      ipaddr_t dst_ip;
+      uint32_t id;
+      uint32_t ts;
+      uint16_t src_port;
+      uint16_t dst_port;
+      uint8_t ip_version;
+      uint8_t ip_proto;
+   };
+
+   Entry *m_entries;
+   uint32_t m_rows;
+
+   Entry *get_row(const Packet &pkt) const;
+   static bool match(const Entry &entry, const Packet &pkt);
+};
+
+}
+#endif /* IPXP_FRAGMENT_HPP */
@@ -46,12 +46,27 @@
 #define IPXP_INPUT_HPP
 
 #include <string>
+#include <vector>
 
 #include "plugin.hpp"
 #include "packet.hpp"
+#include "fragment.hpp"
 
 namespace ipxp {
 
+/**
+ * \brief Result of packet parser, nonzero values are reasons of dropping malformed packets.
+ */
+enum ParserStatus : uint8_t {
+   PARSER_OK = 0,
+   PARSER_TRUNCATED_L2,    /**< Link layer, VLAN, TRILL, MPLS or PPPoE header is truncated */
+   PARSER_TRUNCATED_L3,    /**< IPv4, IPv6 or IPv6 extension header is truncated */
+   PARSER_TRUNCATED_L4,    /**< TCP, UDP, ICMP or ICMPv6 header is truncated */
+   PARSER_BAD_TCP_OPTIONS, /**< TCP options are malformed */
+   PARSER_BAD_HDR_LEN,     /**< Header length field points behind captured data */
+   PARSER_STATUS_CNT
+};
+
 /**
  * \brief Base class for packet receivers.
  */
@@ -69,11 +84,50 @@ public:
    uint64_t m_seen;
    uint64_t m_parsed;
    uint64_t m_dropped;
+   uint64_t m_malformed[PARSER_STATUS_CNT]; /**< Malformed packets indexed by ParserStatus. */
+   uint32_t m_payload_horizon; /**< Number of payload bytes passed to processing plugins. */
+   uint8_t m_decap_depth; /**< Number of tunnel headers to decapsulate. */
+   uint32_t m_queue_blocks; /**< Number of packet blocks passed to get() in turn, set before init(). */
+   uint32_t m_block_size; /**< Maximal number of packets in a packet block, set before init(). */
+   FragmentTable m_fragments; /**< Ports of fragmented packets seen by this plugin. */
 
-   InputPlugin() : m_seen(0), m_parsed(0), m_dropped(0) {}
+   InputPlugin() : m_seen(0), m_parsed(0), m_dropped(0), m_malformed(), m_payload_horizon(PAYLOAD_HORIZON_FULL),
+      m_decap_depth(0), m_queue_blocks(1), m_block_size(1) {}
    virtual ~InputPlugin() {}
 
    virtual Result get(PacketBlock &packets) = 0;
+
+   /**
+    * \brief Pass data held by the plugin when the probe is terminated.
+    * Called by input worker instead of get() after termination, until END_OF_FILE or ERROR is returned.
+    * \param [in,out] packets Block to fill.
+    * \return END_OF_FILE by default, the plugin holds no data.
+    */
+   virtual Result flush(PacketBlock &packets)
+   {
+      return Result::END_OF_FILE;
+   }
+
+   /**
+    * \brief Tell whether packet data point directly to capture buffers.
+    * Data of such packets are not zero terminated and stay valid until the block is passed to get() again.
+    * \return True when packets are not copied.
+    */
+   virtual bool zero_copy() const
+   {
+      return false;
+   }
+
+   /**
+    * \brief Split input plugin parameters into parameters of separate pipelines.
+    * Called on an uninitialized instance, each returned string is passed to init() of a new instance.
+    * \param [in] params Parameters given by user.
+    * \return Parameters of each pipeline, parameters are kept unchanged by default.
+    */
+   virtual std::vector<std::string> expand(const char *params) const
+   {
+      return {params ? params : ""};
+   }
 };
 
 }
@@ -46,6 +46,7 @@
 
 #include <arpa/inet.h>
 #include <sys/time.h>
+#include <ipfixprobe/clock.hpp>
 #include <cstring>
 #include <ipfixprobe/byte-utils.hpp>
 
@@ -65,14 +66,12 @@ public:
    ePEMNumber hdrEnterpriseNum;
 
 
-   static uint64_t Tv2Ts(timeval input);
-
    int32_t HeaderSize();
    int32_t FillBuffer(uint8_t *buffer, uint16_t *values, uint16_t len, uint16_t fieldID);
    int32_t FillBuffer(uint8_t *buffer, int16_t *values, uint16_t len, uint16_t fieldID);
    int32_t FillBuffer(uint8_t *buffer, uint32_t *values, uint16_t len, uint16_t fieldID);
    int32_t FillBuffer(uint8_t *buffer, int32_t *values, uint16_t len, uint16_t fieldID);
-   int32_t FillBuffer(uint8_t *buffer, struct timeval *values, uint16_t len, uint16_t fieldID);
+   int32_t FillBufferTs(uint8_t *buffer, timestamp_t *values, uint16_t len, uint16_t fieldID); /**< Timestamps are exported in milliseconds */
    int32_t FillBuffer(uint8_t *buffer, uint8_t *values, uint16_t len, uint16_t fieldID);
    int32_t FillBuffer(uint8_t *buffer, int8_t *values, uint16_t len, uint16_t fieldID);
 
@@ -70,10 +70,20 @@ namespace ipxp {
  */
 #define NTP_USEC_TO_FRAC(usec) (uint32_t)(((uint64_t) usec << 32) / 999999)
 
+/**
+ * Conversion from nanoseconds to NTP fraction. Fraction is rounded up for the same reason as in NTP_USEC_TO_FRAC.
+ */
+#define NTP_NSEC_TO_FRAC(nsec) (uint32_t)((((uint64_t) nsec << 32) + 999999999) / 1000000000)
+
 /**
  * Create 64 bit NTP timestamp which consist of 32 bit seconds part and 32 bit fraction part.
  */
-#define MK_NTP_TS(ts) (((uint64_t) (ts.tv_sec + EPOCH_DIFF) << 32) | (uint64_t) NTP_USEC_TO_FRAC(ts.tv_usec))
+#define MK_NTP_TS(ts) (((uint64_t) (ts_sec(ts) + EPOCH_DIFF) << 32) | (uint64_t) NTP_USEC_TO_FRAC(ts_usec(ts)))
+
+/**
+ * Create 64 bit NTP timestamp with nanosecond precision of fraction part.
+ */
+#define MK_NTP_TS_NSEC(ts) (((uint64_t) (ts_sec(ts) + EPOCH_DIFF) << 32) | (uint64_t) NTP_NSEC_TO_FRAC(ts_nsec(ts)))
 
 /**
  * Convert FIELD to its "attributes", i.e. BYTES(FIELD) used in the source code produces
@@ -87,10 +97,12 @@ namespace ipxp {
 #define BYTES_REV(F)                  F(29305,    1,    8,   &flow.dst_bytes)
 #define PACKETS(F)                    F(0,        2,    8,   (temp = (uint64_t) flow.src_packets, &temp))
 #define PACKETS_REV(F)                F(29305,    2,    8,   (temp = (uint64_t) flow.dst_packets, &temp))
-#define FLOW_START_MSEC(F)            F(0,      152,    8,   (temp = ((uint64_t) flow.time_first.tv_sec) * 1000 + (flow.time_first.tv_usec / 1000), &temp))
-#define FLOW_END_MSEC(F)              F(0,      153,    8,   (temp = ((uint64_t) flow.time_last.tv_sec) * 1000 + (flow.time_last.tv_usec / 1000), &temp))
+#define FLOW_START_MSEC(F)            F(0,      152,    8,   (temp = ts_to_msec(flow.time_first), &temp))
+#define FLOW_END_MSEC(F)              F(0,      153,    8,   (temp = ts_to_msec(flow.time_last), &temp))
 #define FLOW_START_USEC(F)            F(0,      154,    8,   (temp = MK_NTP_TS(flow.time_first), &temp))
 #define FLOW_END_USEC(F)              F(0,      155,    8,   (temp = MK_NTP_TS(flow.time_last), &temp))
+#define FLOW_START_NSEC(F)            F(0,      156,    8,   (temp = MK_NTP_TS_NSEC(flow.time_first), &temp))
+#define FLOW_END_NSEC(F)              F(0,      157,    8,   (temp = MK_NTP_TS_NSEC(flow.time_last), &temp))
 #define OBSERVATION_MSEC(F)           F(0,      323,    8,   nullptr)
 #define INPUT_INTERFACE(F)            F(0,       10,    2,   &this->dir_bit_field)
 #define OUTPUT_INTERFACE(F)           F(0,       14,    2,   nullptr)
@@ -283,12 +295,15 @@ namespace ipxp {
  * all of them defined above.
  */
 
-#ifdef IPXP_TS_MSEC
+#if defined(IPXP_TS_MSEC)
 #define FLOW_START   FLOW_START_MSEC
 #define FLOW_END     FLOW_END_MSEC
-#else
+#elif defined(IPXP_TS_USEC)
 #define FLOW_START   FLOW_START_USEC
 #define FLOW_END     FLOW_END_USEC
+#else
+#define FLOW_START   FLOW_START_NSEC
+#define FLOW_END     FLOW_END_NSEC
 #endif
 
 
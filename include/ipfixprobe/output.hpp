@@ -68,6 +68,15 @@ public:
 
    virtual void init(const char *params, Plugins &plugins) = 0;
 
+   /**
+    * \brief Check that flows extended by changed set of processing plugins can be exported.
+    * Called from the main thread when processing plugins are reloaded, must not modify state used by export_flow.
+    * \param [in] plugins New processing plugins.
+    */
+   virtual void check_plugins(Plugins &plugins)
+   {
+   }
+
    enum class Result {
       EXPORTED = 0,
       DROPPED
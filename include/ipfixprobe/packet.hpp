@@ -47,6 +47,7 @@
 #ifndef IPXP_PACKET_HPP
 #define IPXP_PACKET_HPP
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -55,78 +56,110 @@
 
 namespace ipxp {
 
+#define PAYLOAD_HORIZON_FULL UINT32_MAX /**< Whole captured payload is needed. */
+
 /**
- * \brief Structure for storing parsed packet fields
+ * \brief Types of decapsulated tunnels.
  */
-struct Packet : public Record {
-   struct timeval ts;
+enum TunnelType : uint8_t {
+   TUNNEL_NONE = 0,
+   TUNNEL_GRE,
+   TUNNEL_IPIP,
+   TUNNEL_VXLAN,
+   TUNNEL_GENEVE,
+   TUNNEL_GTPU
+};
 
-   uint8_t     dst_mac[6];
-   uint8_t     src_mac[6];
-   uint16_t    ethertype;
+#define PACKET_CLINE_SIZE 64 /**< Size of cache line holding hot packet fields. */
 
+/**
+ * \brief Structure for storing parsed packet fields
+ *
+ * Fields read by the flow cache for every packet are kept in the first cache line,
+ * fields used only by some process plugins follow. Packet is not polymorphic to keep it compact,
+ * arrays of packets should be allocated aligned to PACKET_CLINE_SIZE.
+ */
+struct Packet {
+   /* Hot fields: flow key, counters and timestamp */
+   timestamp_t ts;
+   ipaddr_t    src_ip;
+   ipaddr_t    dst_ip;
+   uint16_t    src_port;
+   uint16_t    dst_port;
    uint16_t    ip_len; /**< Length of IP header + its payload */
    uint16_t    ip_payload_len; /**< Length of IP payload */
    uint8_t     ip_version;
-   uint8_t     ip_ttl;
    uint8_t     ip_proto;
    uint8_t     ip_tos;
+   uint8_t     ip_ttl;
    uint8_t     ip_flags;
-   ipaddr_t    src_ip;
-   ipaddr_t    dst_ip;
-
-   uint16_t    src_port;
-   uint16_t    dst_port;
    uint8_t     tcp_flags;
-   uint16_t    tcp_window;
-   uint64_t    tcp_options;
-   uint32_t    tcp_mss;
-   uint32_t    tcp_seq;
-   uint32_t    tcp_ack;
+   bool        source_pkt; /**< Direction of packet from flow point of view */
+   bool        ip_frag; /**< Packet is a fragment of IP datagram */
 
+   /* Packet data and fields used by process plugins */
    uint8_t     *packet; /**< Pointer to begin of packet, if available */
+   uint8_t     *payload; /**< Pointer to begin of payload, if available */
    uint16_t    packet_len; /**< Length of data in packet buffer, packet_len <= packet_len_wire */
    uint16_t    packet_len_wire; /**< Original packet length on wire */
-
-   uint8_t     *payload; /**< Pointer to begin of payload, if available */
    uint16_t    payload_len; /**< Length of data in payload buffer, payload_len <= payload_len_wire */
    uint16_t    payload_len_wire; /**< Original payload length computed from headers */
-
-   uint8_t     *custom; /**< Pointer to begin of custom data, if available */
+   uint32_t    tcp_seq;
+   uint32_t    tcp_ack;
+   uint16_t    tcp_window;
+   uint16_t    ethertype;
+   uint8_t     dst_mac[6];
+   uint8_t     src_mac[6];
+   uint16_t    ip_frag_off; /**< Offset of fragment in bytes, ports are known only when zero */
+   uint8_t     tunnel_type; /**< Type of outermost decapsulated tunnel */
+   uint8_t     tunnel_depth; /**< Number of decapsulated tunnel headers, outer fields are valid when nonzero */
+   uint32_t    ip_frag_id; /**< Identification of fragmented IP datagram */
+   uint32_t    tunnel_id; /**< GRE key, VNI or TEID of outermost tunnel */
+   uint8_t     outer_ip_version;
+
+   /* Rarely used fields */
+   uint64_t    tcp_options;
+   uint32_t    tcp_mss;
    uint16_t    custom_len; /**< Length of data in custom buffer */
-
-   uint8_t     *buffer; /**< Buffer for packet, payload and custom data */
    uint16_t    buffer_size; /**< Size of buffer */
-
-   bool        source_pkt; /**< Direction of packet from flow point of view */
+   uint8_t     *custom; /**< Pointer to begin of custom data, if available */
+   uint8_t     *buffer; /**< Buffer for packet, payload and custom data */
+   ipaddr_t    outer_src_ip;
+   ipaddr_t    outer_dst_ip;
 
    /**
     * \brief Constructor.
     */
    Packet() :
-      ts({0}),
-      dst_mac(), src_mac(), ethertype(0),
-      ip_len(0), ip_payload_len(0), ip_version(0), ip_ttl(0),
-      ip_proto(0), ip_tos(0), ip_flags(0), src_ip({0}), dst_ip({0}),
-      src_port(0), dst_port(0), tcp_flags(0), tcp_window(0),
-      tcp_options(0), tcp_mss(0), tcp_seq(0), tcp_ack(0),
-      packet(nullptr), packet_len(0), packet_len_wire(0),
-      payload(nullptr), payload_len(0), payload_len_wire(0),
-      custom(nullptr), custom_len(0),
-      buffer(nullptr), buffer_size(0),
-      source_pkt(true)
+      ts(0), src_ip({0}), dst_ip({0}), src_port(0), dst_port(0),
+      ip_len(0), ip_payload_len(0), ip_version(0), ip_proto(0),
+      ip_tos(0), ip_ttl(0), ip_flags(0), tcp_flags(0),
+      source_pkt(true), ip_frag(false),
+      packet(nullptr), payload(nullptr),
+      packet_len(0), packet_len_wire(0), payload_len(0), payload_len_wire(0),
+      tcp_seq(0), tcp_ack(0), tcp_window(0), ethertype(0),
+      dst_mac(), src_mac(), ip_frag_off(0),
+      tunnel_type(TUNNEL_NONE), tunnel_depth(0), ip_frag_id(0), tunnel_id(0),
+      outer_ip_version(0),
+      tcp_options(0), tcp_mss(0), custom_len(0), buffer_size(0),
+      custom(nullptr), buffer(nullptr),
+      outer_src_ip({0}), outer_dst_ip({0})
    {
    }
 };
 
+static_assert(offsetof(Packet, ip_frag) < PACKET_CLINE_SIZE, "Hot packet fields must fit into a single cache line");
+
 struct PacketBlock {
    Packet *pkts;
    size_t cnt;
    size_t bytes;
    size_t size;
+   Flow *flows; /**< Flows aggregated by input plugin, valid until the block is passed to the plugin again. */
+   size_t flow_cnt;
 
    PacketBlock() :
-      pkts(nullptr), cnt(0), bytes(0), size(0)
+      pkts(nullptr), cnt(0), bytes(0), size(0), flows(nullptr), flow_cnt(0)
    {
    }
 };
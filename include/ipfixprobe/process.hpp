@@ -82,6 +82,26 @@ public:
       return nullptr;
    }
 
+   /**
+    * \brief Tell whether plugin parses payload as a zero terminated string.
+    * Such plugins cannot be used with zero-copy input plugins.
+    * \return True when packet data must be copied and terminated.
+    */
+   virtual bool needs_terminated_payload() const
+   {
+      return false;
+   }
+
+   /**
+    * \brief Get number of payload bytes inspected by plugin.
+    * Packets are copied only up to the largest horizon of enabled plugins.
+    * \return Number of bytes from the beginning of L4 payload or PAYLOAD_HORIZON_FULL.
+    */
+   virtual uint32_t get_payload_horizon() const
+   {
+      return PAYLOAD_HORIZON_FULL;
+   }
+
    /**
     * \brief Called before a new flow record is created.
     * \param [in] pkt Parsed packet.
@@ -105,6 +125,7 @@ public:
 
    /**
     * \brief Called before an existing record is update.
+    * \note Flows created before the plugin was loaded by a reload have no extension of this plugin.
     * \param [in,out] rec Reference to flow record.
     * \param [in,out] pkt Parsed packet.
     * \return 0 on success or FLOW_FLUSH option.
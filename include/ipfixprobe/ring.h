@@ -103,6 +103,17 @@ ipx_ring_destroy(ipx_ring_t *ring);
 IPX_API void
 ipx_ring_push(ipx_ring_t *ring, ipx_msg_t *msg);
 
+/**
+ * \brief Try to add a message into the ring buffer without waiting
+ *
+ * Same as ipx_ring_push(), but the function returns immediately when the buffer is full.
+ * \param[in] ring Ring buffer
+ * \param[in] msg  Message to be added into the ring buffer
+ * \return True if the message has been added, false if the buffer is full.
+ */
+IPX_API bool
+ipx_ring_try_push(ipx_ring_t *ring, ipx_msg_t *msg);
+
 /**
  * \brief Get a message from the ring buffer
  *
@@ -52,9 +52,18 @@
 #include "flowifc.hpp"
 #include "ring.h"
 #include "process.hpp"
+#include "clock.hpp"
 
 namespace ipxp {
 
+/**
+ * \brief Behaviour of a stage when its output queue is full.
+ */
+enum class QueuePolicy {
+   BLOCK, /**< Wait until there is space in the queue. */
+   DROP /**< Drop the newest record and count it. */
+};
+
 /**
  * \brief Base class for flow caches.
  */
@@ -62,13 +71,18 @@ class StoragePlugin : public Plugin
 {
 protected:
    ipx_ring_t *m_export_queue;
+   QueuePolicy m_queue_policy;
 
 private:
    ProcessPlugin **m_plugins; /**< Array of plugins. */
    uint32_t m_plugin_cnt;
 
 public:
-   StoragePlugin() : m_export_queue(nullptr), m_plugins(nullptr), m_plugin_cnt(0)
+   uint64_t m_qtime; /**< Time spent waiting for space in export queue [ns]. */
+   uint64_t m_qdropped; /**< Number of flows dropped because export queue was full. */
+
+   StoragePlugin() : m_export_queue(nullptr), m_queue_policy(QueuePolicy::BLOCK),
+      m_plugins(nullptr), m_plugin_cnt(0), m_qtime(0), m_qdropped(0)
    {
    }
 
@@ -86,6 +100,16 @@ public:
     */
    virtual int put_pkt(Packet &pkt) = 0;
 
+   /**
+    * \brief Export flow aggregated by input plugin, e.g. by kernel program.
+    * Process plugins are not called for such flows.
+    * \param [in] flow Flow without extensions, it is copied.
+    */
+   virtual void put_flow(const Flow &flow)
+   {
+      throw PluginError(get_name() + " storage does not accept flows aggregated by input plugin");
+   }
+
    /**
     * \brief Set export queue
     */
@@ -94,6 +118,14 @@ public:
       m_export_queue = queue;
    }
 
+   /**
+    * \brief Set behaviour when export queue is full
+    */
+   void set_queue_policy(QueuePolicy policy)
+   {
+      m_queue_policy = policy;
+   }
+
    /**
     * \brief Get export queue
     */
@@ -131,7 +163,40 @@ public:
       m_plugins[m_plugin_cnt++] = plugin;
    }
 
+   /**
+    * \brief Replace internal list of plugins.
+    * Previously added plugins are not destroyed, caller is responsible for them.
+    * \param [in] plugins New plugins.
+    */
+   void set_plugins(const std::vector<ProcessPlugin *> &plugins)
+   {
+      m_plugin_cnt = 0;
+      for (auto &it : plugins) {
+         add_plugin(it);
+      }
+   }
+
 protected:
+   /**
+    * \brief Push flow to export queue according to queue policy.
+    * \param [in] flow Flow to export.
+    * \return True when flow was queued, false when it was dropped.
+    */
+   bool export_queue_push(Flow *flow)
+   {
+      if (ipx_ring_try_push(m_export_queue, flow)) {
+         return true;
+      }
+      if (m_queue_policy == QueuePolicy::DROP) {
+         m_qdropped++;
+         return false;
+      }
+      uint64_t start = clock_monotonic_precise();
+      ipx_ring_push(m_export_queue, flow);
+      m_qtime += clock_monotonic_precise() - start;
+      return true;
+   }
+
    //Every StoragePlugin implementation should call these functions at appropriate places
 
    /**
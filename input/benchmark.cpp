@@ -43,13 +43,21 @@
 
 #include <random>
 #include <chrono>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <sys/time.h>
 
 #include "benchmark.hpp"
+#include "replay.hpp"
 #include <ipfixprobe/plugin.hpp>
 #include <ipfixprobe/utils.hpp>
 #include <ipfixprobe/packet.hpp>
+#include <ipfixprobe/clock.hpp>
 
 namespace ipxp {
 
@@ -59,9 +67,23 @@ __attribute__((constructor)) static void register_this_plugin()
    register_plugin(&rec);
 }
 
+/**
+ * \brief Pregenerated packets, packet data are zero except payload templates.
+ */
+struct BenchmarkPool {
+   std::vector<Packet> pkts;
+   std::vector<uint8_t> data;
+   uint32_t refs;
+};
+
+static std::mutex pools_mtx;
+static std::map<std::string, BenchmarkPool *> pools; /**< Shared pools indexed by generator settings */
+
 Benchmark::Benchmark()
    : m_generatePacketFunc(nullptr), m_flowMode(BenchmarkMode::FLOW_1), m_maxDuration(BENCHMARK_DEFAULT_DURATION), m_maxPktCnt(BENCHMARK_DEFAULT_PKT_CNT),
-     m_packetSizeFrom(BENCHMARK_DEFAULT_SIZE_FROM), m_packetSizeTo(BENCHMARK_DEFAULT_SIZE_TO), m_firstTs({0}), m_currentTs({0}), m_pktCnt(0)
+     m_packetSizeFrom(BENCHMARK_DEFAULT_SIZE_FROM), m_packetSizeTo(BENCHMARK_DEFAULT_SIZE_TO), m_firstTs(0), m_currentTs(0), m_pktCnt(0),
+     m_rate(0), m_started(0), m_ipv6(BENCHMARK_DEFAULT_IPV6), m_udp(BENCHMARK_DEFAULT_UDP),
+     m_poolSize(BENCHMARK_POOL_NONE), m_pool(nullptr), m_poolPos(0), m_poolPass(0), m_key(0), m_pipelines(1), m_index(0)
 {
 }
 
@@ -86,6 +108,8 @@ void Benchmark::init(const char *params)
    } else if (parser.m_mode == "nf") {
       m_flowMode = BenchmarkMode::FLOW_N;
       m_generatePacketFunc = &Benchmark::generatePacketFlowN;
+   } else if (parser.m_mode == "model") {
+      m_flowMode = BenchmarkMode::MODEL;
    } else {
       throw PluginError("invalid benchmark mode specified");
    }
@@ -97,24 +121,197 @@ void Benchmark::init(const char *params)
    if (m_packetSizeFrom < 64) {
       throw PluginError("minimal packet size is 64 bytes");
    }
+   if (parser.m_index >= parser.m_pipelines) {
+      throw PluginError("pipeline index must be lower than number of pipelines");
+   }
+   if (parser.m_pool && m_flowMode == BenchmarkMode::MODEL && parser.m_rate) {
+      throw PluginError("arrival rate of flows can not be used with packet pool");
+   }
+   m_pipelines = parser.m_pipelines;
+   m_index = parser.m_index;
+
+   m_poolSize = parser.m_pool;
+   if (m_poolSize && !parser.m_seed.empty()) {
+      const char delim = OptionsParser::DELIM;
+      m_poolId = parser.m_mode + delim + parser.m_seed + delim + std::to_string(parser.m_pkt_size) + delim +
+         std::to_string(parser.m_pool) + delim + std::to_string(parser.m_flows) + delim + std::to_string(parser.m_zipf) +
+         delim + std::to_string(parser.m_flow_len) + delim + std::to_string(parser.m_ipv6) + delim + std::to_string(parser.m_udp);
+   }
+
+   // Pipelines sharing pool generate the same packets, otherwise each pipeline generates different packets
+   if (!m_poolSize && m_index && !parser.m_seed.empty()) {
+      seedGenerator(parser.m_seed + OptionsParser::DELIM + std::to_string(m_index));
+   } else {
+      seedGenerator(parser.m_seed);
+   }
+   if (m_flowMode == BenchmarkMode::MODEL) {
+      initModel(parser);
+   }
+   m_firstTs = clock_realtime_ns();
+}
+
+void Benchmark::close()
+{
+   if (m_pool == nullptr) {
+      return;
+   }
+   std::lock_guard<std::mutex> lock(pools_mtx);
+   if (--m_pool->refs == 0) {
+      for (auto it = pools.begin(); it != pools.end(); ++it) {
+         if (it->second == m_pool) {
+            pools.erase(it);
+            break;
+         }
+      }
+      delete m_pool;
+   }
+   m_pool = nullptr;
+}
+
+std::vector<std::string> Benchmark::expand(const char *params) const
+{
+   BenchmarkOptParser parser;
+   try {
+      parser.parse(params);
+   } catch (ParserError &e) {
+      throw PluginError(e.what());
+   }
 
+   std::string args = params ? params : "";
+   if (parser.m_pipelines <= 1) {
+      return {args};
+   }
    if (parser.m_seed.empty()) {
+      // Pipelines share one seed, so they can share the pool
+      args += OptionsParser::DELIM;
+      args += "seed=" + std::to_string(std::random_device()());
+   }
+
+   std::vector<std::string> res;
+   for (uint16_t i = 0; i < parser.m_pipelines; i++) {
+      res.push_back(args + OptionsParser::DELIM + "index=" + std::to_string(i));
+   }
+   return res;
+}
+
+void Benchmark::seedGenerator(const std::string &seed)
+{
+   if (seed.empty()) {
       std::random_device rd;
       m_rndGen = std::mt19937(rd());
    } else {
-      std::seed_seq seed (parser.m_seed.begin(),parser.m_seed.end());
-      m_rndGen = std::mt19937(seed);
+      std::seed_seq seq(seed.begin(), seed.end());
+      m_rndGen = std::mt19937(seq);
    }
-   gettimeofday(&m_firstTs, nullptr);
 }
 
-void Benchmark::close()
+/**
+ * \brief Generate packets of the pool, or reuse pool generated with the same settings by other pipeline.
+ *
+ * Pool is private when seed is not given. Packets point to shared frames, frames with payload
+ * templates are stored once.
+ * \param [in] buffer_size Size of packet buffers, captured payload is limited the same way as without pool.
+ */
+void Benchmark::createPool(uint16_t buffer_size)
+{
+   std::lock_guard<std::mutex> lock(pools_mtx);
+   auto it = pools.find(m_poolId);
+   if (!m_poolId.empty() && it != pools.end()) {
+      m_pool = it->second;
+      m_pool->refs++;
+   } else {
+      m_pool = generatePool(buffer_size);
+      if (!m_poolId.empty()) {
+         pools[m_poolId] = m_pool;
+      }
+   }
+
+   // Flow table is needed only to generate the pool
+   std::vector<ModelFlow>().swap(m_flows);
+   std::vector<uint32_t>().swap(m_active);
+   std::vector<uint32_t>().swap(m_free);
+}
+
+BenchmarkPool *Benchmark::generatePool(uint16_t buffer_size)
+{
+   std::unique_ptr<BenchmarkPool> pool(new BenchmarkPool{{}, std::vector<uint8_t>(UINT16_MAX + 1), 1});
+   std::vector<uint8_t> frame(UINT16_MAX + 1);
+   std::map<std::string, size_t> frames;
+   std::vector<size_t> offsets;
+   Packet pkt;
+   pkt.buffer = frame.data();
+   pkt.buffer_size = buffer_size;
+   pool->pkts.reserve(m_poolSize);
+   offsets.reserve(m_poolSize);
+   for (uint64_t i = 0; i < m_poolSize; i++) {
+      if (m_flowMode == BenchmarkMode::MODEL) {
+         generatePacketModel(&pkt);
+      } else {
+         (this->*m_generatePacketFunc)(&pkt);
+      }
+
+      // Packets without payload template point to the zero frame at the start of data
+      size_t offset = 0;
+      uint8_t *end = frame.data() + pkt.packet_len;
+      if (std::find_if(frame.data(), end, [](uint8_t b){return b != 0;}) != end) {
+         std::string content(reinterpret_cast<const char *>(frame.data()), pkt.packet_len);
+         auto frame_it = frames.find(content);
+         if (frame_it == frames.end()) {
+            offset = pool->data.size();
+            pool->data.insert(pool->data.end(), frame.data(), end + 1);
+            frames[content] = offset;
+         } else {
+            offset = frame_it->second;
+         }
+         memset(frame.data(), 0, pkt.packet_len + 1);
+      }
+      offsets.push_back(offset);
+      pool->pkts.push_back(pkt);
+   }
+
+   for (size_t i = 0; i < pool->pkts.size(); i++) {
+      Packet &pkt = pool->pkts[i];
+      uint8_t *packet = pool->data.data() + offsets[i];
+      pkt.payload = packet + (pkt.payload - pkt.packet);
+      pkt.packet = packet;
+   }
+   return pool.release();
+}
+
+/**
+ * \brief Copy next packet of the pool. Addresses are changed in each pass, so flows of previous passes are not continued.
+ */
+void Benchmark::replayPacket(Packet *pkt)
 {
+   const std::vector<Packet> &pkts = m_pool->pkts;
+   if (m_poolPos == pkts.size()) {
+      m_poolPos = 0;
+      m_poolPass++;
+      if (m_flowMode != BenchmarkMode::FLOW_1) {
+         m_key = loop_key(m_poolPass * m_pipelines + m_index);
+      }
+   }
+
+   uint8_t *buffer = pkt->buffer;
+   uint16_t buffer_size = pkt->buffer_size;
+   *pkt = pkts[m_poolPos++];
+   pkt->buffer = buffer;
+   pkt->buffer_size = buffer_size;
+   pkt->ts = m_currentTs;
+   if (m_key) {
+      loop_rewrite(*pkt, m_key);
+   }
 }
 
 InputPlugin::Result Benchmark::get(PacketBlock &packets)
 {
-   gettimeofday(&m_currentTs, nullptr);
+   if (m_poolSize && m_pool == nullptr) {
+      // Pool is generated when size of packet buffers is known, generation is not included in duration
+      createPool(packets.pkts[0].buffer_size);
+      m_key = loop_key(m_index);
+      m_firstTs = clock_realtime_ns();
+   }
+   m_currentTs = clock_realtime_ns();
    InputPlugin::Result res = check_constraints();
    if (res != InputPlugin::Result::PARSED) {
       return res;
@@ -122,8 +319,19 @@ InputPlugin::Result Benchmark::get(PacketBlock &packets)
 
    packets.cnt = 0;
    packets.bytes = 0;
+   if (m_flowMode == BenchmarkMode::MODEL && m_pool == nullptr) {
+      startFlows();
+   }
    for (size_t i = 0; i < packets.size; i++) {
-      (this->*m_generatePacketFunc)(&(packets.pkts[i]));
+      if (m_pool != nullptr) {
+         replayPacket(&(packets.pkts[i]));
+      } else if (m_flowMode == BenchmarkMode::MODEL) {
+         if (!generatePacketModel(&(packets.pkts[i]))) {
+            break;
+         }
+      } else {
+         (this->*m_generatePacketFunc)(&(packets.pkts[i]));
+      }
       packets.cnt++;
       packets.bytes += packets.pkts[i].packet_len_wire;
       m_pktCnt++;
@@ -133,13 +341,16 @@ InputPlugin::Result Benchmark::get(PacketBlock &packets)
    }
    m_seen += packets.cnt;
    m_parsed += packets.cnt;
+   if (!packets.cnt) {
+      // Waiting for arrival of new flows
+      return InputPlugin::Result::TIMEOUT;
+   }
    return res;
 }
 
 InputPlugin::Result Benchmark::check_constraints() const
 {
-   int tmp = m_currentTs.tv_usec - m_firstTs.tv_usec ;
-   uint64_t duration = m_currentTs.tv_sec - m_firstTs.tv_sec + (tmp < 0 ? -1 : 0);
+   uint64_t duration = ts_sec(m_currentTs - m_firstTs);
 
    if ((m_maxPktCnt != BENCHMARK_PKT_CNT_INF && m_pktCnt >= m_maxPktCnt) ||
        (m_maxDuration != BENCHMARK_DURATION_INF && duration >= m_maxDuration)) {
@@ -228,4 +439,297 @@ void Benchmark::generatePacketFlowN(Packet *pkt)
    generatePacket(pkt);
 }
 
+static void push16(std::vector<uint8_t> &data, uint16_t val)
+{
+   data.push_back(val >> 8);
+   data.push_back(val & 0xFF);
+}
+
+static void push_str(std::vector<uint8_t> &data, const char *str)
+{
+   data.insert(data.end(), str, str + strlen(str));
+}
+
+/**
+ * \brief Prepend length of data written after position pos.
+ */
+static void insert_len(std::vector<uint8_t> &data, size_t pos, uint8_t bytes)
+{
+   size_t len = data.size() - pos;
+   for (uint8_t i = 0; i < bytes; i++) {
+      data.insert(data.begin() + pos, (len >> (8 * i)) & 0xFF);
+   }
+}
+
+static void push_dns_name(std::vector<uint8_t> &data, const char *name)
+{
+   while (*name) {
+      const char *dot = strchr(name, '.');
+      size_t len = dot ? dot - name : strlen(name);
+      data.push_back(len);
+      data.insert(data.end(), name, name + len);
+      name += len + (dot ? 1 : 0);
+   }
+   data.push_back(0);
+}
+
+/**
+ * \brief Prepare traffic model: payload templates, distribution of flow sizes and initial flows.
+ */
+void Benchmark::initModel(const BenchmarkOptParser &parser)
+{
+   const char *host = "www.example.com";
+
+   push_str(m_httpRequest, "GET /index.html HTTP/1.1\r\nHost: ");
+   push_str(m_httpRequest, host);
+   push_str(m_httpRequest, "\r\nUser-Agent: ipfixprobe-benchmark\r\nAccept: */*\r\n\r\n");
+   push_str(m_httpResponse, "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: 65536\r\n\r\n");
+
+   // TLS 1.3 ClientHello with SNI and ALPN extensions
+   std::vector<uint8_t> &ch = m_tlsClientHello;
+   push16(ch, 0x0303);
+   for (uint8_t i = 0; i < 32; i++) {
+      ch.push_back(i);
+   }
+   ch.push_back(0); // session id
+   push16(ch, 6);
+   push16(ch, 0x1301); push16(ch, 0x1302); push16(ch, 0xC02F);
+   ch.push_back(1); ch.push_back(0); // compression
+   size_t ext = ch.size();
+   push16(ch, 0x0000); // server_name
+   size_t sni = ch.size();
+   size_t list = ch.size();
+   ch.push_back(0);
+   size_t name = ch.size();
+   push_str(ch, host);
+   insert_len(ch, name, 2);
+   insert_len(ch, list, 2);
+   insert_len(ch, sni, 2);
+   push16(ch, 0x0010); // application_layer_protocol_negotiation
+   size_t alpn = ch.size();
+   size_t protos = ch.size();
+   ch.push_back(2); push_str(ch, "h2");
+   ch.push_back(8); push_str(ch, "http/1.1");
+   insert_len(ch, protos, 2);
+   insert_len(ch, alpn, 2);
+   push16(ch, 0x002B); push16(ch, 3); ch.push_back(2); push16(ch, 0x0304); // supported_versions
+   insert_len(ch, ext, 2);
+   ch.insert(ch.begin(), 0x01); // handshake type
+   insert_len(ch, 1, 3);
+   insert_len(ch, 0, 2);
+   ch.insert(ch.begin(), {0x16, 0x03, 0x01});
+
+   push16(m_dnsQuery, 0x1234);
+   push16(m_dnsQuery, 0x0100);
+   push16(m_dnsQuery, 1); push16(m_dnsQuery, 0); push16(m_dnsQuery, 0); push16(m_dnsQuery, 0);
+   push_dns_name(m_dnsQuery, host);
+   push16(m_dnsQuery, 1); push16(m_dnsQuery, 1); // A IN
+   m_dnsResponse = m_dnsQuery;
+   m_dnsResponse[2] = 0x81; m_dnsResponse[3] = 0x80;
+   m_dnsResponse[7] = 1; // answers
+   push16(m_dnsResponse, 0xC00C); push16(m_dnsResponse, 1); push16(m_dnsResponse, 1);
+   push16(m_dnsResponse, 0); push16(m_dnsResponse, 3600); push16(m_dnsResponse, 4);
+   push16(m_dnsResponse, 0x5DB8); push16(m_dnsResponse, 0xD822);
+
+   // Probability of k data packets is proportional to 1 / k^s
+   m_zipfCdf.resize(parser.m_flow_len);
+   double sum = 0;
+   for (uint32_t k = 1; k <= parser.m_flow_len; k++) {
+      sum += 1.0 / std::pow(k, parser.m_zipf);
+      m_zipfCdf[k - 1] = sum;
+   }
+   for (auto &it : m_zipfCdf) {
+      it /= sum;
+   }
+
+   m_rate = parser.m_rate;
+   m_ipv6 = parser.m_ipv6;
+   m_udp = parser.m_udp;
+   m_flows.resize(parser.m_flows);
+   for (uint32_t i = parser.m_flows; i > 0; i--) {
+      m_free.push_back(i - 1);
+   }
+   if (!m_rate) {
+      while (!m_free.empty()) {
+         uint32_t idx = m_free.back();
+         m_free.pop_back();
+         startFlow(idx);
+      }
+   }
+}
+
+/**
+ * \brief Start flows which arrived since the last call when arrival rate is set.
+ * Arrivals are lost when all flows are active.
+ */
+void Benchmark::startFlows()
+{
+   if (!m_rate) {
+      return;
+   }
+   uint64_t arrived = static_cast<uint64_t>(static_cast<double>(m_currentTs - m_firstTs) * m_rate / NANO_SEC);
+   for (; m_started < arrived; m_started++) {
+      if (m_free.empty()) {
+         m_started = arrived;
+         break;
+      }
+      uint32_t idx = m_free.back();
+      m_free.pop_back();
+      startFlow(idx);
+   }
+}
+
+void Benchmark::startFlow(uint32_t idx)
+{
+   std::uniform_int_distribution<uint32_t> distrib;
+   ModelFlow &flow = m_flows[idx];
+   Packet &fwd = flow.fwd;
+   bool udp = distrib(m_rndGen) % 100 < m_udp;
+
+   fwd = Packet();
+   if (distrib(m_rndGen) % 100 < m_ipv6) {
+      fwd.ethertype = 0x86DD;
+      fwd.ip_version = IP::v6;
+      for (int i = 0; i < 4; i++) {
+         reinterpret_cast<uint32_t *>(fwd.src_ip.v6)[i] = distrib(m_rndGen);
+         reinterpret_cast<uint32_t *>(fwd.dst_ip.v6)[i] = distrib(m_rndGen);
+      }
+   } else {
+      fwd.ethertype = 0x0800;
+      fwd.ip_version = IP::v4;
+      fwd.src_ip.v4 = distrib(m_rndGen);
+      fwd.dst_ip.v4 = distrib(m_rndGen);
+   }
+   fwd.src_port = 1024 + distrib(m_rndGen) % (65536 - 1024);
+   fwd.ip_ttl = 64;
+   fwd.ip_flags = 0x2; // DF
+   fwd.src_mac[5] = 1;
+   fwd.dst_mac[5] = 2;
+   if (udp) {
+      flow.app = ModelFlow::App::DNS;
+      fwd.ip_proto = IPPROTO_UDP;
+      fwd.dst_port = 53;
+   } else {
+      flow.app = distrib(m_rndGen) & 1 ? ModelFlow::App::HTTP : ModelFlow::App::TLS;
+      fwd.ip_proto = IPPROTO_TCP;
+      fwd.dst_port = flow.app == ModelFlow::App::HTTP ? 80 : 443;
+      fwd.tcp_window = 64240;
+      fwd.tcp_seq = distrib(m_rndGen);
+   }
+
+   flow.rev = fwd;
+   std::swap(flow.rev.src_mac, flow.rev.dst_mac);
+   std::swap(flow.rev.src_ip, flow.rev.dst_ip);
+   std::swap(flow.rev.src_port, flow.rev.dst_port);
+   flow.rev.tcp_seq = distrib(m_rndGen);
+
+   double p = std::uniform_real_distribution<double>(0, 1)(m_rndGen);
+   flow.data_pkts = std::upper_bound(m_zipfCdf.begin(), m_zipfCdf.end(), p) - m_zipfCdf.begin() + 1;
+   flow.data_pkts = std::min<uint32_t>(flow.data_pkts, m_zipfCdf.size());
+   flow.sent = 0;
+   m_active.push_back(idx);
+}
+
+/**
+ * \brief Generate next packet of a random active flow.
+ *
+ * TCP flows open with a handshake, client sends a request followed by server data packets
+ * acknowledged by client, and close with FIN exchange. DNS flows alternate queries and responses.
+ * \return False when no flow is active.
+ */
+bool Benchmark::generatePacketModel(Packet *pkt)
+{
+   if (m_active.empty()) {
+      return false;
+   }
+   size_t active_idx = std::uniform_int_distribution<size_t>(0, m_active.size() - 1)(m_rndGen);
+   ModelFlow &flow = m_flows[m_active[active_idx]];
+   bool tcp = flow.app != ModelFlow::App::DNS;
+   uint32_t step = flow.sent++;
+   uint32_t total = tcp ? flow.data_pkts + 6 : flow.data_pkts;
+
+   bool client = true;
+   uint8_t flags = 0;
+   const std::vector<uint8_t> *tmpl = nullptr;
+   uint16_t payload_len = 0;
+   if (!tcp) {
+      client = !(step & 1);
+      tmpl = client ? &m_dnsQuery : &m_dnsResponse;
+   } else if (step < 3) {
+      const uint8_t handshake[] = {0x02, 0x12, 0x10}; // SYN, SYN ACK, ACK
+      client = step != 1;
+      flags = handshake[step];
+   } else if (step >= total - 3) {
+      const uint8_t teardown[] = {0x11, 0x11, 0x10}; // FIN ACK, FIN ACK, ACK
+      client = step != total - 2;
+      flags = teardown[step - (total - 3)];
+   } else {
+      uint32_t k = step - 3;
+      flags = 0x18; // PSH ACK
+      if (k == 0) {
+         tmpl = flow.app == ModelFlow::App::HTTP ? &m_httpRequest : &m_tlsClientHello;
+      } else if (k & 1) {
+         client = false;
+         tmpl = flow.app == ModelFlow::App::HTTP && k == 1 ? &m_httpResponse : nullptr;
+         payload_len = m_packetSizeFrom;
+      } else {
+         flags = 0x10; // ACK
+      }
+   }
+
+   uint8_t *buffer = pkt->buffer;
+   uint16_t buffer_size = pkt->buffer_size;
+   *pkt = client ? flow.fwd : flow.rev;
+   pkt->buffer = buffer;
+   pkt->buffer_size = buffer_size;
+   pkt->ts = m_currentTs;
+   pkt->tcp_flags = flags;
+
+   uint16_t l3_size = pkt->ip_version == IP::v4 ? BENCHMARK_L3_SIZE : 40;
+   uint16_t l4_size = tcp ? BENCHMARK_L4_SIZE_TCP : BENCHMARK_L4_SIZE_UDP;
+   uint16_t hdr_size = BENCHMARK_L2_SIZE + l3_size + l4_size;
+   if (tmpl != nullptr) {
+      payload_len = std::max<uint16_t>(payload_len, tmpl->size());
+   }
+   // Captured payload is limited by buffer, lengths on wire are kept
+   uint16_t captured = payload_len;
+   if (captured && hdr_size + captured >= buffer_size) {
+      captured = buffer_size > hdr_size ? buffer_size - hdr_size - 1 : 0;
+   }
+
+   pkt->packet = buffer;
+   pkt->payload = buffer + hdr_size;
+   if (tmpl != nullptr) {
+      memcpy(pkt->payload, tmpl->data(), std::min<size_t>(tmpl->size(), captured));
+   }
+   pkt->payload_len = captured;
+   pkt->payload_len_wire = payload_len;
+   pkt->ip_payload_len = l4_size + payload_len;
+   pkt->ip_len = l3_size + pkt->ip_payload_len;
+   pkt->packet_len = hdr_size + captured;
+   pkt->packet_len_wire = hdr_size + payload_len;
+   if (pkt->packet_len < buffer_size) {
+      buffer[pkt->packet_len] = 0;
+   }
+   if (tcp) {
+      // Sequence numbers advance by sent payload
+      Packet &sender = client ? flow.fwd : flow.rev;
+      Packet &receiver = client ? flow.rev : flow.fwd;
+      sender.tcp_seq += payload_len + (flags & 0x03 ? 1 : 0);
+      receiver.tcp_ack = sender.tcp_seq;
+   }
+
+   if (flow.sent == total) {
+      uint32_t idx = m_active[active_idx];
+      m_active[active_idx] = m_active.back();
+      m_active.pop_back();
+      if (m_rate) {
+         m_free.push_back(idx);
+      } else {
+         startFlow(idx);
+      }
+   }
+   return true;
+}
+
 }
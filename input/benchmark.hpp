@@ -46,6 +46,7 @@
 #include <random>
 #include <chrono>
 #include <string>
+#include <vector>
 #include <cstdint>
 
 #include <ipfixprobe/input.hpp>
@@ -70,6 +71,13 @@ namespace ipxp {
 #define BENCHMARK_DEFAULT_SIZE_FROM 512
 #define BENCHMARK_DEFAULT_SIZE_TO   512
 
+#define BENCHMARK_DEFAULT_FLOWS     10000
+#define BENCHMARK_DEFAULT_ZIPF      1.1
+#define BENCHMARK_DEFAULT_FLOW_LEN  1000
+#define BENCHMARK_DEFAULT_IPV6      10  // % of flows
+#define BENCHMARK_DEFAULT_UDP       30  // % of flows
+#define BENCHMARK_POOL_NONE         0
+
 class BenchmarkOptParser : public OptionsParser
 {
 public:
@@ -79,11 +87,22 @@ public:
    uint64_t m_pkt_cnt;
    uint16_t m_pkt_size;
    uint64_t m_link;
+   uint32_t m_flows;
+   double m_zipf;
+   uint32_t m_flow_len;
+   uint64_t m_rate;
+   uint8_t m_ipv6;
+   uint8_t m_udp;
+   uint64_t m_pool;
+   uint16_t m_pipelines;
+   uint16_t m_index;
 
    BenchmarkOptParser() : OptionsParser("benchmark", "Input plugin for various benchmarking purposes"),
-      m_mode("1f"), m_seed(""), m_duration(0), m_pkt_cnt(0), m_pkt_size(BENCHMARK_DEFAULT_SIZE_FROM), m_link(0)
+      m_mode("1f"), m_seed(""), m_duration(0), m_pkt_cnt(0), m_pkt_size(BENCHMARK_DEFAULT_SIZE_FROM), m_link(0),
+      m_flows(BENCHMARK_DEFAULT_FLOWS), m_zipf(BENCHMARK_DEFAULT_ZIPF), m_flow_len(BENCHMARK_DEFAULT_FLOW_LEN), m_rate(0),
+      m_ipv6(BENCHMARK_DEFAULT_IPV6), m_udp(BENCHMARK_DEFAULT_UDP), m_pool(BENCHMARK_POOL_NONE), m_pipelines(1), m_index(0)
    {
-      register_option("m", "mode", "STR", "Benchmark mode 1f (1x N-packet flow) or nf (Nx 1-packet flow)", [this](const char *arg){m_mode = arg; return true;}, OptionFlags::RequiredArgument);
+      register_option("m", "mode", "STR", "Benchmark mode 1f (1x N-packet flow), nf (Nx 1-packet flow) or model (traffic model)", [this](const char *arg){m_mode = arg; return true;}, OptionFlags::RequiredArgument);
       register_option("S", "seed", "STR", "String seed for random generator", [this](const char *arg){m_seed = arg; return true;}, OptionFlags::RequiredArgument);
       register_option("d", "duration", "TIME", "Duration in seconds",
          [this](const char *arg){try {m_duration = str2num<decltype(m_duration)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
@@ -97,15 +116,52 @@ public:
       register_option("I", "id", "NUM", "Link identifier number",
          [this](const char *arg){try {m_link = str2num<decltype(m_link)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
          OptionFlags::RequiredArgument);
+      register_option("f", "flows", "NUM", "Number of concurrent flows (model mode)",
+         [this](const char *arg){try {m_flows = str2num<decltype(m_flows)>(arg); if (!m_flows) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("z", "zipf", "EXP", "Exponent of Zipf distribution of flow sizes in packets (model mode)",
+         [this](const char *arg){try {m_zipf = str2num<decltype(m_zipf)>(arg); if (m_zipf <= 0) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("L", "flowlen", "NUM", "Maximal number of data packets of a flow (model mode)",
+         [this](const char *arg){try {m_flow_len = str2num<decltype(m_flow_len)>(arg); if (!m_flow_len) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("r", "rate", "NUM", "New flows per second, finished flows are replaced immediately by default (model mode)",
+         [this](const char *arg){try {m_rate = str2num<decltype(m_rate)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("6", "ipv6", "PCT", "Percentage of IPv6 flows (model mode)",
+         [this](const char *arg){try {m_ipv6 = str2num<decltype(m_ipv6)>(arg); if (m_ipv6 > 100) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("u", "udp", "PCT", "Percentage of UDP (DNS) flows, the rest are TCP flows carrying HTTP or TLS (model mode)",
+         [this](const char *arg){try {m_udp = str2num<decltype(m_udp)>(arg); if (m_udp > 100) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("P", "pool", "SIZE", "Number of packets generated at start and replayed in a loop, 0 generates packets on the fly",
+         [this](const char *arg){try {m_pool = str2num<decltype(m_pool)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("n", "pipelines", "NUM", "Generate packets in NUM pipelines sharing one pool, each one with different addresses",
+         [this](const char *arg){try {m_pipelines = str2num<decltype(m_pipelines)>(arg); if (!m_pipelines) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("x", "index", "IDX", "Index of pipeline, set automatically for each pipeline",
+         [this](const char *arg){try {m_index = str2num<decltype(m_index)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
    }
 };
 
+struct BenchmarkPool;
+
+/**
+ * \brief Generator of synthetic packets.
+ *
+ * Packets are generated on the fly or taken from a pool generated at start, so measured throughput does not
+ * include the random generator. Pool is shared read-only by pipelines of one input, each pipeline and pass
+ * of the pool XORs addresses with a different key.
+ */
 class Benchmark : public InputPlugin
 {
 public:
    enum class BenchmarkMode {
       FLOW_1, /* 1x N-packet flow */
-      FLOW_N  /* Nx 1-packet flows */
+      FLOW_N, /* Nx 1-packet flows */
+      MODEL   /* Concurrent flows with handshakes and payloads */
    };
    Benchmark();
    ~Benchmark();
@@ -115,6 +171,7 @@ public:
    std::string get_name() const { return "benchmark"; }
 
    InputPlugin::Result get(PacketBlock &packets);
+   std::vector<std::string> expand(const char *params) const;
 
 private:
    void (Benchmark::*m_generatePacketFunc)(Packet *);
@@ -126,10 +183,59 @@ private:
 
    std::mt19937 m_rndGen;
    Packet m_pkt;
-   struct timeval m_firstTs;
-   struct timeval m_currentTs;
+   timestamp_t m_firstTs;
+   timestamp_t m_currentTs;
    uint64_t m_pktCnt;
 
+   /**
+    * \brief State of a flow of traffic model.
+    */
+   struct ModelFlow {
+      enum class App : uint8_t {
+         HTTP,
+         TLS,
+         DNS
+      };
+      Packet fwd;          /**< Fields of packets sent by client */
+      Packet rev;          /**< Fields of packets sent by server */
+      App app;
+      uint32_t data_pkts;  /**< Number of data packets */
+      uint32_t sent;       /**< Number of packets sent */
+   };
+
+   std::vector<ModelFlow> m_flows;
+   std::vector<uint32_t> m_active;   /**< Indexes of active flows */
+   std::vector<uint32_t> m_free;     /**< Indexes of finished flows */
+   std::vector<double> m_zipfCdf;    /**< Cumulative distribution of flow sizes */
+   uint64_t m_rate;
+   uint64_t m_started;
+   uint8_t m_ipv6;
+   uint8_t m_udp;
+   std::vector<uint8_t> m_httpRequest;
+   std::vector<uint8_t> m_httpResponse;
+   std::vector<uint8_t> m_tlsClientHello;
+   std::vector<uint8_t> m_dnsQuery;
+   std::vector<uint8_t> m_dnsResponse;
+
+   uint64_t m_poolSize;
+   std::string m_poolId;  /**< Settings of shared pool, empty for private pool */
+   BenchmarkPool *m_pool;
+   size_t m_poolPos;      /**< Next packet of the pool */
+   uint64_t m_poolPass;   /**< Number of passes through the pool */
+   uint32_t m_key;        /**< Key XORed to addresses of current pass */
+   uint16_t m_pipelines;
+   uint16_t m_index;
+
+   void initModel(const BenchmarkOptParser &parser);
+   void startFlow(uint32_t idx);
+   void startFlows();
+   bool generatePacketModel(Packet *pkt);
+
+   void seedGenerator(const std::string &seed);
+   void createPool(uint16_t buffer_size);
+   BenchmarkPool *generatePool(uint16_t buffer_size);
+   void replayPacket(Packet *pkt);
+
    InputPlugin::Result check_constraints() const;
    void swapEndpoints(Packet *pkt);
    void generatePacket(Packet *pkt);
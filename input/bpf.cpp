@@ -0,0 +1,261 @@
+/**
+ * \file bpf.cpp
+ * \brief Loading of eBPF maps and programs without libbpf.
+ *    More info at https://www.kernel.org/doc/html/latest/bpf/index.html
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <config.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/if_link.h>
+
+#include <ipfixprobe/plugin.hpp>
+
+#include "bpf.hpp"
+
+namespace ipxp {
+
+#define BPF_LOG_SIZE 65536 /**< Size of buffer for verifier messages. */
+
+static int sys_bpf(int cmd, union bpf_attr *attr)
+{
+   return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+void BpfAsm::emit(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm)
+{
+   struct bpf_insn insn;
+   memset(&insn, 0, sizeof(insn));
+   insn.code = code;
+   insn.dst_reg = dst;
+   insn.src_reg = src;
+   insn.off = off;
+   insn.imm = imm;
+   m_insns.push_back(insn);
+}
+
+void BpfAsm::ld_map(uint8_t dst, int map_fd)
+{
+   // 64-bit immediate load takes two instructions, the second one holds upper half of the value
+   emit(BPF_LD | BPF_DW | BPF_IMM, dst, BPF_PSEUDO_MAP_FD, 0, map_fd);
+   emit(0, 0, 0, 0, 0);
+}
+
+void BpfAsm::jmp(const std::string &target)
+{
+   m_jumps.push_back(std::make_pair(m_insns.size(), target));
+   emit(BPF_JMP | BPF_JA, 0, 0, 0, 0);
+}
+
+void BpfAsm::jmp_imm(uint8_t op, uint8_t dst, int32_t imm, const std::string &target)
+{
+   m_jumps.push_back(std::make_pair(m_insns.size(), target));
+   emit(BPF_JMP | op | BPF_K, dst, 0, 0, imm);
+}
+
+void BpfAsm::jmp_reg(uint8_t op, uint8_t dst, uint8_t src, const std::string &target)
+{
+   m_jumps.push_back(std::make_pair(m_insns.size(), target));
+   emit(BPF_JMP | op | BPF_X, dst, src, 0, 0);
+}
+
+void BpfAsm::label(const std::string &name)
+{
+   m_labels[name] = m_insns.size();
+}
+
+std::vector<struct bpf_insn> BpfAsm::insns() const
+{
+   std::vector<struct bpf_insn> insns = m_insns;
+   for (auto &it : m_jumps) {
+      auto target = m_labels.find(it.second);
+      if (target == m_labels.end()) {
+         throw PluginError("undefined eBPF jump target " + it.second);
+      }
+      // Offset is relative to the instruction following the jump
+      insns[it.first].off = static_cast<int16_t>(target->second - it.first - 1);
+   }
+   return insns;
+}
+
+int bpf_map_create(uint32_t type, uint32_t key_size, uint32_t value_size, uint32_t max_entries)
+{
+   union bpf_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.map_type = type;
+   attr.key_size = key_size;
+   attr.value_size = value_size;
+   attr.max_entries = max_entries;
+   return sys_bpf(BPF_MAP_CREATE, &attr);
+}
+
+int bpf_map_lookup(int map_fd, const void *key, void *value)
+{
+   union bpf_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.map_fd = map_fd;
+   attr.key = reinterpret_cast<uint64_t>(key);
+   attr.value = reinterpret_cast<uint64_t>(value);
+   return sys_bpf(BPF_MAP_LOOKUP_ELEM, &attr);
+}
+
+int bpf_map_update(int map_fd, const void *key, const void *value, uint64_t flags)
+{
+   union bpf_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.map_fd = map_fd;
+   attr.key = reinterpret_cast<uint64_t>(key);
+   attr.value = reinterpret_cast<uint64_t>(value);
+   attr.flags = flags;
+   return sys_bpf(BPF_MAP_UPDATE_ELEM, &attr);
+}
+
+int bpf_map_delete(int map_fd, const void *key)
+{
+   union bpf_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.map_fd = map_fd;
+   attr.key = reinterpret_cast<uint64_t>(key);
+   return sys_bpf(BPF_MAP_DELETE_ELEM, &attr);
+}
+
+int bpf_map_lookup_and_delete(int map_fd, const void *key, void *value)
+{
+   union bpf_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.map_fd = map_fd;
+   attr.key = reinterpret_cast<uint64_t>(key);
+   attr.value = reinterpret_cast<uint64_t>(value);
+   return sys_bpf(BPF_MAP_LOOKUP_AND_DELETE_ELEM, &attr);
+}
+
+int bpf_map_next_key(int map_fd, const void *key, void *next_key)
+{
+   union bpf_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.map_fd = map_fd;
+   attr.key = reinterpret_cast<uint64_t>(key);
+   attr.next_key = reinterpret_cast<uint64_t>(next_key);
+   return sys_bpf(BPF_MAP_GET_NEXT_KEY, &attr);
+}
+
+int bpf_prog_load(uint32_t type, const std::vector<struct bpf_insn> &insns, std::string &log)
+{
+   static const char license[] = "Dual BSD/GPL";
+   union bpf_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.prog_type = type;
+   attr.insns = reinterpret_cast<uint64_t>(insns.data());
+   attr.insn_cnt = insns.size();
+   attr.license = reinterpret_cast<uint64_t>(license);
+   int fd = sys_bpf(BPF_PROG_LOAD, &attr);
+   if (fd >= 0) {
+      return fd;
+   }
+
+   // Load again with verifier log to report why the program was rejected
+   int err = errno;
+   std::vector<char> buf(BPF_LOG_SIZE, 0);
+   attr.log_buf = reinterpret_cast<uint64_t>(buf.data());
+   attr.log_size = buf.size();
+   attr.log_level = 1;
+   fd = sys_bpf(BPF_PROG_LOAD, &attr);
+   if (fd >= 0) {
+      return fd;
+   }
+   log = buf.data();
+   errno = err;
+   return -1;
+}
+
+static int xdp_link_create(int prog_fd, int ifindex, uint32_t mode)
+{
+   union bpf_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.link_create.prog_fd = prog_fd;
+   attr.link_create.target_ifindex = ifindex;
+   attr.link_create.attach_type = BPF_XDP;
+   attr.link_create.flags = mode;
+   return sys_bpf(BPF_LINK_CREATE, &attr);
+}
+
+int bpf_xdp_attach(int prog_fd, int ifindex, bool skb)
+{
+   int link_fd = -1;
+   if (!skb) {
+      link_fd = xdp_link_create(prog_fd, ifindex, XDP_FLAGS_DRV_MODE);
+   }
+   if (link_fd < 0) {
+      link_fd = xdp_link_create(prog_fd, ifindex, XDP_FLAGS_SKB_MODE);
+   }
+   return link_fd;
+}
+
+unsigned bpf_possible_cpus()
+{
+   // Format is a list of ranges, e.g. 0-3,5,7-8
+   std::ifstream in("/sys/devices/system/cpu/possible");
+   std::string ranges;
+   unsigned cnt = 0;
+   if (!(in >> ranges)) {
+      return sysconf(_SC_NPROCESSORS_CONF);
+   }
+   size_t pos = 0;
+   while (pos < ranges.size()) {
+      size_t end = ranges.find(',', pos);
+      std::string range = ranges.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+      size_t dash = range.find('-');
+      unsigned last = std::stoul(dash == std::string::npos ? range : range.substr(dash + 1));
+      if (last + 1 > cnt) {
+         cnt = last + 1;
+      }
+      if (end == std::string::npos) {
+         break;
+      }
+      pos = end + 1;
+   }
+   return cnt;
+}
+
+}
@@ -0,0 +1,118 @@
+/**
+ * \file bpf.hpp
+ * \brief Loading of eBPF maps and programs without libbpf
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_INPUT_BPF_HPP
+#define IPXP_INPUT_BPF_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <linux/bpf.h>
+
+namespace ipxp {
+
+/**
+ * \brief Assembler of eBPF programs with named jump targets.
+ */
+class BpfAsm
+{
+public:
+   void emit(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm);
+
+   void alu_imm(uint8_t op, uint8_t dst, int32_t imm) { emit(BPF_ALU64 | op | BPF_K, dst, 0, 0, imm); }
+   void alu_reg(uint8_t op, uint8_t dst, uint8_t src) { emit(BPF_ALU64 | op | BPF_X, dst, src, 0, 0); }
+   void be16(uint8_t dst) { emit(BPF_ALU | BPF_END | BPF_TO_BE, dst, 0, 0, 16); }
+   void ldx(uint8_t size, uint8_t dst, uint8_t src, int16_t off) { emit(BPF_LDX | BPF_MEM | size, dst, src, off, 0); }
+   void stx(uint8_t size, uint8_t dst, uint8_t src, int16_t off) { emit(BPF_STX | BPF_MEM | size, dst, src, off, 0); }
+   void st(uint8_t size, uint8_t dst, int16_t off, int32_t imm) { emit(BPF_ST | BPF_MEM | size, dst, 0, off, imm); }
+   void call(int32_t func) { emit(BPF_JMP | BPF_CALL, 0, 0, 0, func); }
+   void exit() { emit(BPF_JMP | BPF_EXIT, 0, 0, 0, 0); }
+   void ld_map(uint8_t dst, int map_fd);
+
+   void jmp(const std::string &target);
+   void jmp_imm(uint8_t op, uint8_t dst, int32_t imm, const std::string &target);
+   void jmp_reg(uint8_t op, uint8_t dst, uint8_t src, const std::string &target);
+   void label(const std::string &name);
+
+   /**
+    * \brief Get program with resolved jumps.
+    * \throw PluginError when a jump target is not defined.
+    */
+   std::vector<struct bpf_insn> insns() const;
+
+private:
+   std::vector<struct bpf_insn> m_insns;
+   std::map<std::string, size_t> m_labels;
+   std::vector<std::pair<size_t, std::string>> m_jumps; /**< Jump instructions with their targets. */
+};
+
+int bpf_map_create(uint32_t type, uint32_t key_size, uint32_t value_size, uint32_t max_entries);
+int bpf_map_lookup(int map_fd, const void *key, void *value);
+int bpf_map_update(int map_fd, const void *key, const void *value, uint64_t flags);
+int bpf_map_delete(int map_fd, const void *key);
+int bpf_map_lookup_and_delete(int map_fd, const void *key, void *value);
+int bpf_map_next_key(int map_fd, const void *key, void *next_key);
+
+/**
+ * \brief Load program to kernel.
+ * \param [in] type Program type.
+ * \param [in] insns Program instructions.
+ * \param [out] log Verifier messages when loading fails.
+ * \return Program file descriptor or -1 with errno set.
+ */
+int bpf_prog_load(uint32_t type, const std::vector<struct bpf_insn> &insns, std::string &log);
+
+/**
+ * \brief Attach XDP program to interface using BPF link, program is detached when the link is closed.
+ * Native XDP is tried first unless generic mode is requested, generic (skb) mode is used on drivers without XDP support.
+ * \return Link file descriptor or -1 with errno set.
+ */
+int bpf_xdp_attach(int prog_fd, int ifindex, bool skb);
+
+/**
+ * \brief Get number of possible CPUs, i.e. number of values of per-CPU map entries.
+ */
+unsigned bpf_possible_cpus();
+
+}
+#endif /* IPXP_INPUT_BPF_HPP */
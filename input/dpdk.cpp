@@ -41,7 +41,11 @@
  *
  */
 
+#include <atomic>
 #include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
 #include <rte_ethdev.h>
 #include <rte_version.h>
 
@@ -70,7 +74,7 @@ namespace ipxp
             return false;
         }
 
-        pkt.ts = {data_view->arrival_time.sec, data_view->arrival_time.nsec / 1000};
+        pkt.ts = ts_from_nsec(data_view->arrival_time.sec, data_view->arrival_time.nsec);
 
         std::memset(pkt.dst_mac, 0, sizeof(pkt.dst_mac));
         std::memset(pkt.src_mac, 0, sizeof(pkt.src_mac));
@@ -124,22 +128,102 @@ namespace ipxp
     }
 #endif
 
-    void DpdkReader::init(const char *params)
+    /**
+     * \brief State of port shared by pipelines reading its queues.
+     */
+    struct DpdkPort {
+        std::uint16_t queues;       /**< Number of configured RX queues */
+        std::uint16_t ready;        /**< Number of RX queues set up */
+        std::uint16_t refs;
+        std::atomic<bool> started;
+        std::atomic<bool> failed;   /**< Set when a queue or the port could not be set up */
+        std::vector<rte_mempool*> mempools; /**< Pools of RX queues, freed when port is stopped */
+    };
+
+    static std::mutex ports_mtx;
+    static std::map<size_t, DpdkPort> ports;
+
+    DpdkReader::DpdkReader() : port_id_(0), queue_id_(0), port_(nullptr), mpool_(nullptr), pkts_read_(0)
+    {
+    }
+
+    DpdkReader::~DpdkReader()
+    {
+        close();
+    }
+
+    std::vector<std::string> DpdkReader::expand(const char *params) const
     {
         DpdkOptParser parser;
+        try {
+            parser.parse(params);
+        } catch (ParserError& e) {
+            throw PluginError(e.what());
+        }
+
+        std::vector<std::string> args;
+        for (std::uint16_t i = 0; i < parser.rx_queues(); i++) {
+            args.push_back(std::string(params ? params : "") + OptionsParser::DELIM + "queue=" + std::to_string(i));
+        }
+        return args;
+    }
+
+    /**
+     * \brief Configure port with given number of RX queues, packets are distributed by symmetric RSS.
+     */
+    void DpdkReader::configure_port(std::uint16_t queues)
+    {
 #if RTE_VERSION >= RTE_VERSION_NUM(21,11,0,0)
         rte_eth_conf port_conf{.rxmode = {.mtu = RTE_ETHER_MAX_LEN}};
 #else
         rte_eth_conf port_conf{.rxmode = {.max_rx_pkt_len = RTE_ETHER_MAX_LEN}};
 #endif
+        rte_eth_dev_info dev_info;
+#if RTE_VERSION >= RTE_VERSION_NUM(19,11,0,0)
+        if (rte_eth_dev_info_get(port_id_, &dev_info) != 0) {
+            throw PluginError("Unable to get DPDK port information");
+        }
+#else
+        rte_eth_dev_info_get(port_id_, &dev_info);
+#endif
+        if (queues > dev_info.max_rx_queues) {
+            throw PluginError("DPDK port supports at most " + std::to_string(dev_info.max_rx_queues) + " RX queues");
+        }
+
+        // Key of repeated 0x6d5a makes Toeplitz hash symmetric, both directions of a biflow are received by one queue
+        std::vector<std::uint8_t> rss_key(dev_info.hash_key_size ? dev_info.hash_key_size : 40);
+        for (size_t i = 0; i < rss_key.size(); i++) {
+            rss_key[i] = i & 1 ? 0x5a : 0x6d;
+        }
+#if RTE_VERSION >= RTE_VERSION_NUM(21,11,0,0)
+        std::uint64_t rss_hf = (RTE_ETH_RSS_IP | RTE_ETH_RSS_TCP | RTE_ETH_RSS_UDP) & dev_info.flow_type_rss_offloads;
+#else
+        std::uint64_t rss_hf = (ETH_RSS_IP | ETH_RSS_TCP | ETH_RSS_UDP) & dev_info.flow_type_rss_offloads;
+#endif
+        if (queues > 1 && rss_hf) {
+#if RTE_VERSION >= RTE_VERSION_NUM(21,11,0,0)
+            port_conf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
+#else
+            port_conf.rxmode.mq_mode = ETH_MQ_RX_RSS;
+#endif
+            port_conf.rx_adv_conf.rss_conf.rss_key = rss_key.data();
+            port_conf.rx_adv_conf.rss_conf.rss_key_len = rss_key.size();
+            port_conf.rx_adv_conf.rss_conf.rss_hf = rss_hf;
+        } else if (queues > 1) {
+            // Virtual devices like net_pcap or net_ring fill each queue from its own source
+            std::cerr << "dpdk: port " << port_id_ << " does not support RSS, packets are distributed to queues by the device" << std::endl;
+        }
+
+        if (rte_eth_dev_configure(port_id_, queues, 0, &port_conf) != 0) {
+            throw PluginError("Unable to configure interface");
+        }
+    }
 
+    void DpdkReader::init(const char *params)
+    {
+        DpdkOptParser parser;
         try {
             parser.parse(params);
-            mpool_ = rte_pktmbuf_pool_create("IPFIXPROBE", parser.pkt_mempool_size(), 256, 0, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
-            if (!mpool_) {
-                throw PluginError("Unable to create memory pool. " + std::string(rte_strerror(rte_errno)));
-            }
-            mbufs_.resize(parser.pkt_buffer_size());
         } catch (ParserError& e) {
             throw PluginError(e.what());
         }
@@ -148,35 +232,109 @@ namespace ipxp
         if (!rte_eth_dev_is_valid_port(parser.port_num())) {
             throw PluginError("Invalid DPDK port specified");
         }
+        if (parser.rx_queue() >= parser.rx_queues()) {
+            throw PluginError("RX queue must be lower than number of queues");
+        }
 
         port_id_ = parser.port_num();
+        queue_id_ = parser.rx_queue();
+        mbufs_.resize(parser.pkt_buffer_size());
 
-        if (rte_eth_dev_configure(port_id_, 1, 0, &port_conf) != 0) {
-            throw PluginError("Unable to configure interface");
+        // Memory of the queue is allocated on NUMA node of the port
+        int socket = rte_eth_dev_socket_id(port_id_);
+        if (socket < 0) {
+            socket = rte_socket_id();
+        }
+        std::string pool_name = "IPFIXPROBE_" + std::to_string(port_id_) + "_" + std::to_string(queue_id_);
+        mpool_ = rte_pktmbuf_pool_create(pool_name.c_str(), parser.pkt_mempool_size(), 256, 0, RTE_MBUF_DEFAULT_BUF_SIZE, socket);
+        if (!mpool_) {
+            throw PluginError("Unable to create memory pool. " + std::string(rte_strerror(rte_errno)));
         }
 
-        if (rte_eth_rx_queue_setup(port_id_, 0, mbufs_.size(), rte_eth_dev_socket_id(port_id_), nullptr, mpool_) < 0) {
+        std::lock_guard<std::mutex> lock(ports_mtx);
+        auto it = ports.find(port_id_);
+        if (it == ports.end()) {
+            configure_port(parser.rx_queues());
+            DpdkPort& port = ports[port_id_];
+            port.queues = parser.rx_queues();
+            port.ready = 0;
+            port.refs = 0;
+            port.started = false;
+            port.failed = false;
+            it = ports.find(port_id_);
+        } else if (it->second.failed) {
+            throw PluginError("DPDK port could not be set up by other pipeline");
+        } else if (it->second.queues != parser.rx_queues()) {
+            throw PluginError("DPDK port is already configured with " + std::to_string(it->second.queues) + " RX queues");
+        }
+
+        if (rte_eth_rx_queue_setup(port_id_, queue_id_, mbufs_.size(), socket, nullptr, mpool_) < 0) {
+            // Port can not be started without this queue, pipelines of its other queues stop with an error
+            if (it->second.refs == 0) {
+                ports.erase(it);
+            } else {
+                it->second.failed = true;
+            }
             throw PluginError("Unable to set up RX queues");
         }
+        port_ = &it->second;
+        port_->refs++;
+        port_->mempools.push_back(mpool_);
 
-        if (rte_eth_dev_start(port_id_) < 0) {
-            throw PluginError("Unable to start DPDK port");
+        // Port is started when the last queue is set up, pipelines read nothing until then
+        if (++port_->ready == port_->queues) {
+            if (rte_eth_dev_start(port_id_) < 0) {
+                port_->failed = true;
+                throw PluginError("Unable to start DPDK port");
+            }
+            rte_eth_promiscuous_enable(port_id_);
+            port_->started.store(true, std::memory_order_release);
+        }
+    }
+
+    void DpdkReader::close()
+    {
+        for (auto i = 0; i < pkts_read_; i++) {
+            rte_pktmbuf_free(mbufs_[i]);
         }
+        pkts_read_ = 0;
 
-        rte_eth_promiscuous_enable(port_id_);
+        if (port_) {
+            std::lock_guard<std::mutex> lock(ports_mtx);
+            if (--port_->refs == 0) {
+                if (port_->started) {
+                    rte_eth_dev_stop(port_id_);
+                }
+                for (auto pool : port_->mempools) {
+                    rte_mempool_free(pool);
+                }
+                ports.erase(port_id_);
+            }
+            port_ = nullptr;
+        } else if (mpool_) {
+            rte_mempool_free(mpool_);
+        }
+        mpool_ = nullptr;
     }
 
     InputPlugin::Result DpdkReader::get(PacketBlock& packets)
     {
 #ifndef WITH_FLEXPROBE
-        parser_opt_t opt{&packets, false, false, DLT_EN10MB};
+        parser_opt_t opt{&packets, false, false, DLT_EN10MB, false, m_payload_horizon, m_decap_depth, &m_fragments, m_malformed};
 #endif
         packets.cnt = 0;
         for (auto i = 0; i < pkts_read_; i++) {
             rte_pktmbuf_free(mbufs_[i]);
         }
+        pkts_read_ = 0;
 
-        pkts_read_ = rte_eth_rx_burst(port_id_, 0, mbufs_.data(), mbufs_.size());
+        if (!port_->started.load(std::memory_order_acquire)) {
+            if (port_->failed) {
+                throw PluginError("DPDK port could not be set up by other pipeline");
+            }
+            return Result::NOT_PARSED;
+        }
+        pkts_read_ = rte_eth_rx_burst(port_id_, queue_id_, mbufs_.data(), mbufs_.size());
         if (pkts_read_ == 0) {
             return Result::NOT_PARSED;
         }
@@ -195,7 +353,7 @@ namespace ipxp
             packets.cnt++;
 #else
             parse_packet(&opt,
-                         timeval(),
+                         timestamp_t(),
                          rte_pktmbuf_mtod(mbufs_[i], const std::uint8_t *),
                          rte_pktmbuf_data_len(mbufs_[i]),
                          rte_pktmbuf_data_len(mbufs_[i]));
@@ -62,8 +62,11 @@ namespace ipxp
         size_t pkt_buffer_size_;
         size_t pkt_mempool_size_;
         std::uint16_t port_num_;
+        std::uint16_t rx_queues_;
+        std::uint16_t rx_queue_;
     public:
-        DpdkOptParser() : OptionsParser("dpdk", "Input plugin for reading packets using DPDK interface"), pkt_buffer_size_(DEFAULT_MBUF_BURST_SIZE), pkt_mempool_size_(DEFAULT_MBUF_POOL_SIZE)
+        DpdkOptParser() : OptionsParser("dpdk", "Input plugin for reading packets using DPDK interface"), pkt_buffer_size_(DEFAULT_MBUF_BURST_SIZE), pkt_mempool_size_(DEFAULT_MBUF_POOL_SIZE),
+            rx_queues_(1), rx_queue_(0)
         {
             register_option("b",
                             "bsize",
@@ -83,6 +86,18 @@ namespace ipxp
                             "Size of the memory pool for received packets. Default: " + std::to_string(DEFAULT_MBUF_POOL_SIZE),
                             [this](const char* arg){try{pkt_mempool_size_ = str2num<decltype(pkt_mempool_size_)>(arg);} catch (std::invalid_argument&){return false;} return true;},
                             RequiredArgument);
+            register_option("n",
+                            "queues",
+                            "NUM",
+                            "Number of RX queues distributing packets by symmetric RSS, each one is read by separate pipeline. Default: 1",
+                            [this](const char* arg){try{rx_queues_ = str2num<decltype(rx_queues_)>(arg); if (!rx_queues_) {return false;}} catch (std::invalid_argument&){return false;} return true;},
+                            RequiredArgument);
+            register_option("q",
+                            "queue",
+                            "ID",
+                            "RX queue read by the pipeline, set automatically for each pipeline",
+                            [this](const char* arg){try{rx_queue_ = str2num<decltype(rx_queue_)>(arg);} catch (std::invalid_argument&){return false;} return true;},
+                            RequiredArgument);
         }
 
         size_t pkt_buffer_size() const { return pkt_buffer_size_; }
@@ -90,20 +105,43 @@ namespace ipxp
         size_t pkt_mempool_size() const { return pkt_mempool_size_; }
 
         std::uint16_t port_num() const { return port_num_; }
+
+        std::uint16_t rx_queues() const { return rx_queues_; }
+
+        std::uint16_t rx_queue() const { return rx_queue_; }
     };
 
+    struct DpdkPort;
+
+    /**
+     * \brief Reader of one RX queue of DPDK port.
+     *
+     * Port is configured by the first pipeline and started when all its queues are set up.
+     * Each queue has its own memory pool allocated on NUMA node of the port.
+     */
     class DpdkReader : public InputPlugin
     {
     private:
         size_t port_id_;
+        std::uint16_t queue_id_;
+        DpdkPort* port_;
         rte_mempool* mpool_;
         std::vector<rte_mbuf*> mbufs_;
         std::uint16_t pkts_read_;
+
+        void configure_port(std::uint16_t queues);
     public:
+        DpdkReader();
+        ~DpdkReader() override;
+
         Result get(PacketBlock& packets) override;
 
         void init(const char *params) override;
 
+        void close() override;
+
+        std::vector<std::string> expand(const char *params) const override;
+
         OptionsParser *get_parser() const override
         {
             return new DpdkOptParser();
@@ -55,10 +55,31 @@
 #define ETH_P_MPLS_UC 0x8847
 #define ETH_P_MPLS_MC 0x8848
 #define ETH_P_PPP_SES 0x8864
+#define ETH_P_TEB     0x6558
 
 #define ETH_ALEN 6
 #define ARPHRD_ETHER 1
 
+#define IP_MF        0x2000 /* more fragments flag */
+#define IP_OFFMASK   0x1FFF /* mask for fragmenting bits */
+#define IP6F_OFFMASK 0xFFF8 /* mask out offset from ip6f_offlg in host byte order */
+
+#define GRE_FLAG_CSUM    0x8000
+#define GRE_FLAG_KEY     0x2000
+#define GRE_FLAG_SEQ     0x1000
+#define GRE_VERSION_MASK 0x0007
+
+#define VXLAN_PORT      4789
+#define VXLAN_FLAG_VNI  0x08
+
+#define GENEVE_PORT     6081
+
+#define GTPU_PORT       2152
+#define GTPU_TYPE_GPDU  0xFF
+#define GTPU_FLAG_PT    0x10
+#define GTPU_FLAG_E     0x04
+#define GTPU_FLAGS_OPT  0x07
+
 namespace ipxp {
 
 // Copied protocol headers from netinet/* files, which may not be present on other platforms
@@ -125,6 +146,14 @@ struct ip6_rthdr
    /* followed by routing type specific data */
 };
 
+struct ip6_frag
+{
+   uint8_t  ip6f_nxt;      /* next header */
+   uint8_t  ip6f_reserved; /* reserved field */
+   uint16_t ip6f_offlg;    /* offset, reserved, and flag */
+   uint32_t ip6f_ident;    /* identification */
+};
+
 struct tcphdr
 {
    __extension__ union
@@ -283,5 +312,30 @@ struct __attribute__((packed)) pppoe_hdr {
    uint16_t length;
 };
 
+struct __attribute__((packed)) gre_hdr {
+   uint16_t flags;   /* C, K, S flags and version */
+   uint16_t proto;   /* ethertype of encapsulated packet */
+};
+
+struct __attribute__((packed)) vxlan_hdr {
+   uint8_t flags;
+   uint8_t reserved[3];
+   uint32_t vni;     /* VNI in upper 24 bits */
+};
+
+struct __attribute__((packed)) geneve_hdr {
+   uint8_t ver_opt_len; /* version (2 bits) and options length in 4B words (6 bits) */
+   uint8_t flags;
+   uint16_t proto;      /* ethertype of encapsulated packet */
+   uint32_t vni;        /* VNI in upper 24 bits */
+};
+
+struct __attribute__((packed)) gtpu_hdr {
+   uint8_t flags;    /* version (3 bits), PT, reserved, E, S and PN flags */
+   uint8_t type;
+   uint16_t length;
+   uint32_t teid;
+};
+
 }
 #endif /* IPXP_INPUT_HEADERS_HPP */
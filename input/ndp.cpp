@@ -59,9 +59,7 @@ __attribute__((constructor)) static void register_this_plugin()
 
 void packet_ndp_handler(parser_opt_t *opt, const struct ndp_packet *ndp_packet, const struct ndp_header *ndp_header)
 {
-   struct timeval ts;
-   ts.tv_sec = le32toh(ndp_header->timestamp_sec);
-   ts.tv_usec = le32toh(ndp_header->timestamp_nsec) / 1000;
+   timestamp_t ts = ts_from_nsec(le32toh(ndp_header->timestamp_sec), le32toh(ndp_header->timestamp_nsec));
 
    parse_packet(opt, ts, ndp_packet->data, ndp_packet->data_length, ndp_packet->data_length);
 }
@@ -104,7 +102,7 @@ void NdpPacketReader::init_ifc(const std::string &dev)
 
 InputPlugin::Result NdpPacketReader::get(PacketBlock &packets)
 {
-   parser_opt_t opt = {&packets, false, false, 0};
+   parser_opt_t opt = {&packets, false, false, 0, false, m_payload_horizon, m_decap_depth, &m_fragments, m_malformed};
    struct ndp_packet *ndp_packet;
    struct ndp_header *ndp_header;
    size_t read_pkts = 0;
@@ -49,6 +49,19 @@
 
 #ifdef WITH_PCAP
 #include <pcap/sll.h>
+#else
+#define SLL_ADDRLEN 8
+
+/**
+ * \brief Linux cooked capture header, the same as in pcap/sll.h.
+ */
+struct sll_header {
+   uint16_t sll_pkttype;
+   uint16_t sll_hatype;
+   uint16_t sll_halen;
+   uint8_t sll_addr[SLL_ADDRLEN];
+   uint16_t sll_protocol;
+};
 #endif /* WITH_PCAP */
 
 #include "parser.hpp"
@@ -70,20 +83,107 @@ static uint32_t s_total_pkts = 0;
 #define DEBUG_CODE(code)
 #endif
 
+/**
+ * \brief Nodes of protocol graph walked by parser.
+ */
+enum ParserLayer : uint8_t {
+   LAYER_END = 0,
+   LAYER_ETH,
+   LAYER_TRILL,
+   LAYER_MPLS,
+   LAYER_PPPOE,
+   LAYER_IPV4,
+   LAYER_IPV6,
+   LAYER_TCP,
+   LAYER_UDP,
+   LAYER_ICMP,
+   LAYER_ICMPV6,
+   LAYER_GRE,
+   LAYER_IPIP,    /**< IPv4 encapsulated in IP */
+   LAYER_IP6IP,   /**< IPv6 encapsulated in IP */
+   LAYER_VXLAN,
+   LAYER_GENEVE,
+   LAYER_GTPU
+};
+
+/**
+ * \brief Table of layers following IP header indexed by IP protocol number.
+ */
+static const struct IpProtoLayers {
+   ParserLayer layer[256];
+
+   IpProtoLayers() : layer()
+   {
+      layer[IPPROTO_TCP] = LAYER_TCP;
+      layer[IPPROTO_UDP] = LAYER_UDP;
+      layer[IPPROTO_ICMP] = LAYER_ICMP;
+      layer[IPPROTO_ICMPV6] = LAYER_ICMPV6;
+      layer[IPPROTO_GRE] = LAYER_GRE;
+      layer[IPPROTO_IPIP] = LAYER_IPIP;
+      layer[IPPROTO_IPV6] = LAYER_IP6IP;
+   }
+} s_ip_proto_layers;
+
+/**
+ * \brief Get layer following L2 header.
+ * \param [in] ethertype Ethertype of next header.
+ * \return Next layer or LAYER_END when protocol is not supported.
+ */
+inline ParserLayer ethertype_layer(uint16_t ethertype)
+{
+   switch (ethertype) {
+   case ETH_P_IP:
+      return LAYER_IPV4;
+   case ETH_P_IPV6:
+      return LAYER_IPV6;
+   case ETH_P_MPLS_UC:
+   case ETH_P_MPLS_MC:
+      return LAYER_MPLS;
+   case ETH_P_PPP_SES:
+      return LAYER_PPPOE;
+   case ETH_P_TRILL:
+      return LAYER_TRILL;
+   case ETH_P_TEB:
+      return LAYER_ETH;
+   default:
+      return LAYER_END;
+   }
+}
+
+/**
+ * \brief Get tunnel layer following UDP header.
+ * \param [in] port Destination port.
+ * \return Tunnel layer or LAYER_END.
+ */
+inline ParserLayer udp_tunnel_layer(uint16_t port)
+{
+   switch (port) {
+   case VXLAN_PORT:
+      return LAYER_VXLAN;
+   case GENEVE_PORT:
+      return LAYER_GENEVE;
+   case GTPU_PORT:
+      return LAYER_GTPU;
+   default:
+      return LAYER_END;
+   }
+}
+
 /**
  * \brief Parse specific fields from ETHERNET frame header.
  * \param [in] data_ptr Pointer to begin of header.
  * \param [in] data_len Length of packet data in `data_ptr`.
  * \param [out] pkt Pointer to Packet structure where parsed fields will be stored.
- * \return Size of header in bytes.
+ * \param [out] hdr_len Size of header in bytes.
+ * \return PARSER_OK or reason of malformed packet.
  */
-inline uint16_t parse_eth_hdr(const u_char *data_ptr, uint16_t data_len, Packet *pkt)
+inline ParserStatus parse_eth_hdr(const u_char *data_ptr, uint16_t data_len, Packet *pkt, uint16_t &hdr_len)
 {
    struct ethhdr *eth = (struct ethhdr *) data_ptr;
    if (sizeof(struct ethhdr) > data_len) {
-      throw "Parser detected malformed packet";
+      return PARSER_TRUNCATED_L2;
    }
-   uint16_t hdr_len = sizeof(struct ethhdr);
+   hdr_len = sizeof(struct ethhdr);
    uint16_t ethertype = ntohs(eth->h_proto);
 
    DEBUG_MSG("Ethernet header:\n");
@@ -109,7 +209,7 @@ inline uint16_t parse_eth_hdr(const u_char *data_ptr, uint16_t data_len, Packet
 
    if (ethertype == ETH_P_8021AD) {
       if (4 > data_len - hdr_len) {
-         throw "Parser detected malformed packet";
+         return PARSER_TRUNCATED_L2;
       }
       DEBUG_CODE(uint16_t vlan = ntohs(*(uint16_t *) (data_ptr + hdr_len)));
       DEBUG_MSG("\t802.1ad field:\n");
@@ -123,7 +223,7 @@ inline uint16_t parse_eth_hdr(const u_char *data_ptr, uint16_t data_len, Packet
    }
    while (ethertype == ETH_P_8021Q) {
       if (4 > data_len - hdr_len) {
-         throw "Parser detected malformed packet";
+         return PARSER_TRUNCATED_L2;
       }
       DEBUG_CODE(uint16_t vlan = ntohs(*(uint16_t *) (data_ptr + hdr_len)));
       DEBUG_MSG("\t802.1q field:\n");
@@ -138,22 +238,22 @@ inline uint16_t parse_eth_hdr(const u_char *data_ptr, uint16_t data_len, Packet
 
    pkt->ethertype = ethertype;
 
-   return hdr_len;
+   return PARSER_OK;
 }
 
-#ifdef WITH_PCAP
 /**
  * \brief Parse specific fields from SLL frame header.
  * \param [in] data_ptr Pointer to begin of header.
  * \param [in] data_len Length of packet data in `data_ptr`.
  * \param [out] pkt Pointer to Packet structure where parsed fields will be stored.
- * \return Size of header in bytes.
+ * \param [out] hdr_len Size of header in bytes.
+ * \return PARSER_OK or reason of malformed packet.
  */
-inline uint16_t parse_sll(const u_char *data_ptr, uint16_t data_len, Packet *pkt)
+inline ParserStatus parse_sll(const u_char *data_ptr, uint16_t data_len, Packet *pkt, uint16_t &hdr_len)
 {
    struct sll_header *sll = (struct sll_header *) data_ptr;
    if (sizeof(struct sll_header) > data_len) {
-      throw "Parser detected malformed packet";
+      return PARSER_TRUNCATED_L2;
    }
 
    DEBUG_MSG("SLL header:\n");
@@ -176,9 +276,9 @@ inline uint16_t parse_sll(const u_char *data_ptr, uint16_t data_len, Packet *pkt
    }
    memset(pkt->dst_mac, 0, sizeof(pkt->dst_mac));
    pkt->ethertype = ntohs(sll->sll_protocol);
-   return sizeof(struct sll_header);
+   hdr_len = sizeof(struct sll_header);
+   return PARSER_OK;
 }
-#endif /* WITH_PCAP */
 
 
 /**
@@ -186,13 +286,14 @@ inline uint16_t parse_sll(const u_char *data_ptr, uint16_t data_len, Packet *pkt
  * \param [in] data_ptr Pointer to begin of header.
  * \param [in] data_len Length of packet data in `data_ptr`.
  * \param [out] pkt Pointer to Packet structure where parsed fields will be stored.
- * \return Size of header in bytes.
+ * \param [out] hdr_len Size of header in bytes.
+ * \return PARSER_OK or reason of malformed packet.
  */
-inline uint16_t parse_trill(const u_char *data_ptr, uint16_t data_len, Packet *pkt)
+inline ParserStatus parse_trill(const u_char *data_ptr, uint16_t data_len, Packet *pkt, uint16_t &hdr_len)
 {
    struct trill_hdr *trill = (struct trill_hdr *) data_ptr;
    if (sizeof(struct trill_hdr) > data_len) {
-      throw "Parser detected malformed packet";
+      return PARSER_TRUNCATED_L2;
    }
    uint8_t op_len = ((trill->op_len1 << 2) | trill->op_len2);
    uint8_t op_len_bytes = op_len * 4;
@@ -206,7 +307,8 @@ inline uint16_t parse_trill(const u_char *data_ptr, uint16_t data_len, Packet *p
    DEBUG_MSG("\tEgress nick:\t%u\n",         ntohs(trill->egress_nick));
    DEBUG_MSG("\tIngress nick:\t%u\n",        ntohs(trill->ingress_nick));
 
-   return sizeof(trill_hdr) + op_len_bytes;
+   hdr_len = sizeof(trill_hdr) + op_len_bytes;
+   return PARSER_OK;
 }
 
 /**
@@ -214,13 +316,14 @@ inline uint16_t parse_trill(const u_char *data_ptr, uint16_t data_len, Packet *p
  * \param [in] data_ptr Pointer to begin of header.
  * \param [in] data_len Length of packet data in `data_ptr`.
  * \param [out] pkt Pointer to Packet structure where parsed fields will be stored.
- * \return Size of header in bytes.
+ * \param [out] hdr_len Size of header in bytes.
+ * \return PARSER_OK or reason of malformed packet.
  */
-inline uint16_t parse_ipv4_hdr(const u_char *data_ptr, uint16_t data_len, Packet *pkt)
+inline ParserStatus parse_ipv4_hdr(const u_char *data_ptr, uint16_t data_len, Packet *pkt, uint16_t &hdr_len)
 {
    struct iphdr *ip = (struct iphdr *) data_ptr;
    if (sizeof(struct iphdr) > data_len) {
-      throw "Parser detected malformed packet";
+      return PARSER_TRUNCATED_L3;
    }
 
    pkt->ip_version = IP::v4;
@@ -230,6 +333,9 @@ inline uint16_t parse_ipv4_hdr(const u_char *data_ptr, uint16_t data_len, Packet
    pkt->ip_payload_len = pkt->ip_len - (ip->ihl << 2);
    pkt->ip_ttl = ip->ttl;
    pkt->ip_flags = (ntohs(ip->frag_off) & 0xE000) >> 13;
+   pkt->ip_frag = (ntohs(ip->frag_off) & (IP_MF | IP_OFFMASK)) != 0;
+   pkt->ip_frag_off = (ntohs(ip->frag_off) & IP_OFFMASK) << 3;
+   pkt->ip_frag_id = ntohs(ip->id);
    pkt->src_ip.v4 = ip->saddr;
    pkt->dst_ip.v4 = ip->daddr;
 
@@ -247,7 +353,8 @@ inline uint16_t parse_ipv4_hdr(const u_char *data_ptr, uint16_t data_len, Packet
    DEBUG_MSG("\tSrc addr:\t%s\n",      inet_ntoa(*(struct in_addr *) (&ip->saddr)));
    DEBUG_MSG("\tDest addr:\t%s\n",     inet_ntoa(*(struct in_addr *) (&ip->daddr)));
 
-   return (ip->ihl << 2);
+   hdr_len = ip->ihl << 2;
+   return PARSER_OK;
 }
 
 /**
@@ -255,18 +362,19 @@ inline uint16_t parse_ipv4_hdr(const u_char *data_ptr, uint16_t data_len, Packet
  * \param [in] data_ptr Pointer to begin of header.
  * \param [in] data_len Length of packet data in `data_ptr`.
  * \param [out] pkt Pointer to Packet structure where parsed fields will be stored.
- * \return Length of headers in bytes.
+ * \param [out] hdrs_len Length of headers in bytes.
+ * \return PARSER_OK or reason of malformed packet.
  */
-uint16_t skip_ipv6_ext_hdrs(const u_char *data_ptr, uint16_t data_len, Packet *pkt)
+ParserStatus skip_ipv6_ext_hdrs(const u_char *data_ptr, uint16_t data_len, Packet *pkt, uint16_t &hdrs_len)
 {
    struct ip6_ext *ext = (struct ip6_ext *) data_ptr;
    uint8_t next_hdr = pkt->ip_proto;
-   uint16_t hdrs_len = 0;
+   hdrs_len = 0;
 
    /* Skip extension headers... */
    while (1) {
       if ((int)sizeof(struct ip6_ext) > data_len - hdrs_len) {
-         throw "Parser detected malformed packet";
+         return PARSER_TRUNCATED_L3;
       }
       if (next_hdr == IPPROTO_HOPOPTS ||
           next_hdr == IPPROTO_DSTOPTS) {
@@ -277,7 +385,14 @@ uint16_t skip_ipv6_ext_hdrs(const u_char *data_ptr, uint16_t data_len, Packet *p
       } else if (next_hdr == IPPROTO_AH) {
          hdrs_len += (ext->ip6e_len << 2) - 2;
       } else if (next_hdr == IPPROTO_FRAGMENT) {
-         hdrs_len += 8;
+         struct ip6_frag *frag = (struct ip6_frag *) (data_ptr + hdrs_len);
+         if ((int)sizeof(struct ip6_frag) > data_len - hdrs_len) {
+            return PARSER_TRUNCATED_L3;
+         }
+         pkt->ip_frag = true;
+         pkt->ip_frag_off = ntohs(frag->ip6f_offlg) & IP6F_OFFMASK;
+         pkt->ip_frag_id = ntohl(frag->ip6f_ident);
+         hdrs_len += sizeof(struct ip6_frag);
       } else {
          break;
       }
@@ -290,7 +405,7 @@ uint16_t skip_ipv6_ext_hdrs(const u_char *data_ptr, uint16_t data_len, Packet *p
    }
 
    pkt->ip_payload_len -= hdrs_len;
-   return hdrs_len;
+   return PARSER_OK;
 }
 
 /**
@@ -298,14 +413,15 @@ uint16_t skip_ipv6_ext_hdrs(const u_char *data_ptr, uint16_t data_len, Packet *p
  * \param [in] data_ptr Pointer to begin of header.
  * \param [in] data_len Length of packet data in `data_ptr`.
  * \param [out] pkt Pointer to Packet structure where parsed fields will be stored.
- * \return Size of header in bytes.
+ * \param [out] hdr_len Size of header in bytes.
+ * \return PARSER_OK or reason of malformed packet.
  */
-inline uint16_t parse_ipv6_hdr(const u_char *data_ptr, uint16_t data_len, Packet *pkt)
+inline ParserStatus parse_ipv6_hdr(const u_char *data_ptr, uint16_t data_len, Packet *pkt, uint16_t &hdr_len)
 {
    struct ip6_hdr *ip6 = (struct ip6_hdr *) data_ptr;
-   uint16_t hdr_len = sizeof(struct ip6_hdr);
+   hdr_len = sizeof(struct ip6_hdr);
    if (sizeof(struct ip6_hdr) > data_len) {
-      throw "Parser detected malformed packet";
+      return PARSER_TRUNCATED_L3;
    }
 
    pkt->ip_version = IP::v6;
@@ -313,6 +429,8 @@ inline uint16_t parse_ipv6_hdr(const u_char *data_ptr, uint16_t data_len, Packet
    pkt->ip_proto = ip6->ip6_ctlun.ip6_un1.ip6_un1_nxt;
    pkt->ip_ttl = ip6->ip6_ctlun.ip6_un1.ip6_un1_hlim;
    pkt->ip_flags = 0;
+   pkt->ip_frag = false;
+   pkt->ip_frag_off = 0;
    pkt->ip_payload_len = ntohs(ip6->ip6_ctlun.ip6_un1.ip6_un1_plen);
    pkt->ip_len = pkt->ip_payload_len + 40;
    memcpy(pkt->src_ip.v6, (const char *) &ip6->ip6_src, 16);
@@ -333,10 +451,13 @@ inline uint16_t parse_ipv6_hdr(const u_char *data_ptr, uint16_t data_len, Packet
    DEBUG_MSG("\tDest addr:\t%s\n",     buffer);
 
    if (pkt->ip_proto != IPPROTO_TCP && pkt->ip_proto != IPPROTO_UDP) {
-      hdr_len += skip_ipv6_ext_hdrs(data_ptr + hdr_len, data_len - hdr_len, pkt);
+      uint16_t ext_len;
+      ParserStatus status = skip_ipv6_ext_hdrs(data_ptr + hdr_len, data_len - hdr_len, pkt, ext_len);
+      hdr_len += ext_len;
+      return status;
    }
 
-   return hdr_len;
+   return PARSER_OK;
 }
 
 /**
@@ -344,13 +465,14 @@ inline uint16_t parse_ipv6_hdr(const u_char *data_ptr, uint16_t data_len, Packet
  * \param [in] data_ptr Pointer to begin of header.
  * \param [in] data_len Length of packet data in `data_ptr`.
  * \param [out] pkt Pointer to Packet structure where parsed fields will be stored.
- * \return Size of header in bytes.
+ * \param [out] hdr_len Size of header in bytes.
+ * \return PARSER_OK or reason of malformed packet.
  */
-inline uint16_t parse_tcp_hdr(const u_char *data_ptr, uint16_t data_len, Packet *pkt)
+inline ParserStatus parse_tcp_hdr(const u_char *data_ptr, uint16_t data_len, Packet *pkt, uint16_t &hdr_len)
 {
    struct tcphdr *tcp = (struct tcphdr *) data_ptr;
    if (sizeof(struct tcphdr) > data_len) {
-      throw "Parser detected malformed packet";
+      return PARSER_TRUNCATED_L4;
    }
 
    pkt->src_port = ntohs(tcp->source);
@@ -373,21 +495,21 @@ inline uint16_t parse_tcp_hdr(const u_char *data_ptr, uint16_t data_len, Packet
    DEBUG_MSG("\tReserved1:\t%#x\n", tcp->res1);
    DEBUG_MSG("\tReserved2:\t%#x\n", tcp->res2);
 
-   int hdr_len = tcp->doff << 2;
+   hdr_len = tcp->doff << 2;
    int hdr_opt_len = hdr_len - sizeof(struct tcphdr);
    int i = 0;
    DEBUG_MSG("\tTCP_OPTIONS (%uB):\n", hdr_opt_len);
    if (hdr_len > data_len) {
-      throw "Parser detected malformed packet";
+      return PARSER_BAD_HDR_LEN;
    }
    while (i < hdr_opt_len) {
       uint8_t *opt_ptr = (uint8_t *) data_ptr + sizeof(struct tcphdr) + i;
       uint8_t opt_kind = *opt_ptr;
       if (i + 1 >= hdr_opt_len) {
          if (opt_kind <= 1) {
-            return hdr_len;
+            return PARSER_OK;
          }
-         throw "Parser detected malformed packet";
+         return PARSER_BAD_TCP_OPTIONS;
       }
       uint8_t opt_len = (opt_kind <= 1 ? 1 : *(opt_ptr + 1));
       DEBUG_MSG("\t\t%u: len=%u\n", opt_kind, opt_len);
@@ -401,12 +523,12 @@ inline uint16_t parse_tcp_hdr(const u_char *data_ptr, uint16_t data_len, Packet
       }
       if (opt_len == 0) {
          // Prevent infinity loop
-         throw "Parser detected malformed packet";
+         return PARSER_BAD_TCP_OPTIONS;
       }
       i += opt_len;
    }
 
-   return hdr_len;
+   return PARSER_OK;
 }
 
 /**
@@ -414,13 +536,14 @@ inline uint16_t parse_tcp_hdr(const u_char *data_ptr, uint16_t data_len, Packet
  * \param [in] data_ptr Pointer to begin of header.
  * \param [in] data_len Length of packet data in `data_ptr`.
  * \param [out] pkt Pointer to Packet structure where parsed fields will be stored.
- * \return Size of header in bytes.
+ * \param [out] hdr_len Size of header in bytes.
+ * \return PARSER_OK or reason of malformed packet.
  */
-inline uint16_t parse_udp_hdr(const u_char *data_ptr, uint16_t data_len, Packet *pkt)
+inline ParserStatus parse_udp_hdr(const u_char *data_ptr, uint16_t data_len, Packet *pkt, uint16_t &hdr_len)
 {
    struct udphdr *udp = (struct udphdr *) data_ptr;
    if (sizeof(struct udphdr) > data_len) {
-      throw "Parser detected malformed packet";
+      return PARSER_TRUNCATED_L4;
    }
 
    pkt->src_port = ntohs(udp->source);
@@ -432,7 +555,8 @@ inline uint16_t parse_udp_hdr(const u_char *data_ptr, uint16_t data_len, Packet
    DEBUG_MSG("\tLength:\t\t%u\n",   ntohs(udp->len));
    DEBUG_MSG("\tChecksum:\t%#06x\n",ntohs(udp->check));
 
-   return 8;
+   hdr_len = sizeof(struct udphdr);
+   return PARSER_OK;
 }
 
 /**
@@ -440,13 +564,14 @@ inline uint16_t parse_udp_hdr(const u_char *data_ptr, uint16_t data_len, Packet
  * \param [in] data_ptr Pointer to begin of header.
  * \param [in] data_len Length of packet data in `data_ptr`.
  * \param [out] pkt Pointer to Packet structure where parsed fields will be stored.
- * \return Size of header in bytes.
+ * \param [out] hdr_len Size of header in bytes.
+ * \return PARSER_OK or reason of malformed packet.
  */
-inline uint16_t parse_icmp_hdr(const u_char *data_ptr, uint16_t data_len, Packet *pkt)
+inline ParserStatus parse_icmp_hdr(const u_char *data_ptr, uint16_t data_len, Packet *pkt, uint16_t &hdr_len)
 {
    struct icmphdr *icmp = (struct icmphdr *) data_ptr;
    if (sizeof(struct icmphdr) > data_len) {
-      throw "Parser detected malformed packet";
+      return PARSER_TRUNCATED_L4;
    }
    pkt->dst_port = icmp->type * 256 + icmp->code;
 
@@ -456,7 +581,8 @@ inline uint16_t parse_icmp_hdr(const u_char *data_ptr, uint16_t data_len, Packet
    DEBUG_MSG("\tChecksum:\t%#06x\n",ntohs(icmp->checksum));
    DEBUG_MSG("\tRest:\t\t%#06x\n",  ntohl(*(uint32_t *) &icmp->un));
 
-   return 0;
+   hdr_len = 0;
+   return PARSER_OK;
 }
 
 /**
@@ -464,13 +590,14 @@ inline uint16_t parse_icmp_hdr(const u_char *data_ptr, uint16_t data_len, Packet
  * \param [in] data_ptr Pointer to begin of header.
  * \param [in] data_len Length of packet data in `data_ptr`.
  * \param [out] pkt Pointer to Packet structure where parsed fields will be stored.
- * \return Size of header in bytes.
+ * \param [out] hdr_len Size of header in bytes.
+ * \return PARSER_OK or reason of malformed packet.
  */
-inline uint16_t parse_icmpv6_hdr(const u_char *data_ptr, uint16_t data_len, Packet *pkt)
+inline ParserStatus parse_icmpv6_hdr(const u_char *data_ptr, uint16_t data_len, Packet *pkt, uint16_t &hdr_len)
 {
    struct icmp6_hdr *icmp6 = (struct icmp6_hdr *) data_ptr;
    if (sizeof(struct icmp6_hdr) > data_len) {
-      throw "Parser detected malformed packet";
+      return PARSER_TRUNCATED_L4;
    }
    pkt->dst_port = icmp6->icmp6_type * 256 + icmp6->icmp6_code;
 
@@ -480,25 +607,27 @@ inline uint16_t parse_icmpv6_hdr(const u_char *data_ptr, uint16_t data_len, Pack
    DEBUG_MSG("\tChecksum:\t%#x\n",  ntohs(icmp6->icmp6_cksum));
    DEBUG_MSG("\tBody:\t\t%#x\n",    ntohs(*(uint32_t *) &icmp6->icmp6_dataun));
 
-   return 0;
+   hdr_len = 0;
+   return PARSER_OK;
 }
 
 /**
  * \brief Skip MPLS stack.
  * \param [in] data_ptr Pointer to begin of header.
  * \param [in] data_len Length of packet data in `data_ptr`.
- * \return Size of headers in bytes.
+ * \param [out] length Size of headers in bytes.
+ * \return PARSER_OK or reason of malformed packet.
  */
-uint16_t process_mpls_stack(const u_char *data_ptr, uint16_t data_len)
+ParserStatus process_mpls_stack(const u_char *data_ptr, uint16_t data_len, uint16_t &length)
 {
    uint32_t *mpls;
-   uint16_t length = 0;
+   length = 0;
 
    do {
       mpls = (uint32_t *) (data_ptr + length);
       length += sizeof(uint32_t);
       if (0 > data_len - length) {
-         throw "Parser detected malformed packet";
+         return PARSER_TRUNCATED_L2;
       }
 
       DEBUG_MSG("MPLS:\n");
@@ -509,55 +638,54 @@ uint16_t process_mpls_stack(const u_char *data_ptr, uint16_t data_len)
 
     } while (!(ntohl(*mpls) & 0x100));
 
-   return length;
+   return PARSER_OK;
 }
 
 /**
- * \brief Skip MPLS stack and parse the following header.
+ * \brief Skip MPLS stack and detect the following header.
  * \param [in] data_ptr Pointer to begin of header.
  * \param [in] data_len Length of packet data in `data_ptr`.
- * \param [out] pkt Pointer to Packet structure where parsed fields will be stored.
- * \return Size of parsed data in bytes.
+ * \param [out] next Layer following the MPLS stack.
+ * \param [out] hdr_len Size of headers in bytes.
+ * \return PARSER_OK or reason of malformed packet.
  */
-uint16_t process_mpls(const u_char *data_ptr, uint16_t data_len, Packet *pkt)
+inline ParserStatus parse_mpls(const u_char *data_ptr, uint16_t data_len, ParserLayer &next, uint16_t &hdr_len)
 {
-   Packet tmp;
-   uint16_t length = process_mpls_stack(data_ptr, data_len);
-   uint8_t next_hdr = (*(data_ptr + length) & 0xF0) >> 4;
+   if (process_mpls_stack(data_ptr, data_len, hdr_len) != PARSER_OK || hdr_len >= data_len) {
+      return PARSER_TRUNCATED_L2;
+   }
+   uint8_t next_hdr = (*(data_ptr + hdr_len) & 0xF0) >> 4;
 
    if (next_hdr == IP::v4) {
-      length += parse_ipv4_hdr(data_ptr + length, data_len - length, pkt);
+      next = LAYER_IPV4;
    } else if (next_hdr == IP::v6) {
-      length += parse_ipv6_hdr(data_ptr + length, data_len - length, pkt);
+      next = LAYER_IPV6;
    } else if (next_hdr == 0) {
       /* Process EoMPLS */
-      length += 4; /* Skip Pseudo Wire Ethernet control word. */
-      length = parse_eth_hdr(data_ptr + length, data_len - length, &tmp);
-      if (tmp.ethertype == ETH_P_IP) {
-         length += parse_ipv4_hdr(data_ptr + length, data_len - length, pkt);
-      } else if (tmp.ethertype == ETH_P_IPV6) {
-         length += parse_ipv6_hdr(data_ptr + length, data_len - length, pkt);
-      }
+      hdr_len += 4; /* Skip Pseudo Wire Ethernet control word. */
+      next = LAYER_ETH;
+   } else {
+      next = LAYER_END;
    }
 
-   return length;
+   return PARSER_OK;
 }
 
 /**
- * \brief Parse PPPOE header and the following IP header.
+ * \brief Parse PPPOE header and detect the following IP header.
  * \param [in] data_ptr Pointer to begin of header.
  * \param [in] data_len Length of packet data in `data_ptr`.
- * \param [out] pkt Pointer to Packet structure where parsed fields will be stored.
- * \return Size of parsed data in bytes.
+ * \param [out] next Layer following the PPP header.
+ * \param [out] hdr_len Size of headers in bytes.
+ * \return PARSER_OK or reason of malformed packet.
  */
-inline uint16_t process_pppoe(const u_char *data_ptr, uint16_t data_len, Packet *pkt)
+inline ParserStatus parse_pppoe(const u_char *data_ptr, uint16_t data_len, ParserLayer &next, uint16_t &hdr_len)
 {
    struct pppoe_hdr *pppoe = (struct pppoe_hdr *) data_ptr;
    if (sizeof(struct pppoe_hdr) + 2 > data_len) {
-      throw "Parser detected malformed packet";
+      return PARSER_TRUNCATED_L2;
    }
    uint16_t next_hdr = ntohs(*(uint16_t *) (data_ptr + sizeof(struct pppoe_hdr)));
-   uint16_t length = sizeof(struct pppoe_hdr) + 2;
 
    DEBUG_MSG("PPPoE header:\n");
    DEBUG_MSG("\tVer:\t%u\n",     pppoe->version);
@@ -567,110 +695,542 @@ inline uint16_t process_pppoe(const u_char *data_ptr, uint16_t data_len, Packet
    DEBUG_MSG("\tLength:\t%u\n",  ntohs(pppoe->length));
    DEBUG_MSG("PPP header:\n");
    DEBUG_MSG("\tProtocol:\t%#04x\n", next_hdr);
-   if (pppoe->code != 0) {
-      return length;
+
+   next = LAYER_END;
+   if (pppoe->code == 0) {
+      if (next_hdr == 0x0021) {
+         next = LAYER_IPV4;
+      } else if (next_hdr == 0x0057) {
+         next = LAYER_IPV6;
+      }
    }
 
-   if (next_hdr == 0x0021) {
-      length += parse_ipv4_hdr(data_ptr + length, data_len - length, pkt);
-   } else if (next_hdr == 0x0057) {
-      length += parse_ipv6_hdr(data_ptr + length, data_len - length, pkt);
+   hdr_len = sizeof(struct pppoe_hdr) + 2;
+   return PARSER_OK;
+}
+
+/**
+ * \brief Parse GRE header.
+ * \param [in] data_ptr Pointer to begin of header.
+ * \param [in] data_len Length of packet data in `data_ptr`.
+ * \param [out] id GRE key or 0.
+ * \param [out] next Encapsulated layer, LAYER_END when packet cannot be decapsulated.
+ * \return Size of header in bytes.
+ */
+inline uint16_t parse_gre_hdr(const u_char *data_ptr, uint16_t data_len, uint32_t &id, ParserLayer &next)
+{
+   struct gre_hdr *gre = (struct gre_hdr *) data_ptr;
+   next = LAYER_END;
+   if (sizeof(struct gre_hdr) > data_len) {
+      return 0;
+   }
+   uint16_t flags = ntohs(gre->flags);
+   uint16_t hdr_len = sizeof(struct gre_hdr);
+
+   DEBUG_MSG("GRE header:\n");
+   DEBUG_MSG("\tFlags:\t\t%#06x\n",    flags);
+   DEBUG_MSG("\tProtocol:\t%#06x\n",   ntohs(gre->proto));
+
+   if (flags & GRE_VERSION_MASK) {
+      // Enhanced GRE used by PPTP is not decapsulated
+      return 0;
+   }
+   if (flags & GRE_FLAG_CSUM) {
+      hdr_len += 4;
+   }
+   id = 0;
+   if (flags & GRE_FLAG_KEY) {
+      if (hdr_len + 4 > data_len) {
+         return 0;
+      }
+      id = ntohl(*(uint32_t *) (data_ptr + hdr_len));
+      hdr_len += 4;
+   }
+   if (flags & GRE_FLAG_SEQ) {
+      hdr_len += 4;
+   }
+   if (hdr_len > data_len) {
+      return 0;
    }
 
-   return length;
+   next = ethertype_layer(ntohs(gre->proto));
+   return hdr_len;
 }
 
-void parse_packet(parser_opt_t *opt, struct timeval ts, const uint8_t *data, uint16_t len, uint16_t caplen)
+/**
+ * \brief Parse VXLAN header.
+ * \param [in] data_ptr Pointer to begin of header.
+ * \param [in] data_len Length of packet data in `data_ptr`.
+ * \param [out] id VXLAN network identifier.
+ * \param [out] next Encapsulated layer, LAYER_END when packet cannot be decapsulated.
+ * \return Size of header in bytes.
+ */
+inline uint16_t parse_vxlan_hdr(const u_char *data_ptr, uint16_t data_len, uint32_t &id, ParserLayer &next)
 {
-   if (opt->pblock->cnt >= opt->pblock->size) {
-      return;
+   struct vxlan_hdr *vxlan = (struct vxlan_hdr *) data_ptr;
+   next = LAYER_END;
+   if (sizeof(struct vxlan_hdr) > data_len || !(vxlan->flags & VXLAN_FLAG_VNI)) {
+      return 0;
    }
-   Packet *pkt = &opt->pblock->pkts[opt->pblock->cnt];
-   uint16_t data_offset = 0;
+   id = ntohl(vxlan->vni) >> 8;
 
-   DEBUG_MSG("---------- packet parser  #%u -------------\n", ++s_total_pkts);
-   DEBUG_CODE(
-      char timestamp[32];
-      time_t time = ts.tv_sec;
-      strftime(timestamp, sizeof(timestamp), "%FT%T", localtime(&time));
-   );
-   DEBUG_MSG("Time:\t\t\t%s.%06lu\n",     timestamp, ts.tv_usec);
-   DEBUG_MSG("Packet length:\t\tcaplen=%uB len=%uB\n\n", caplen, len);
+   DEBUG_MSG("VXLAN header:\n");
+   DEBUG_MSG("\tFlags:\t\t%#04x\n",  vxlan->flags);
+   DEBUG_MSG("\tVNI:\t\t%u\n",       id);
 
-   pkt->packet_len_wire = len;
-   pkt->ts = ts;
+   next = LAYER_ETH;
+   return sizeof(struct vxlan_hdr);
+}
+
+/**
+ * \brief Parse GENEVE header.
+ * \param [in] data_ptr Pointer to begin of header.
+ * \param [in] data_len Length of packet data in `data_ptr`.
+ * \param [out] id Virtual network identifier.
+ * \param [out] next Encapsulated layer, LAYER_END when packet cannot be decapsulated.
+ * \return Size of header in bytes.
+ */
+inline uint16_t parse_geneve_hdr(const u_char *data_ptr, uint16_t data_len, uint32_t &id, ParserLayer &next)
+{
+   struct geneve_hdr *geneve = (struct geneve_hdr *) data_ptr;
+   next = LAYER_END;
+   if (sizeof(struct geneve_hdr) > data_len || (geneve->ver_opt_len >> 6) != 0) {
+      return 0;
+   }
+   uint16_t hdr_len = sizeof(struct geneve_hdr) + ((geneve->ver_opt_len & 0x3F) << 2);
+   if (hdr_len > data_len) {
+      return 0;
+   }
+   id = ntohl(geneve->vni) >> 8;
+
+   DEBUG_MSG("GENEVE header:\n");
+   DEBUG_MSG("\tOpt length:\t%u\n",  (geneve->ver_opt_len & 0x3F) << 2);
+   DEBUG_MSG("\tProtocol:\t%#06x\n", ntohs(geneve->proto));
+   DEBUG_MSG("\tVNI:\t\t%u\n",       id);
+
+   next = ethertype_layer(ntohs(geneve->proto));
+   return hdr_len;
+}
+
+/**
+ * \brief Parse GTP-U header including extension headers.
+ * \param [in] data_ptr Pointer to begin of header.
+ * \param [in] data_len Length of packet data in `data_ptr`.
+ * \param [out] id Tunnel endpoint identifier.
+ * \param [out] next Encapsulated layer, LAYER_END when packet cannot be decapsulated.
+ * \return Size of headers in bytes.
+ */
+inline uint16_t parse_gtpu_hdr(const u_char *data_ptr, uint16_t data_len, uint32_t &id, ParserLayer &next)
+{
+   struct gtpu_hdr *gtpu = (struct gtpu_hdr *) data_ptr;
+   next = LAYER_END;
+   if (sizeof(struct gtpu_hdr) > data_len || (gtpu->flags >> 5) != 1 || !(gtpu->flags & GTPU_FLAG_PT) ||
+      gtpu->type != GTPU_TYPE_GPDU) {
+      // Only GTPv1 user data are decapsulated
+      return 0;
+   }
+   uint16_t hdr_len = sizeof(struct gtpu_hdr);
+
+   DEBUG_MSG("GTP-U header:\n");
+   DEBUG_MSG("\tFlags:\t\t%#04x\n",  gtpu->flags);
+   DEBUG_MSG("\tTEID:\t\t%u\n",      ntohl(gtpu->teid));
+
+   if (gtpu->flags & GTPU_FLAGS_OPT) {
+      // Sequence number, N-PDU number and next extension header type
+      if (hdr_len + 4 > data_len) {
+         return 0;
+      }
+      uint8_t ext_type = (gtpu->flags & GTPU_FLAG_E) ? data_ptr[hdr_len + 3] : 0;
+      hdr_len += 4;
+      while (ext_type) {
+         if (hdr_len >= data_len) {
+            return 0;
+         }
+         uint16_t ext_len = data_ptr[hdr_len] << 2;
+         if (ext_len == 0 || hdr_len + ext_len > data_len) {
+            return 0;
+         }
+         DEBUG_MSG("\tExtension:\t%#04x (%u B)\n", ext_type, ext_len);
+         ext_type = data_ptr[hdr_len + ext_len - 1];
+         hdr_len += ext_len;
+      }
+   }
+   if (hdr_len >= data_len) {
+      return 0;
+   }
+   id = ntohl(gtpu->teid);
+
+   uint8_t version = data_ptr[hdr_len] >> 4;
+   if (version == IP::v4) {
+      next = LAYER_IPV4;
+   } else if (version == IP::v6) {
+      next = LAYER_IPV6;
+   }
+   return hdr_len;
+}
+
+/**
+ * \brief Parse tunnel header.
+ * \param [in] layer Tunnel layer.
+ * \param [in] data_ptr Pointer to begin of header.
+ * \param [in] data_len Length of packet data in `data_ptr`.
+ * \param [out] type Type of tunnel.
+ * \param [out] id Tunnel identifier.
+ * \param [out] next Encapsulated layer, LAYER_END when packet cannot be decapsulated.
+ * \return Size of headers in bytes.
+ */
+inline uint16_t parse_tunnel_hdr(ParserLayer layer, const u_char *data_ptr, uint16_t data_len, uint8_t &type, uint32_t &id,
+   ParserLayer &next)
+{
+   id = 0;
+   switch (layer) {
+   case LAYER_GRE:
+      type = TUNNEL_GRE;
+      return parse_gre_hdr(data_ptr, data_len, id, next);
+   case LAYER_IPIP:
+      type = TUNNEL_IPIP;
+      next = LAYER_IPV4;
+      return 0;
+   case LAYER_IP6IP:
+      type = TUNNEL_IPIP;
+      next = LAYER_IPV6;
+      return 0;
+   case LAYER_VXLAN:
+      type = TUNNEL_VXLAN;
+      return parse_vxlan_hdr(data_ptr, data_len, id, next);
+   case LAYER_GENEVE:
+      type = TUNNEL_GENEVE;
+      return parse_geneve_hdr(data_ptr, data_len, id, next);
+   case LAYER_GTPU:
+      type = TUNNEL_GTPU;
+      return parse_gtpu_hdr(data_ptr, data_len, id, next);
+   default:
+      next = LAYER_END;
+      return 0;
+   }
+}
+
+/**
+ * \brief Parse untagged or single VLAN tagged Ethernet frame with IPv4 or IPv6 header directly followed by TCP or UDP.
+ *
+ * Headers are read from fixed offsets without walking the protocol graph. Fields reset by the general parser
+ * are written here, so packets of the common shape skip the reset as well.
+ * \param [in] opt Parser options.
+ * \param [in] data Packet data.
+ * \param [in] caplen Length of captured packet data.
+ * \param [out] pkt Pointer to Packet structure where parsed fields will be stored.
+ * \param [out] data_offset Offset of payload.
+ * \param [out] l3_hdr_offset Offset of IP header.
+ * \param [out] l4_hdr_offset Offset of transport header.
+ * \return False when packet has to be parsed by the general parser.
+ */
+inline bool parse_fast_path(const parser_opt_t *opt, const uint8_t *data, uint16_t caplen, Packet *pkt,
+   uint32_t &data_offset, uint32_t &l3_hdr_offset, uint32_t &l4_hdr_offset)
+{
+   if (opt->datalink != DLT_EN10MB) {
+      return false;
+   }
+   // Ethertypes are compared in network byte order
+   uint32_t l3 = sizeof(struct ethhdr);
+   uint16_t ethertype;
+   if (caplen < l3 + 4 + sizeof(struct iphdr)) {
+      return false;
+   }
+   memcpy(&ethertype, data + l3 - 2, sizeof(ethertype));
+   if (ethertype == htons(ETH_P_8021Q)) {
+      l3 += 4;
+      memcpy(&ethertype, data + l3 - 2, sizeof(ethertype));
+   }
+
+   uint32_t l4;
+   uint8_t proto;
+   if (ethertype == htons(ETH_P_IP)) {
+      const struct iphdr *ip = (const struct iphdr *) (data + l3);
+      if (caplen < l3 + sizeof(struct iphdr) || ip->version != IP::v4 || ip->ihl < 5 || (ip->frag_off & htons(IP_MF | IP_OFFMASK))) {
+         return false;
+      }
+      proto = ip->protocol;
+      l4 = l3 + (ip->ihl << 2);
+      if (proto != IPPROTO_TCP && proto != IPPROTO_UDP) {
+         return false;
+      }
+      pkt->ip_version = IP::v4;
+      pkt->ip_tos = ip->tos;
+      pkt->ip_len = ntohs(ip->tot_len);
+      pkt->ip_payload_len = pkt->ip_len - (ip->ihl << 2);
+      pkt->ip_ttl = ip->ttl;
+      pkt->ip_flags = (ntohs(ip->frag_off) & 0xE000) >> 13;
+      pkt->ip_frag_id = ntohs(ip->id);
+      pkt->src_ip.v4 = ip->saddr;
+      pkt->dst_ip.v4 = ip->daddr;
+   } else if (ethertype == htons(ETH_P_IPV6)) {
+      const struct ip6_hdr *ip6 = (const struct ip6_hdr *) (data + l3);
+      if (caplen < l3 + sizeof(struct ip6_hdr)) {
+         return false;
+      }
+      proto = ip6->ip6_ctlun.ip6_un1.ip6_un1_nxt;
+      l4 = l3 + sizeof(struct ip6_hdr);
+      if (proto != IPPROTO_TCP && proto != IPPROTO_UDP) {
+         return false;
+      }
+      uint32_t flow = ntohl(ip6->ip6_ctlun.ip6_un1.ip6_un1_flow);
+      pkt->ip_version = IP::v6;
+      pkt->ip_tos = (flow & 0x0ff00000) >> 20;
+      pkt->ip_ttl = ip6->ip6_ctlun.ip6_un1.ip6_un1_hlim;
+      pkt->ip_flags = 0;
+      pkt->ip_payload_len = ntohs(ip6->ip6_ctlun.ip6_un1.ip6_un1_plen);
+      pkt->ip_len = pkt->ip_payload_len + sizeof(struct ip6_hdr);
+      memcpy(pkt->src_ip.v6, &ip6->ip6_src, sizeof(pkt->src_ip.v6));
+      memcpy(pkt->dst_ip.v6, &ip6->ip6_dst, sizeof(pkt->dst_ip.v6));
+   } else {
+      return false;
+   }
+
+   uint16_t hdr_len;
+   if (l4 + sizeof(struct udphdr) > caplen) {
+      return false;
+   }
+   if (proto == IPPROTO_TCP) {
+      pkt->tcp_options = 0;
+      pkt->tcp_mss = 0;
+      if (parse_tcp_hdr(data + l4, caplen - l4, pkt, hdr_len) != PARSER_OK) {
+         return false;
+      }
+   } else {
+      uint32_t ports;
+      memcpy(&ports, data + l4, sizeof(ports));
+      ports = ntohl(ports);
+      pkt->src_port = ports >> 16;
+      pkt->dst_port = ports & 0xFFFF;
+      if (opt->decap_depth && udp_tunnel_layer(pkt->dst_port) != LAYER_END) {
+         return false;
+      }
+      pkt->tcp_flags = 0;
+      pkt->tcp_window = 0;
+      pkt->tcp_options = 0;
+      pkt->tcp_mss = 0;
+      hdr_len = sizeof(struct udphdr);
+   }
+
+   memcpy(pkt->dst_mac, data, sizeof(pkt->dst_mac));
+   memcpy(pkt->src_mac, data + sizeof(pkt->dst_mac), sizeof(pkt->src_mac));
+   pkt->ethertype = ntohs(ethertype);
+   pkt->ip_proto = proto;
+   pkt->ip_frag = false;
+   pkt->ip_frag_off = 0;
+   pkt->tunnel_type = TUNNEL_NONE;
+   pkt->tunnel_depth = 0;
+
+   l3_hdr_offset = l3;
+   l4_hdr_offset = l4;
+   data_offset = l4 + hdr_len;
+   return true;
+}
+
+/**
+ * \brief Parse packet headers by walking the protocol graph.
+ * \param [in] opt Parser options.
+ * \param [in] ts Timestamp of packet.
+ * \param [in] data Packet data.
+ * \param [in] len Length of packet on wire.
+ * \param [in] caplen Length of captured packet data.
+ * \param [out] pkt Pointer to Packet structure where parsed fields will be stored.
+ * \param [out] data_offset Offset of payload.
+ * \param [out] l3_hdr_offset Offset of innermost IP header.
+ * \param [out] l4_hdr_offset Offset of innermost transport header.
+ * \return False when packet should not be stored.
+ */
+bool parse_headers(parser_opt_t *opt, timestamp_t ts, const uint8_t *data, uint16_t len, uint16_t caplen, Packet *pkt,
+   uint32_t &data_offset, uint32_t &l3_hdr_offset, uint32_t &l4_hdr_offset)
+{
    pkt->src_port = 0;
    pkt->dst_port = 0;
    pkt->ip_proto = 0;
    pkt->ip_ttl = 0;
    pkt->ip_flags = 0;
    pkt->ip_version = 0;
+   pkt->ip_frag = false;
+   pkt->ip_frag_off = 0;
    pkt->ip_payload_len = 0;
    pkt->tcp_flags = 0;
    pkt->tcp_window = 0;
    pkt->tcp_options = 0;
    pkt->tcp_mss = 0;
+   pkt->tunnel_type = TUNNEL_NONE;
+   pkt->tunnel_depth = 0;
+
+   ParserLayer layer;
+   uint16_t hdr_len = 0;
+   ParserStatus status = PARSER_OK;
+   // File inputs read link types other than Ethernet also without libpcap
+   if (opt->datalink == DLT_EN10MB) {
+      status = parse_eth_hdr(data, caplen, pkt, hdr_len);
+   } else if (opt->datalink == DLT_LINUX_SLL) {
+      status = parse_sll(data, caplen, pkt, hdr_len);
+   } else if (opt->datalink == DLT_RAW) {
+      pkt->ethertype = 0;
+      if (caplen && (data[0] & 0xF0) == 0x40) {
+         pkt->ethertype = ETH_P_IP;
+      } else if (caplen && (data[0] & 0xF0) == 0x60) {
+         pkt->ethertype = ETH_P_IPV6;
+      }
+   }
+   data_offset = hdr_len;
+   layer = status == PARSER_OK ? ethertype_layer(pkt->ethertype) : LAYER_END;
+   if (status == PARSER_OK && layer == LAYER_END && !opt->parse_all) {
+      DEBUG_MSG("Unknown ethertype %x\n", pkt->ethertype);
+      return false;
+   }
 
-   uint32_t l3_hdr_offset = 0;
-   uint32_t l4_hdr_offset = 0;
-   try {
-   #ifdef WITH_PCAP
-      if (opt->datalink == DLT_EN10MB) {
-         data_offset = parse_eth_hdr(data, caplen, pkt);
-      } else if (opt->datalink == DLT_LINUX_SLL) {
-            data_offset = parse_sll(data, caplen, pkt);
-      } else if (opt->datalink == DLT_RAW) {
-            if ((data[0] & 0xF0) == 0x40) {
-               pkt->ethertype = ETH_P_IP;
-            } else if ((data[0] & 0xF0) == 0x60) {
-               pkt->ethertype = ETH_P_IPV6;
+   // Walk the protocol graph, each layer parses its header and selects the next layer
+   while (layer != LAYER_END) {
+      const u_char *hdr = data + data_offset;
+      uint16_t hdr_space = caplen - data_offset;
+      switch (layer) {
+      case LAYER_ETH:
+         status = parse_eth_hdr(hdr, hdr_space, pkt, hdr_len);
+         layer = ethertype_layer(pkt->ethertype);
+         if (status == PARSER_OK && layer == LAYER_END && !opt->parse_all) {
+            DEBUG_MSG("Unknown ethertype %x\n", pkt->ethertype);
+            return false;
+         }
+         break;
+      case LAYER_TRILL:
+         status = parse_trill(hdr, hdr_space, pkt, hdr_len);
+         layer = LAYER_ETH;
+         break;
+      case LAYER_MPLS:
+         status = parse_mpls(hdr, hdr_space, layer, hdr_len);
+         break;
+      case LAYER_PPPOE:
+         status = parse_pppoe(hdr, hdr_space, layer, hdr_len);
+         break;
+      case LAYER_IPV4:
+         status = parse_ipv4_hdr(hdr, hdr_space, pkt, hdr_len);
+         l3_hdr_offset = data_offset;
+         l4_hdr_offset = data_offset + hdr_len;
+         // Only first fragment carries transport header
+         layer = pkt->ip_frag_off ? LAYER_END : s_ip_proto_layers.layer[pkt->ip_proto];
+         break;
+      case LAYER_IPV6:
+         status = parse_ipv6_hdr(hdr, hdr_space, pkt, hdr_len);
+         l3_hdr_offset = data_offset;
+         l4_hdr_offset = data_offset + hdr_len;
+         layer = pkt->ip_frag_off ? LAYER_END : s_ip_proto_layers.layer[pkt->ip_proto];
+         break;
+      case LAYER_TCP:
+         status = parse_tcp_hdr(hdr, hdr_space, pkt, hdr_len);
+         layer = LAYER_END;
+         break;
+      case LAYER_UDP:
+         status = parse_udp_hdr(hdr, hdr_space, pkt, hdr_len);
+         layer = pkt->tunnel_depth < opt->decap_depth ? udp_tunnel_layer(pkt->dst_port) : LAYER_END;
+         break;
+      case LAYER_ICMP:
+         status = parse_icmp_hdr(hdr, hdr_space, pkt, hdr_len);
+         layer = LAYER_END;
+         break;
+      case LAYER_ICMPV6:
+         status = parse_icmpv6_hdr(hdr, hdr_space, pkt, hdr_len);
+         layer = LAYER_END;
+         break;
+      default:
+         {
+            // Tunnel headers, packet is kept as outer flow when it cannot be decapsulated
+            uint8_t tunnel_type = TUNNEL_NONE;
+            uint32_t tunnel_id = 0;
+            ParserLayer next = LAYER_END;
+            hdr_len = 0;
+            if (pkt->tunnel_depth < opt->decap_depth) {
+               hdr_len = parse_tunnel_hdr(layer, hdr, hdr_space, tunnel_type, tunnel_id, next);
+            }
+            if (next != LAYER_END && pkt->tunnel_depth++ == 0) {
+               pkt->tunnel_type = tunnel_type;
+               pkt->tunnel_id = tunnel_id;
+               pkt->outer_ip_version = pkt->ip_version;
+               pkt->outer_src_ip = pkt->src_ip;
+               pkt->outer_dst_ip = pkt->dst_ip;
             }
+            layer = next;
+         }
+         break;
       }
-   #else
-      data_offset = parse_eth_hdr(data, caplen, pkt);
-   #endif /* WITH_PCAP */
-
-      if (pkt->ethertype == ETH_P_TRILL) {
-         data_offset += parse_trill(data + data_offset, caplen - data_offset, pkt);
-         data_offset += parse_eth_hdr(data + data_offset, caplen - data_offset, pkt);
+      data_offset += hdr_len;
+      if (status == PARSER_OK && data_offset > caplen) {
+         status = PARSER_BAD_HDR_LEN;
       }
-      l3_hdr_offset = data_offset;
-      if (pkt->ethertype == ETH_P_IP) {
-         data_offset += parse_ipv4_hdr(data + data_offset, caplen - data_offset, pkt);
-      } else if (pkt->ethertype == ETH_P_IPV6) {
-         data_offset += parse_ipv6_hdr(data + data_offset, caplen - data_offset, pkt);
-      } else if (pkt->ethertype == ETH_P_MPLS_UC || pkt->ethertype == ETH_P_MPLS_MC) {
-         data_offset += process_mpls(data + data_offset, caplen - data_offset, pkt);
-      } else if (pkt->ethertype == ETH_P_PPP_SES) {
-         data_offset += process_pppoe(data + data_offset, caplen - data_offset, pkt);
-      } else if (!opt->parse_all) {
-         DEBUG_MSG("Unknown ethertype %x\n", pkt->ethertype);
-         return;
+      if (status != PARSER_OK) {
+         break;
       }
+   }
 
-      l4_hdr_offset = data_offset;
-      if (pkt->ip_proto == IPPROTO_TCP) {
-         data_offset += parse_tcp_hdr(data + data_offset, caplen - data_offset, pkt);
-      } else if (pkt->ip_proto == IPPROTO_UDP) {
-         data_offset += parse_udp_hdr(data + data_offset, caplen - data_offset, pkt);
-      } else if (pkt->ip_proto == IPPROTO_ICMP) {
-         data_offset += parse_icmp_hdr(data + data_offset, caplen - data_offset, pkt);
-      } else if (pkt->ip_proto == IPPROTO_ICMPV6) {
-         data_offset += parse_icmpv6_hdr(data + data_offset, caplen - data_offset, pkt);
+   if (status != PARSER_OK) {
+      DEBUG_MSG("Parser detected malformed packet, reason %u\n", status);
+      if (pkt->tunnel_depth) {
+         // Encapsulated data are malformed, parse packet again without the last tunnel
+         parser_opt_t outer = *opt;
+         outer.decap_depth = pkt->tunnel_depth - 1;
+         parse_packet(&outer, ts, data, len, caplen);
+      } else if (opt->malformed != nullptr) {
+         opt->malformed[status]++;
       }
-   } catch (const char *err) {
-      DEBUG_MSG("%s\n", err);
+      return false;
+   }
+
+   return true;
+}
+
+void parse_packet(parser_opt_t *opt, timestamp_t ts, const uint8_t *data, uint16_t len, uint16_t caplen)
+{
+   if (opt->pblock->cnt >= opt->pblock->size) {
+      return;
+   }
+   Packet *pkt = &opt->pblock->pkts[opt->pblock->cnt];
+
+   DEBUG_MSG("---------- packet parser  #%u -------------\n", ++s_total_pkts);
+   DEBUG_CODE(
+      char timestamp[32];
+      time_t time = ts_sec(ts);
+      strftime(timestamp, sizeof(timestamp), "%FT%T", localtime(&time));
+   );
+   DEBUG_MSG("Time:\t\t\t%s.%09u\n",     timestamp, ts_nsec(ts));
+   DEBUG_MSG("Packet length:\t\tcaplen=%uB len=%uB\n\n", caplen, len);
+
+   pkt->packet_len_wire = len;
+   pkt->ts = ts;
+   uint32_t data_offset = 0;
+   uint32_t l3_hdr_offset = 0;
+   uint32_t l4_hdr_offset = 0;
+   if (!parse_fast_path(opt, data, caplen, pkt, data_offset, l3_hdr_offset, l4_hdr_offset) &&
+      !parse_headers(opt, ts, data, len, caplen, pkt, data_offset, l3_hdr_offset, l4_hdr_offset)) {
       return;
    }
 
+   if (pkt->ip_frag && opt->fragments != nullptr) {
+      if (pkt->ip_frag_off) {
+         opt->fragments->lookup(*pkt);
+      } else {
+         opt->fragments->insert(*pkt);
+      }
+   }
+
    uint16_t pkt_len = caplen;
-   if ((int) pkt_len > pkt->buffer_size - 1) {
-      pkt_len = pkt->buffer_size - 1;
-      DEBUG_MSG("Packet size too long, truncating to %u\n", pkt_len);
+   if (data_offset < pkt_len && opt->payload_horizon < static_cast<uint32_t>(pkt_len - data_offset)) {
+      // Plugins do not need rest of the payload
+      pkt_len = data_offset + opt->payload_horizon;
+   }
+   if (opt->zero_copy) {
+      // Packet data stay in capture buffer owned by input plugin
+      pkt->packet = const_cast<uint8_t *>(data);
+   } else {
+      if ((int) pkt_len > pkt->buffer_size - 1) {
+         pkt_len = pkt->buffer_size - 1;
+         DEBUG_MSG("Packet size too long, truncating to %u\n", pkt_len);
+      }
+      pkt->packet = pkt->buffer;
+      memcpy(pkt->packet, data, pkt_len);
+      pkt->packet[pkt_len] = 0;
    }
-   pkt->packet = pkt->buffer;
-   memcpy(pkt->packet, data, pkt_len);
-   pkt->packet[pkt_len] = 0;
    pkt->packet_len = pkt_len;
 
    if (l4_hdr_offset != l3_hdr_offset) {
@@ -683,12 +1243,18 @@ void parse_packet(parser_opt_t *opt, struct timeval ts, const uint8_t *data, uin
       pkt->payload_len_wire = pkt_len - data_offset;
    }
 
-   pkt->payload_len = pkt->payload_len_wire;
-   if (pkt->payload_len + data_offset > pkt_len) {
-      // Set correct size when payload length is bigger than captured payload length
-      pkt->payload_len = pkt_len - data_offset;
+   if (data_offset >= pkt_len) {
+      // Headers are longer than captured data, no payload is available
+      pkt->payload_len = 0;
+      pkt->payload = pkt->packet + pkt_len;
+   } else {
+      pkt->payload_len = pkt->payload_len_wire;
+      if (pkt->payload_len + data_offset > pkt_len) {
+         // Set correct size when payload length is bigger than captured payload length
+         pkt->payload_len = pkt_len - data_offset;
+      }
+      pkt->payload = pkt->packet + data_offset;
    }
-   pkt->payload = pkt->packet + data_offset;
 
    DEBUG_MSG("Payload length:\t%u\n", pkt->payload_len);
    DEBUG_MSG("Packet parser exits: packet parsed\n");
@@ -45,6 +45,8 @@
 #define IPXP_INPUT_PARSER_HPP
 
 #include <ipfixprobe/packet.hpp>
+#include <ipfixprobe/fragment.hpp>
+#include <ipfixprobe/input.hpp>
 
 #ifndef DLT_EN10MB
 #define DLT_EN10MB 1
@@ -73,9 +75,14 @@ typedef struct parser_opt_s {
    bool packet_valid;
    bool parse_all;
    int datalink;
+   bool zero_copy;
+   uint32_t payload_horizon;
+   uint8_t decap_depth;
+   FragmentTable *fragments;
+   uint64_t *malformed; /**< Counters of malformed packets indexed by ParserStatus */
 } parser_opt_t;
 
-void parse_packet(parser_opt_t *opt, struct timeval ts, const uint8_t *data, uint16_t len, uint16_t caplen);
+void parse_packet(parser_opt_t *opt, timestamp_t ts, const uint8_t *data, uint16_t len, uint16_t caplen);
 
 }
 #endif /* IPXP_INPUT_PARSER_HPP */
@@ -76,13 +76,22 @@ void packet_handler(u_char *arg, const struct pcap_pkthdr *h, const u_char *data
    new_h.ts.tv_usec = *(reinterpret_cast<const uint32_t *>(h) + 1);
    new_h.caplen = *(reinterpret_cast<const uint32_t *>(h) + 2);
    new_h.len = *(reinterpret_cast<const uint32_t *>(h) + 3);
-   parse_packet((parser_opt_t *) arg, new_h.ts, data, new_h.len, new_h.caplen);
+   parse_packet((parser_opt_t *) arg, ts_from_timeval(new_h.ts), data, new_h.len, new_h.caplen);
 #else
-   parse_packet((parser_opt_t *) arg, h->ts, data, h->len, h->caplen);
+   parse_packet((parser_opt_t *) arg, ts_from_timeval(h->ts), data, h->len, h->caplen);
 #endif
 }
 
-PcapReader::PcapReader() : m_handle(nullptr), m_snaplen(-1), m_datalink(0), m_live(false), m_netmask(PCAP_NETMASK_UNKNOWN)
+/**
+ * \brief Parsing callback function for handles with nanosecond timestamp precision, tv_usec contains nanoseconds.
+ */
+void packet_handler_nsec(u_char *arg, const struct pcap_pkthdr *h, const u_char *data)
+{
+   parse_packet((parser_opt_t *) arg, ts_from_nsec(h->ts.tv_sec, h->ts.tv_usec), data, h->len, h->caplen);
+}
+
+PcapReader::PcapReader() : m_handle(nullptr), m_snaplen(-1), m_datalink(0), m_live(false), m_nsec(false),
+   m_netmask(PCAP_NETMASK_UNKNOWN), m_pending(false), m_pkt_hdr(nullptr), m_pkt_data(nullptr)
 {
 }
 
@@ -111,6 +120,15 @@ void PcapReader::init(const char *params)
    if (!parser.m_ifc.empty() && !parser.m_file.empty()) {
       throw PluginError("only one input can be specified");
    }
+   if ((parser.m_speed > 0 || parser.m_pps || parser.m_loops != 1) && parser.m_file.empty()) {
+      throw PluginError("speed, pps and loop options can be used with pcap file only");
+   }
+   if (parser.m_speed > 0 && parser.m_pps) {
+      throw PluginError("speed and pps options cannot be combined");
+   }
+   m_replay.init(parser.m_speed, parser.m_pps, parser.m_loops);
+   m_file = parser.m_file;
+   m_filter = parser.m_filter;
 
    m_snaplen = parser.m_snaplen;
    if (m_snaplen < MIN_SNAPLEN) {
@@ -144,7 +162,13 @@ void PcapReader::open_file(const std::string &file)
 {
    char errbuf[PCAP_ERRBUF_SIZE];
 
+#ifdef __CYGWIN__
    m_handle = pcap_open_offline(file.c_str(), errbuf);
+   m_nsec = false;
+#else
+   m_handle = pcap_open_offline_with_tstamp_precision(file.c_str(), PCAP_TSTAMP_PRECISION_NANO, errbuf);
+   m_nsec = true;
+#endif
    if (m_handle == nullptr) {
       throw PluginError(std::string("unable to open file: ") + errbuf);
    }
@@ -181,6 +205,7 @@ void PcapReader::open_ifc(const std::string &ifc)
    }
 
    m_live = true;
+   m_nsec = false;
 }
 
 void PcapReader::check_datalink(int datalink)
@@ -249,15 +274,19 @@ void PcapReader::set_filter(const std::string &filter_str)
 
 InputPlugin::Result PcapReader::get(PacketBlock &packets)
 {
-   parser_opt_t opt = {&packets, false, false, m_datalink};
+   parser_opt_t opt = {&packets, false, false, m_datalink, false, m_payload_horizon, m_decap_depth, &m_fragments, m_malformed};
    int ret;
 
    if (m_handle == nullptr) {
       throw PluginError("no interface capture or file opened");
    }
 
+   if (m_replay.enabled()) {
+      return replay(packets);
+   }
+
    packets.cnt = 0;
-   ret = pcap_dispatch(m_handle, packets.size, packet_handler, (u_char *) (&opt));
+   ret = pcap_dispatch(m_handle, packets.size, m_nsec ? packet_handler_nsec : packet_handler, (u_char *) (&opt));
    if (m_live) {
       if (ret == 0) {
          return Result::TIMEOUT;
@@ -282,4 +311,63 @@ InputPlugin::Result PcapReader::get(PacketBlock &packets)
    return Result::NOT_PARSED;
  }
 
+/**
+ * \brief Read packets one by one when the file is paced or looped.
+ * Packet which is not due yet is kept until next call, pcap_next_ex() keeps its data valid until then.
+ */
+InputPlugin::Result PcapReader::replay(PacketBlock &packets)
+{
+   parser_opt_t opt = {&packets, false, false, m_datalink, false, m_payload_horizon, m_decap_depth, &m_fragments, m_malformed};
+   bool waiting = false;
+
+   packets.cnt = 0;
+   while (packets.cnt < packets.size) {
+      if (!m_pending) {
+         int ret = pcap_next_ex(m_handle, &m_pkt_hdr, &m_pkt_data);
+         if (ret == PCAP_ERROR_BREAK) {
+            if (packets.cnt) {
+               break;
+            }
+            if (!m_replay.rewind()) {
+               return Result::END_OF_FILE;
+            }
+            close();
+            open_file(m_file);
+            if (!m_filter.empty()) {
+               set_filter(m_filter);
+            }
+            continue;
+         } else if (ret < 0) {
+            throw PluginError(pcap_geterr(m_handle));
+         }
+         m_pending = true;
+      }
+
+#ifdef __CYGWIN__
+      // See packet_handler()
+      const uint32_t *h = reinterpret_cast<const uint32_t *>(m_pkt_hdr);
+      timestamp_t ts = ts_from_usec(h[0], h[1]);
+      uint32_t caplen = h[2];
+      uint32_t len = h[3];
+#else
+      timestamp_t ts = m_nsec ? ts_from_nsec(m_pkt_hdr->ts.tv_sec, m_pkt_hdr->ts.tv_usec) : ts_from_timeval(m_pkt_hdr->ts);
+      uint32_t caplen = m_pkt_hdr->caplen;
+      uint32_t len = m_pkt_hdr->len;
+#endif
+      if (!m_replay.due(ts)) {
+         waiting = true;
+         break;
+      }
+      m_pending = false;
+      m_seen++;
+      parse_packet(&opt, m_replay.consume(ts), m_pkt_data, len, caplen);
+   }
+
+   m_parsed += packets.cnt;
+   if (!packets.cnt) {
+      return waiting ? Result::TIMEOUT : Result::NOT_PARSED;
+   }
+   return Result::PARSED;
+}
+
 }
@@ -51,6 +51,8 @@
 #include <ipfixprobe/options.hpp>
 #include <ipfixprobe/utils.hpp>
 
+#include "replay.hpp"
+
 namespace ipxp {
 
 /*
@@ -75,9 +77,12 @@ public:
    uint16_t m_snaplen;
    uint64_t m_id;
    bool m_list;
+   double m_speed;
+   uint64_t m_pps;
+   uint32_t m_loops;
 
    PcapOptParser() : OptionsParser("pcap", "Input plugin for reading packets from a pcap file or a network interface"),
-      m_file(""), m_ifc(""), m_filter(""), m_snaplen(-1), m_id(0), m_list(false)
+      m_file(""), m_ifc(""), m_filter(""), m_snaplen(-1), m_id(0), m_list(false), m_speed(0), m_pps(0), m_loops(1)
    {
       register_option("f", "file", "PATH", "Path to a pcap file", [this](const char *arg){m_file = arg; return true;}, OptionFlags::RequiredArgument);
       register_option("i", "ifc", "IFC", "Network interface name", [this](const char *arg){m_ifc = arg; return true;}, OptionFlags::RequiredArgument);
@@ -86,6 +91,15 @@ public:
          [this](const char *arg){try {m_snaplen = str2num<decltype(m_snaplen)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
          OptionFlags::RequiredArgument);
       register_option("l", "list", "", "Print list of available interfaces", [this](const char *arg){m_list = true; return true;}, OptionFlags::NoArgument);
+      register_option("S", "speed", "X", "Replay packets with timing of the file, X times faster (1 keeps original timing)",
+         [this](const char *arg){try {m_speed = str2num<decltype(m_speed)>(arg); if (m_speed <= 0) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("P", "pps", "NUM", "Replay packets of the file at fixed rate of NUM packets per second",
+         [this](const char *arg){try {m_pps = str2num<decltype(m_pps)>(arg); if (!m_pps) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("L", "loop", "NUM", "Read the file NUM times, 0 loops forever. Timestamps of each loop follow the previous one",
+         [this](const char *arg){try {m_loops = str2num<decltype(m_loops)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
    }
 };
 
@@ -109,17 +123,26 @@ private:
    uint16_t m_snaplen;
    int m_datalink;
    bool m_live;               /**< Capturing from network interface */
+   bool m_nsec;               /**< Timestamps of handle have nanosecond precision */
    bpf_u_int32 m_netmask;       /**< Network mask. Used when setting filter */
+   std::string m_file;
+   std::string m_filter;
+   Replay m_replay;
+   bool m_pending;              /**< Packet read by pcap_next_ex waits until it is due */
+   struct pcap_pkthdr *m_pkt_hdr;
+   const u_char *m_pkt_data;
 
    void open_file(const std::string &file);
    void open_ifc(const std::string &ifc);
    void set_filter(const std::string &filter_str);
+   InputPlugin::Result replay(PacketBlock &packets);
 
    void check_datalink(int datalink);
    void print_available_ifcs();
 };
 
 void packet_handler(u_char *arg, const struct pcap_pkthdr *h, const u_char *data);
+void packet_handler_nsec(u_char *arg, const struct pcap_pkthdr *h, const u_char *data);
 
 }
 #endif /* IPXP_INPUT_PCAP_HPP */
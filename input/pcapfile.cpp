@@ -0,0 +1,692 @@
+/**
+ * \file pcapfile.cpp
+ * \brief Reader of pcap and pcapng files mapped to memory
+ *    Formats are described at https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-00.html
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <config.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pcapfile.hpp"
+#include "parser.hpp"
+#include "headers.hpp"
+
+namespace ipxp {
+
+__attribute__((constructor)) static void register_this_plugin()
+{
+   static PluginRecord rec = PluginRecord("pcapfile", [](){return new PcapFileReader();});
+   register_plugin(&rec);
+}
+
+#define PCAP_MAGIC_USEC      0xA1B2C3D4
+#define PCAP_MAGIC_NSEC      0xA1B23C4D
+#define PCAP_HDR_LEN         24
+#define PCAP_REC_HDR_LEN     16
+
+#define PCAPNG_SHB           0x0A0D0D0A /**< Section header block */
+#define PCAPNG_IDB           1          /**< Interface description block */
+#define PCAPNG_SPB           3          /**< Simple packet block */
+#define PCAPNG_EPB           6          /**< Enhanced packet block */
+#define PCAPNG_BYTE_ORDER    0x1A2B3C4D
+#define PCAPNG_OPT_TSRESOL   9
+#define PCAPNG_OPT_TSOFFSET  14
+
+#define LINKTYPE_RAW         101
+
+/**
+ * \brief Convert link type stored in file to DLT value used by parser.
+ * \return DLT value or -1 when link type is not supported.
+ */
+static int datalink_from_linktype(uint32_t linktype)
+{
+   switch (linktype) {
+   case DLT_EN10MB:
+      return DLT_EN10MB;
+   case DLT_LINUX_SLL:
+      return DLT_LINUX_SLL;
+   case DLT_RAW:
+   case 14: // DLT_RAW on OpenBSD
+   case LINKTYPE_RAW:
+      return DLT_RAW;
+   default:
+      return -1;
+   }
+}
+
+static inline uint16_t be16(const uint8_t *p)
+{
+   return (p[0] << 8) | p[1];
+}
+
+static inline uint64_t fmix64(uint64_t h)
+{
+   h ^= h >> 33;
+   h *= 0xFF51AFD7ED558CCDULL;
+   h ^= h >> 33;
+   h *= 0xC4CEB9FE1A85EC53ULL;
+   h ^= h >> 33;
+   return h;
+}
+
+/**
+ * \brief Hash used to split packets across pipelines.
+ * Only IP addresses are hashed, so both directions of a flow and all its fragments get the same value.
+ * Tunnels are hashed by outer addresses, non IP packets get 0.
+ */
+uint32_t pcapfile_split_hash(const uint8_t *data, uint32_t caplen, int datalink)
+{
+   uint32_t off;
+   uint16_t ethertype;
+
+   if (datalink == DLT_EN10MB) {
+      if (caplen < 14) {
+         return 0;
+      }
+      ethertype = be16(data + 12);
+      off = 14;
+      while (ethertype == ETH_P_8021Q || ethertype == ETH_P_8021AD) {
+         if (caplen < off + 4) {
+            return 0;
+         }
+         ethertype = be16(data + off + 2);
+         off += 4;
+      }
+   } else if (datalink == DLT_LINUX_SLL) {
+      if (caplen < 16) {
+         return 0;
+      }
+      ethertype = be16(data + 14);
+      off = 16;
+   } else {
+      if (caplen < 1) {
+         return 0;
+      }
+      ethertype = (data[0] >> 4) == 4 ? ETH_P_IP : ((data[0] >> 4) == 6 ? ETH_P_IPV6 : 0);
+      off = 0;
+   }
+
+   uint64_t a;
+   uint64_t b;
+   if (ethertype == ETH_P_IP) {
+      uint32_t src;
+      uint32_t dst;
+      if (caplen < off + 20) {
+         return 0;
+      }
+      memcpy(&src, data + off + 12, 4);
+      memcpy(&dst, data + off + 16, 4);
+      a = src;
+      b = dst;
+   } else if (ethertype == ETH_P_IPV6) {
+      uint64_t w[4];
+      if (caplen < off + 40) {
+         return 0;
+      }
+      memcpy(w, data + off + 8, 32);
+      a = w[0] ^ w[1];
+      b = w[2] ^ w[3];
+   } else {
+      return 0;
+   }
+
+   if (a > b) {
+      std::swap(a, b);
+   }
+   return fmix64(fmix64(a) ^ b) >> 32;
+}
+
+/**
+ * \brief Check magic number of file, other files found in directory are skipped.
+ */
+static bool is_capture(const std::string &file)
+{
+   uint32_t magic;
+   FILE *fp = fopen(file.c_str(), "rb");
+   if (fp == nullptr) {
+      return false;
+   }
+   bool ok = fread(&magic, sizeof(magic), 1, fp) == 1;
+   fclose(fp);
+   return ok && (magic == PCAPNG_SHB ||
+      magic == PCAP_MAGIC_USEC || magic == __builtin_bswap32(PCAP_MAGIC_USEC) ||
+      magic == PCAP_MAGIC_NSEC || magic == __builtin_bswap32(PCAP_MAGIC_NSEC));
+}
+
+PcapFileReader::PcapFileReader() : m_file_idx(0), m_next_file(0), m_pos(nullptr), m_end(nullptr), m_record(nullptr), m_ng(false), m_swap(false),
+   m_nsec(false), m_datalink(0), m_last_ts(0), m_pipelines(1), m_index(0), m_zero_copy(false)
+{
+}
+
+PcapFileReader::~PcapFileReader()
+{
+   close();
+}
+
+std::vector<std::string> PcapFileReader::expand(const char *params) const
+{
+   PcapFileOptParser parser;
+   try {
+      parser.parse(params);
+   } catch (ParserError &e) {
+      throw PluginError(e.what());
+   }
+
+   std::string args = params ? params : "";
+   if (parser.m_pipelines <= 1) {
+      return {args};
+   }
+
+   // Every pipeline reads whole file and keeps packets with its index
+   std::vector<std::string> res;
+   for (uint16_t i = 0; i < parser.m_pipelines; i++) {
+      res.push_back(args + OptionsParser::DELIM + "index=" + std::to_string(i));
+   }
+   return res;
+}
+
+void PcapFileReader::init(const char *params)
+{
+   PcapFileOptParser parser;
+   try {
+      parser.parse(params);
+   } catch (ParserError &e) {
+      throw PluginError(e.what());
+   }
+
+   if (parser.m_file.empty()) {
+      throw PluginError("specify path to a file or directory");
+   }
+   if (parser.m_index >= parser.m_pipelines) {
+      throw PluginError("pipeline index must be lower than number of pipelines");
+   }
+   if (parser.m_speed > 0 && parser.m_pps) {
+      throw PluginError("speed and pps options cannot be combined");
+   }
+   m_pipelines = parser.m_pipelines;
+   m_index = parser.m_index;
+   m_zero_copy = parser.m_zero_copy;
+   m_replay.init(parser.m_speed, parser.m_pps, parser.m_loops);
+
+   list_files(parser.m_file);
+   if (m_files.empty()) {
+      throw PluginError("no files found in " + parser.m_file);
+   }
+   m_maps.resize(m_files.size(), MappedFile{nullptr, 0, 0});
+   open_next();
+}
+
+void PcapFileReader::close()
+{
+   for (auto &it : m_maps) {
+      if (it.addr != nullptr) {
+         munmap(it.addr, it.size);
+         it.addr = nullptr;
+      }
+   }
+   m_maps.clear();
+   m_files.clear();
+   m_held.clear();
+   m_pos = nullptr;
+   m_end = nullptr;
+}
+
+void PcapFileReader::list_files(const std::string &path)
+{
+   struct stat st;
+   if (stat(path.c_str(), &st) == -1) {
+      throw PluginError(path + ": " + strerror(errno));
+   }
+   if (!S_ISDIR(st.st_mode)) {
+      m_files.push_back(path);
+      return;
+   }
+
+   DIR *dir = opendir(path.c_str());
+   if (dir == nullptr) {
+      throw PluginError(path + ": " + strerror(errno));
+   }
+   struct dirent *ent;
+   while ((ent = readdir(dir)) != nullptr) {
+      if (ent->d_name[0] == '.') {
+         continue;
+      }
+      std::string file = path + "/" + ent->d_name;
+      if (stat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode) && is_capture(file)) {
+         m_files.push_back(file);
+      }
+   }
+   closedir(dir);
+   std::sort(m_files.begin(), m_files.end());
+}
+
+/**
+ * \brief Open next file of the list.
+ * \return False when all files were read.
+ */
+bool PcapFileReader::open_next()
+{
+   if (m_next_file >= m_files.size()) {
+      return false;
+   }
+   if (m_pos != nullptr && m_file_idx != m_next_file) {
+      MappedFile &cur = m_maps[m_file_idx];
+      if (cur.refs == 0) {
+         munmap(cur.addr, cur.size);
+         cur.addr = nullptr;
+      }
+   }
+   m_file_idx = m_next_file++;
+   open_file(m_file_idx);
+   return true;
+}
+
+void PcapFileReader::open_file(size_t idx)
+{
+   if (m_maps[idx].addr != nullptr) {
+      // File read again in loop is still referenced by packet blocks
+      m_pos = m_maps[idx].addr;
+      m_end = m_pos + m_maps[idx].size;
+      read_header();
+      return;
+   }
+
+   const std::string &file = m_files[idx];
+   int fd = open(file.c_str(), O_RDONLY);
+   if (fd == -1) {
+      throw PluginError(file + ": " + strerror(errno));
+   }
+   struct stat st;
+   if (fstat(fd, &st) == -1) {
+      int err = errno;
+      ::close(fd);
+      throw PluginError(file + ": " + strerror(err));
+   }
+   if (st.st_size == 0) {
+      ::close(fd);
+      throw PluginError(file + ": file is empty");
+   }
+   void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   int err = errno;
+   ::close(fd);
+   if (addr == MAP_FAILED) {
+      throw PluginError(file + ": mmap failed: " + strerror(err));
+   }
+   madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+   m_maps[idx] = MappedFile{static_cast<uint8_t *>(addr), static_cast<size_t>(st.st_size), 0};
+   m_pos = m_maps[idx].addr;
+   m_end = m_pos + m_maps[idx].size;
+   read_header();
+}
+
+/**
+ * \brief Release file referenced by packet block, file is unmapped when it is no longer read.
+ */
+void PcapFileReader::unref_file(size_t idx)
+{
+   MappedFile &map = m_maps[idx];
+   if (--map.refs == 0 && idx != m_file_idx) {
+      munmap(map.addr, map.size);
+      map.addr = nullptr;
+   }
+}
+
+uint16_t PcapFileReader::rd16(const uint8_t *p) const
+{
+   uint16_t val;
+   memcpy(&val, p, sizeof(val));
+   return m_swap ? __builtin_bswap16(val) : val;
+}
+
+uint32_t PcapFileReader::rd32(const uint8_t *p) const
+{
+   uint32_t val;
+   memcpy(&val, p, sizeof(val));
+   return m_swap ? __builtin_bswap32(val) : val;
+}
+
+uint64_t PcapFileReader::rd64(const uint8_t *p) const
+{
+   uint64_t val;
+   memcpy(&val, p, sizeof(val));
+   return m_swap ? __builtin_bswap64(val) : val;
+}
+
+void PcapFileReader::read_header()
+{
+   const std::string &file = m_files[m_file_idx];
+   uint32_t magic;
+   if (m_end - m_pos < 4) {
+      throw PluginError(file + ": unknown file format");
+   }
+   memcpy(&magic, m_pos, sizeof(magic));
+
+   m_ifcs.clear();
+   m_last_ts = 0;
+   if (magic == PCAPNG_SHB) {
+      // Byte order is read from section header block
+      m_ng = true;
+      return;
+   }
+
+   m_ng = false;
+   if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC) {
+      m_swap = false;
+   } else if (magic == __builtin_bswap32(PCAP_MAGIC_USEC) || magic == __builtin_bswap32(PCAP_MAGIC_NSEC)) {
+      m_swap = true;
+   } else {
+      throw PluginError(file + ": unknown file format");
+   }
+   m_nsec = rd32(m_pos) == PCAP_MAGIC_NSEC;
+
+   if (m_end - m_pos < PCAP_HDR_LEN) {
+      throw PluginError(file + ": truncated file header");
+   }
+   // Upper bits of link type field carry FCS length
+   m_datalink = datalink_from_linktype(rd32(m_pos + 20) & 0xFFFF);
+   if (m_datalink == -1) {
+      throw PluginError(file + ": unsupported link type detected, supported types are DLT_EN10MB and DLT_LINUX_SLL and DLT_RAW");
+   }
+   m_pos += PCAP_HDR_LEN;
+}
+
+/**
+ * \brief Get next packet record from current file.
+ * \return False at the end of file.
+ */
+bool PcapFileReader::next_packet(timestamp_t &ts, const uint8_t *&data, uint32_t &len, uint32_t &caplen, int &datalink)
+{
+   if (m_ng) {
+      return next_block(ts, data, len, caplen, datalink);
+   }
+
+   size_t left = m_end - m_pos;
+   if (left == 0) {
+      return false;
+   }
+   if (left < PCAP_REC_HDR_LEN) {
+      throw PluginError(m_files[m_file_idx] + ": truncated packet record");
+   }
+   m_record = m_pos;
+   uint32_t sec = rd32(m_pos);
+   uint32_t frac = rd32(m_pos + 4);
+   caplen = rd32(m_pos + 8);
+   len = rd32(m_pos + 12);
+   if (caplen > left - PCAP_REC_HDR_LEN) {
+      throw PluginError(m_files[m_file_idx] + ": truncated packet record");
+   }
+
+   ts = m_nsec ? ts_from_nsec(sec, frac) : ts_from_usec(sec, frac);
+   data = m_pos + PCAP_REC_HDR_LEN;
+   datalink = m_datalink;
+   m_pos += PCAP_REC_HDR_LEN + caplen;
+   return true;
+}
+
+/**
+ * \brief Walk pcapng blocks until a packet block is found.
+ * \return False at the end of file.
+ */
+bool PcapFileReader::next_block(timestamp_t &ts, const uint8_t *&data, uint32_t &len, uint32_t &caplen, int &datalink)
+{
+   const std::string &file = m_files[m_file_idx];
+   while (m_pos < m_end) {
+      size_t left = m_end - m_pos;
+      if (left < 12) {
+         throw PluginError(file + ": truncated block");
+      }
+
+      uint32_t type;
+      memcpy(&type, m_pos, sizeof(type));
+      if (type == PCAPNG_SHB) {
+         uint32_t order;
+         memcpy(&order, m_pos + 8, sizeof(order));
+         if (order == PCAPNG_BYTE_ORDER) {
+            m_swap = false;
+         } else if (order == __builtin_bswap32(PCAPNG_BYTE_ORDER)) {
+            m_swap = true;
+         } else {
+            throw PluginError(file + ": invalid section header block");
+         }
+      } else {
+         type = rd32(m_pos);
+      }
+
+      uint32_t block_len = rd32(m_pos + 4);
+      if (block_len < 12 || block_len % 4) {
+         throw PluginError(file + ": invalid block length");
+      }
+      if (block_len > left) {
+         throw PluginError(file + ": truncated block");
+      }
+      const uint8_t *body = m_pos + 8;
+      uint32_t body_len = block_len - 12;
+      m_record = m_pos;
+      m_pos += block_len;
+
+      if (type == PCAPNG_SHB) {
+         read_section(body, body_len);
+      } else if (type == PCAPNG_IDB) {
+         read_interface(body, body_len);
+      } else if (type == PCAPNG_EPB) {
+         if (body_len < 20) {
+            throw PluginError(file + ": invalid enhanced packet block");
+         }
+         uint32_t ifc = rd32(body);
+         if (ifc >= m_ifcs.size()) {
+            throw PluginError(file + ": packet of undefined interface");
+         }
+         caplen = rd32(body + 12);
+         len = rd32(body + 16);
+         if (caplen > body_len - 20) {
+            throw PluginError(file + ": invalid enhanced packet block");
+         }
+         ts = convert_ts(m_ifcs[ifc], (static_cast<uint64_t>(rd32(body + 4)) << 32) | rd32(body + 8));
+         m_last_ts = ts;
+         data = body + 20;
+         datalink = m_ifcs[ifc].datalink;
+         return true;
+      } else if (type == PCAPNG_SPB) {
+         if (body_len < 4 || m_ifcs.empty()) {
+            throw PluginError(file + ": invalid simple packet block");
+         }
+         len = rd32(body);
+         caplen = std::min(len, body_len - 4);
+         ts = m_last_ts;
+         data = body + 4;
+         datalink = m_ifcs[0].datalink;
+         return true;
+      }
+   }
+   return false;
+}
+
+void PcapFileReader::read_section(const uint8_t *body, uint32_t body_len)
+{
+   if (body_len < 16 || rd16(body + 4) != 1) {
+      throw PluginError(m_files[m_file_idx] + ": unsupported pcapng version");
+   }
+   // Interface ids are local to section
+   m_ifcs.clear();
+}
+
+void PcapFileReader::read_interface(const uint8_t *body, uint32_t body_len)
+{
+   const std::string &file = m_files[m_file_idx];
+   if (body_len < 8) {
+      throw PluginError(file + ": invalid interface description block");
+   }
+   Interface ifc = {datalink_from_linktype(rd16(body)), false, 6, 0};
+   if (ifc.datalink == -1) {
+      throw PluginError(file + ": unsupported link type detected, supported types are DLT_EN10MB and DLT_LINUX_SLL and DLT_RAW");
+   }
+
+   const uint8_t *opt = body + 8;
+   const uint8_t *end = body + body_len;
+   while (end - opt >= 4) {
+      uint16_t code = rd16(opt);
+      uint16_t opt_len = rd16(opt + 2);
+      if (code == 0) {
+         break;
+      }
+      if (opt_len > end - opt - 4) {
+         throw PluginError(file + ": invalid interface description block");
+      }
+      if (code == PCAPNG_OPT_TSRESOL && opt_len >= 1) {
+         ifc.binary = opt[4] & 0x80;
+         ifc.resolution = opt[4] & 0x7F;
+         if (ifc.resolution > (ifc.binary ? 63 : 19)) {
+            throw PluginError(file + ": unsupported timestamp resolution");
+         }
+      } else if (code == PCAPNG_OPT_TSOFFSET && opt_len >= 8) {
+         ifc.offset = static_cast<int64_t>(rd64(opt + 4));
+      }
+      // Option values are padded to 32 bits
+      opt += 4 + ((opt_len + 3) & ~3);
+   }
+   m_ifcs.push_back(ifc);
+}
+
+timestamp_t PcapFileReader::convert_ts(const Interface &ifc, uint64_t units) const
+{
+   uint64_t sec;
+   uint64_t nsec;
+   if (ifc.binary) {
+      uint8_t shift = ifc.resolution;
+      sec = units >> shift;
+      uint64_t frac = units & ((1ULL << shift) - 1);
+      if (shift > 34) {
+         // Keep product with NANO_SEC in 64 bits
+         frac >>= shift - 34;
+         shift = 34;
+      }
+      nsec = (frac * NANO_SEC) >> shift;
+   } else {
+      uint64_t div = 1;
+      for (uint8_t i = 0; i < ifc.resolution; i++) {
+         div *= 10;
+      }
+      sec = units / div;
+      nsec = units % div;
+      for (uint8_t i = ifc.resolution; i < 9; i++) {
+         nsec *= 10;
+      }
+      for (uint8_t i = 9; i < ifc.resolution; i++) {
+         nsec /= 10;
+      }
+   }
+   return ts_from_nsec(sec + ifc.offset, nsec);
+}
+
+InputPlugin::Result PcapFileReader::get(PacketBlock &packets)
+{
+   parser_opt_t opt = {&packets, false, false, m_datalink, m_zero_copy, m_payload_horizon, m_decap_depth, &m_fragments, m_malformed};
+   timestamp_t ts;
+   const uint8_t *data;
+   uint32_t len;
+   uint32_t caplen;
+   int datalink;
+
+   if (m_pos == nullptr) {
+      throw PluginError("no file opened");
+   }
+   if (m_zero_copy) {
+      auto it = m_held.find(&packets);
+      if (it != m_held.end()) {
+         unref_file(it->second);
+         m_held.erase(it);
+      }
+   }
+
+   packets.cnt = 0;
+   bool waiting = false;
+   while (packets.cnt < packets.size) {
+      if (!next_packet(ts, data, len, caplen, datalink)) {
+         // Packets of one block always come from the same file
+         if (packets.cnt) {
+            break;
+         }
+         if (!open_next()) {
+            if (!m_replay.rewind()) {
+               return Result::END_OF_FILE;
+            }
+            m_next_file = 0;
+            open_next();
+         }
+         continue;
+      }
+      if (!m_replay.due(ts)) {
+         m_pos = m_record;
+         waiting = true;
+         break;
+      }
+      // Records of other pipelines are paced too, so all pipelines walk the file at the same rate
+      ts = m_replay.consume(ts);
+      if (m_pipelines > 1 && pcapfile_split_hash(data, caplen, datalink) % m_pipelines != m_index) {
+         continue;
+      }
+
+      m_seen++;
+      opt.datalink = datalink;
+      parse_packet(&opt, ts, data, std::min<uint32_t>(len, UINT16_MAX), std::min<uint32_t>(caplen, UINT16_MAX));
+   }
+
+   m_parsed += packets.cnt;
+   if (m_zero_copy && packets.cnt) {
+      m_held[&packets] = m_file_idx;
+      m_maps[m_file_idx].refs++;
+   }
+   if (!packets.cnt) {
+      return waiting ? Result::TIMEOUT : Result::NOT_PARSED;
+   }
+   return Result::PARSED;
+}
+
+}
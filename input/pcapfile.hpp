@@ -0,0 +1,175 @@
+/**
+ * \file pcapfile.hpp
+ * \brief Reader of pcap and pcapng files mapped to memory
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+
+#ifndef IPXP_INPUT_PCAPFILE_HPP
+#define IPXP_INPUT_PCAPFILE_HPP
+
+#include <config.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <ipfixprobe/input.hpp>
+#include <ipfixprobe/packet.hpp>
+#include <ipfixprobe/options.hpp>
+#include <ipfixprobe/utils.hpp>
+
+#include "replay.hpp"
+
+namespace ipxp {
+
+class PcapFileOptParser : public OptionsParser
+{
+public:
+   std::string m_file;
+   uint16_t m_pipelines;
+   uint16_t m_index;
+   bool m_zero_copy;
+   double m_speed;
+   uint64_t m_pps;
+   uint32_t m_loops;
+
+   PcapFileOptParser() : OptionsParser("pcapfile", "Input plugin for reading pcap and pcapng files without libpcap"),
+      m_file(""), m_pipelines(1), m_index(0), m_zero_copy(false), m_speed(0), m_pps(0), m_loops(1)
+   {
+      register_option("f", "file", "PATH", "Path to a pcap or pcapng file, or to a directory whose capture files are read in order of their names",
+         [this](const char *arg){m_file = arg; return true;}, OptionFlags::RequiredArgument);
+      register_option("n", "pipelines", "NUM", "Split packets across NUM pipelines by hash of IP addresses, both directions of a flow stay in one pipeline",
+         [this](const char *arg){try {m_pipelines = str2num<decltype(m_pipelines)>(arg); if (!m_pipelines) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("x", "index", "IDX", "Read only packets of pipeline IDX when splitting, set automatically for each pipeline",
+         [this](const char *arg){try {m_index = str2num<decltype(m_index)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("z", "zerocopy", "", "Pass packets to processing plugins directly from the mapped file without copying",
+         [this](const char *arg){m_zero_copy = true; return true;}, OptionFlags::NoArgument);
+      register_option("S", "speed", "X", "Replay packets with timing of the trace, X times faster (1 keeps original timing)",
+         [this](const char *arg){try {m_speed = str2num<decltype(m_speed)>(arg); if (m_speed <= 0) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("P", "pps", "NUM", "Replay packets at fixed rate of NUM packets per second",
+         [this](const char *arg){try {m_pps = str2num<decltype(m_pps)>(arg); if (!m_pps) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("L", "loop", "NUM", "Read files NUM times, 0 loops forever. Timestamps of each loop follow the previous one",
+         [this](const char *arg){try {m_loops = str2num<decltype(m_loops)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+   }
+};
+
+/**
+ * \brief Reader of pcap and pcapng files.
+ * Files are mapped to memory and records are walked directly, without libpcap and its per packet callback.
+ */
+class PcapFileReader : public InputPlugin
+{
+public:
+   PcapFileReader();
+   ~PcapFileReader();
+
+   void init(const char *params);
+   void close();
+   OptionsParser *get_parser() const { return new PcapFileOptParser(); }
+   std::string get_name() const { return "pcapfile"; }
+   InputPlugin::Result get(PacketBlock &packets);
+   bool zero_copy() const { return m_zero_copy; }
+   std::vector<std::string> expand(const char *params) const;
+
+private:
+   /**
+    * \brief Link type and timestamp resolution of pcapng interface.
+    */
+   struct Interface {
+      int datalink;
+      bool binary;          /**< Resolution is negative power of 2 instead of 10 */
+      uint8_t resolution;   /**< Exponent of timestamp resolution */
+      int64_t offset;       /**< Seconds added to timestamps */
+   };
+
+   /**
+    * \brief File mapped to memory.
+    */
+   struct MappedFile {
+      uint8_t *addr;
+      size_t size;
+      uint32_t refs;        /**< Number of packet blocks pointing to the file in zero-copy mode */
+   };
+
+   std::vector<std::string> m_files;
+   std::vector<MappedFile> m_maps;
+   size_t m_file_idx;       /**< File being read */
+   size_t m_next_file;      /**< File opened after the current one is read */
+   const uint8_t *m_pos;
+   const uint8_t *m_end;
+   const uint8_t *m_record; /**< Begin of last packet record, reading returns there when packet is not due */
+
+   bool m_ng;
+   bool m_swap;             /**< Byte order of file or pcapng section differs from host */
+   bool m_nsec;
+   int m_datalink;
+   std::vector<Interface> m_ifcs;
+   timestamp_t m_last_ts;   /**< Timestamp of last packet, simple packet blocks have none */
+
+   uint16_t m_pipelines;
+   uint16_t m_index;
+   bool m_zero_copy;
+   std::map<const PacketBlock *, size_t> m_held; /**< Files referenced by packet blocks. */
+   Replay m_replay;
+
+   void list_files(const std::string &path);
+   bool open_next();
+   void open_file(size_t idx);
+   void unref_file(size_t idx);
+   void read_header();
+   bool next_packet(timestamp_t &ts, const uint8_t *&data, uint32_t &len, uint32_t &caplen, int &datalink);
+   bool next_block(timestamp_t &ts, const uint8_t *&data, uint32_t &len, uint32_t &caplen, int &datalink);
+   void read_section(const uint8_t *body, uint32_t body_len);
+   void read_interface(const uint8_t *body, uint32_t body_len);
+   timestamp_t convert_ts(const Interface &ifc, uint64_t units) const;
+
+   uint16_t rd16(const uint8_t *p) const;
+   uint32_t rd32(const uint8_t *p) const;
+   uint64_t rd64(const uint8_t *p) const;
+};
+
+uint32_t pcapfile_split_hash(const uint8_t *data, uint32_t caplen, int datalink);
+
+}
+#endif /* IPXP_INPUT_PCAPFILE_HPP */
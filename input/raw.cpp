@@ -50,16 +50,22 @@
 
 #include <unistd.h>
 #include <poll.h>
+#include <linux/filter.h>
 #include <linux/if_packet.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <net/ethernet.h>
 #include <net/if.h>
 #include <ifaddrs.h>
 
+#ifdef WITH_PCAP
+#include <pcap.h>
+#endif
+
 #include "raw.hpp"
 #include "parser.hpp"
 
@@ -75,8 +81,39 @@ __attribute__((constructor)) static void register_this_plugin()
    register_plugin(&rec);
 }
 
-RawReader::RawReader() : m_sock(-1), m_fanout(0), m_rd(nullptr), m_pfd({0}), m_buffer(nullptr), m_buffer_size(0),
-   m_block_idx(0), m_blocksize(0), m_framesize(0), m_blocknum(0), m_last_ppd(nullptr), m_pbd(nullptr), m_pkts_left(0)
+/**
+ * \brief Convert fanout mode name to PACKET_FANOUT_* type.
+ * \param [in] defrag Reassemble fragments before fanout, changes packet counts of fragmented datagrams.
+ */
+static int fanout_type(const std::string &mode, bool defrag)
+{
+   int flags = defrag ? PACKET_FANOUT_FLAG_DEFRAG : 0;
+   if (mode == "qm") {
+      return PACKET_FANOUT_QM | flags;
+   } else if (mode == "lb") {
+      return PACKET_FANOUT_LB | flags;
+   } else if (mode == "rollover") {
+      return PACKET_FANOUT_ROLLOVER | flags;
+   } else if (mode == "cpu") {
+      return PACKET_FANOUT_CPU | flags;
+   }
+   return PACKET_FANOUT_HASH | flags;
+}
+
+#define IPXP_BPF_OBJ_GET 7 /**< BPF_OBJ_GET command of bpf() syscall. */
+
+/**
+ * \brief Attributes of BPF_OBJ_GET command, linux/bpf.h cannot be included together with pcap.h.
+ */
+struct bpf_obj_get_attr {
+   uint64_t pathname;
+   uint32_t bpf_fd;
+   uint32_t file_flags;
+};
+
+RawReader::RawReader() : m_sock(-1), m_fanout(0), m_fanout_type(0), m_rd(nullptr), m_pfd({0}), m_buffer(nullptr), m_buffer_size(0),
+   m_block_idx(0), m_blocksize(0), m_framesize(0), m_blocknum(0), m_last_ppd(nullptr), m_pbd(nullptr), m_pkts_left(0),
+   m_zero_copy(false)
 {
 }
 
@@ -85,6 +122,34 @@ RawReader::~RawReader()
    close();
 }
 
+std::vector<std::string> RawReader::expand(const char *params) const
+{
+   RawOptParser parser;
+   try {
+      parser.parse(params);
+   } catch (ParserError &e) {
+      throw PluginError(e.what());
+   }
+
+   std::string args = params ? params : "";
+   if ((parser.m_fanout || parser.m_sockets > 1) && parser.m_fanout_mode != "hash") {
+      // Only the kernel flow hash is symmetric, other modes send directions of a biflow to different flow caches
+      std::cerr << "raw: fanout mode " << parser.m_fanout_mode << " can split biflows across pipelines";
+      if (parser.m_fanout_mode == "qm") {
+         std::cerr << " unless the NIC uses symmetric RSS";
+      }
+      std::cerr << ", use mode=hash to keep both directions of a flow in one pipeline" << std::endl;
+   }
+   if (parser.m_sockets <= 1) {
+      return {args};
+   }
+
+   uint16_t fanout = parser.m_fanout ? parser.m_fanout : getpid() & 0xFFFF;
+   args += OptionsParser::DELIM + std::string("fanout=") + std::to_string(fanout) +
+      OptionsParser::DELIM + "sockets=1";
+   return std::vector<std::string>(parser.m_sockets, args);
+}
+
 void RawReader::init(const char *params)
 {
    RawOptParser parser;
@@ -100,6 +165,13 @@ void RawReader::init(const char *params)
    }
 
    m_fanout = parser.m_fanout;
+   m_fanout_type = fanout_type(parser.m_fanout_mode, parser.m_defrag);
+   m_filter = parser.m_filter;
+   m_ebpf = parser.m_ebpf;
+   if (!m_filter.empty() && !m_ebpf.empty()) {
+      throw PluginError("filter string and eBPF program cannot be used together");
+   }
+   m_zero_copy = parser.m_zero_copy;
    if (parser.m_ifc.empty()) {
       throw PluginError("specify network interface");
    }
@@ -116,12 +188,22 @@ void RawReader::init(const char *params)
    if (static_cast<long>(m_framesize) > pagesize) {
       m_framesize = pagesize;
    }
+   if (m_zero_copy) {
+      // Each packet block holds at most two ring blocks, the one continued from previous read and a new one
+      if (m_blocknum <= 2 * m_queue_blocks) {
+         throw PluginError("number of blocks must exceed " + std::to_string(2 * m_queue_blocks) +
+            " in zero-copy mode, twice the number of packet blocks of the input queue");
+      }
+      m_block_refs.assign(m_blocknum, 0);
+   }
 
    open_ifc(parser.m_ifc);
 }
 
 void RawReader::close()
 {
+   m_held.clear();
+   m_block_refs.clear();
    if (m_buffer != nullptr) {
       munmap(m_buffer, m_buffer_size);
       m_buffer = nullptr;
@@ -150,6 +232,14 @@ void RawReader::open_ifc(const std::string &ifc)
       throw PluginError(std::string("unable to set packet to v3: ") + strerror(errno));
    }
 
+   // Filter is attached before the ring is created, so that no unwanted packet is written to the ring
+   try {
+      attach_filter(sock, ifc);
+   } catch (PluginError &e) {
+      ::close(sock);
+      throw;
+   }
+
    struct ifreq ifr;
    memset(&ifr, 0, sizeof(ifr));
    if (ifc.size() > sizeof(ifr.ifr_name) - 1) {
@@ -229,8 +319,7 @@ void RawReader::open_ifc(const std::string &ifc)
    }
 
    if (m_fanout) {
-      int fanout_type = PACKET_FANOUT_CPU;
-      int fanout_arg = (m_fanout | (fanout_type << 16));
+      int fanout_arg = (m_fanout | (m_fanout_type << 16));
       int setsockopt_fanout = setsockopt(sock, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg));
       if (setsockopt_fanout == -1) {
          munmap(buffer, mmap_bufsize);
@@ -254,8 +343,65 @@ void RawReader::open_ifc(const std::string &ifc)
    m_pbd = (struct tpacket_block_desc *) m_rd[m_block_idx].iov_base;
 }
 
+void RawReader::attach_filter(int sock, const std::string &ifc)
+{
+   if (!m_ebpf.empty()) {
+      struct bpf_obj_get_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.pathname = reinterpret_cast<uint64_t>(m_ebpf.c_str());
+      int prog_fd = syscall(__NR_bpf, IPXP_BPF_OBJ_GET, &attr, sizeof(attr));
+      if (prog_fd == -1) {
+         throw PluginError("unable to open eBPF program " + m_ebpf + ": " + strerror(errno));
+      }
+      // Socket holds its own reference to the program
+      int attach_res = setsockopt(sock, SOL_SOCKET, SO_ATTACH_BPF, &prog_fd, sizeof(prog_fd));
+      int err = errno;
+      ::close(prog_fd);
+      if (attach_res == -1) {
+         throw PluginError(std::string("unable to attach eBPF program: ") + strerror(err));
+      }
+      return;
+   }
+   if (m_filter.empty()) {
+      return;
+   }
+
+#ifdef WITH_PCAP
+   // Code is generated for the live interface, so that VLAN tags stripped by kernel are matched in packet metadata
+   char errbuf[PCAP_ERRBUF_SIZE];
+   pcap_t *handle = pcap_create(ifc.c_str(), errbuf);
+   if (handle == nullptr) {
+      throw PluginError("couldn't parse filter " + m_filter + ": " + errbuf);
+   }
+   struct bpf_program prog;
+   if (pcap_activate(handle) < 0 || pcap_compile(handle, &prog, m_filter.c_str(), 1, PCAP_NETMASK_UNKNOWN) == -1) {
+      std::string err = pcap_geterr(handle);
+      pcap_close(handle);
+      throw PluginError("couldn't parse filter " + m_filter + ": " + err);
+   }
+   pcap_close(handle);
+
+   struct sock_fprog fprog;
+   fprog.len = prog.bf_len;
+   fprog.filter = reinterpret_cast<struct sock_filter *>(prog.bf_insns);
+   int attach_res = setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
+   int err = errno;
+   pcap_freecode(&prog);
+   if (attach_res == -1) {
+      throw PluginError(std::string("unable to attach filter: ") + strerror(err));
+   }
+#else
+   throw PluginError("filter strings require ipfixprobe compiled with libpcap, use pinned eBPF program instead");
+#endif
+}
+
 bool RawReader::get_block()
 {
+   if (m_zero_copy && m_block_refs[m_block_idx]) {
+      // Block is referenced by packet blocks waiting in the queue, packets read so far are passed on
+      // and the block is released when its packet block is passed to get() again
+      return false;
+   }
    if ((m_pbd->hdr.bh1.block_status & TP_STATUS_USER) == 0) {
       // No data available at the moment
       if (poll(&m_pfd, 1, 0) == -1) {
@@ -263,16 +409,45 @@ bool RawReader::get_block()
       }
       return false;
    }
+   if (m_zero_copy) {
+      // Reference held by reader until all packets are read from the block
+      m_block_refs[m_block_idx] = 1;
+   }
    return true;
 }
 
 void RawReader::return_block()
 {
-   m_pbd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+   if (m_zero_copy) {
+      unref_block(m_block_idx);
+   } else {
+      m_pbd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+   }
    m_block_idx = (m_block_idx + 1) % m_blocknum;
    m_pbd = (struct tpacket_block_desc *) m_rd[m_block_idx].iov_base;
 }
 
+void RawReader::unref_block(uint32_t idx)
+{
+   if (--m_block_refs[idx] == 0) {
+      struct tpacket_block_desc *pbd = (struct tpacket_block_desc *) m_rd[idx].iov_base;
+      pbd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+   }
+}
+
+void RawReader::release_blocks(const PacketBlock &packets)
+{
+   // Packet block is passed again only after it was consumed by storage or dropped
+   auto it = m_held.find(&packets);
+   if (it == m_held.end()) {
+      return;
+   }
+   for (auto idx : it->second) {
+      unref_block(idx);
+   }
+   it->second.clear();
+}
+
 int RawReader::read_packets(PacketBlock &packets)
 {
    int read_cnt = 0;
@@ -299,7 +474,7 @@ int RawReader::read_packets(PacketBlock &packets)
 
 int RawReader::process_packets(struct tpacket_block_desc *pbd, PacketBlock &packets)
 {
-   parser_opt_t opt = {&packets, false, false, DLT_EN10MB};
+   parser_opt_t opt = {&packets, false, false, DLT_EN10MB, m_zero_copy, m_payload_horizon, m_decap_depth, &m_fragments, m_malformed};
    uint32_t num_pkts = pbd->hdr.bh1.num_pkts;
    uint32_t capacity = packets.size - packets.cnt;
    uint32_t to_read = 0;
@@ -319,13 +494,21 @@ int RawReader::process_packets(struct tpacket_block_desc *pbd, PacketBlock &pack
       const u_char *data = (uint8_t *) ppd + ppd->tp_mac;
       size_t len = ppd->tp_len;
       size_t snaplen = ppd->tp_snaplen;
-      struct timeval ts = {ppd->tp_sec, ppd->tp_nsec / 1000};
+      timestamp_t ts = ts_from_nsec(ppd->tp_sec, ppd->tp_nsec);
 
       parse_packet(&opt, ts, data, len, snaplen);
       ppd = (struct tpacket3_hdr *) ((uint8_t *) ppd + ppd->tp_next_offset);
    }
    m_last_ppd = ppd;
 
+   if (m_zero_copy && to_read) {
+      std::vector<uint32_t> &held = m_held[&packets];
+      if (held.empty() || held.back() != m_block_idx) {
+         held.push_back(m_block_idx);
+         m_block_refs[m_block_idx]++;
+      }
+   }
+
    return to_read;
 }
 
@@ -360,6 +543,9 @@ InputPlugin::Result RawReader::get(PacketBlock &packets)
 {
    int ret;
 
+   if (m_zero_copy) {
+      release_blocks(packets);
+   }
    packets.cnt = 0;
    ret = read_packets(packets);
    if (ret == 0) {
@@ -45,6 +45,8 @@
 #define IPXP_INPUT_RAW_HPP
 
 #include <config.h>
+#include <map>
+#include <vector>
 
 #include <ipfixprobe/input.hpp>
 #include <ipfixprobe/packet.hpp>
@@ -58,12 +60,19 @@ class RawOptParser : public OptionsParser
 public:
    std::string m_ifc;
    uint16_t m_fanout;
+   std::string m_fanout_mode;
+   uint16_t m_sockets;
+   std::string m_filter;
+   std::string m_ebpf;
    uint32_t m_block_cnt;
    uint32_t m_pkt_cnt;
    bool m_list;
+   bool m_zero_copy;
+   bool m_defrag;
 
    RawOptParser() : OptionsParser("raw", "Input plugin for reading packets from a raw socket"),
-      m_ifc(""), m_fanout(0), m_block_cnt(2048), m_pkt_cnt(32), m_list(false)
+      m_ifc(""), m_fanout(0), m_fanout_mode("hash"), m_sockets(1), m_filter(""), m_ebpf(""), m_block_cnt(2048), m_pkt_cnt(32), m_list(false),
+      m_zero_copy(false), m_defrag(false)
    {
       register_option("i", "ifc", "IFC", "Network interface name", [this](const char *arg){m_ifc = arg; return true;}, OptionFlags::RequiredArgument);
       register_option("f", "fanout", "ID", "Enable packet fanout",
@@ -71,6 +80,20 @@ public:
             try {m_fanout = str2num<decltype(m_fanout)>(arg); if (!m_fanout) {return false;}} catch(std::invalid_argument &e) {return false;}
          } else {m_fanout = getpid() & 0xFFFF;} return true;},
          OptionFlags::OptionalArgument);
+      register_option("m", "mode", "MODE", "Fanout mode: hash (default, keeps biflows together), qm (by NIC RX queue), lb (round robin), rollover or cpu",
+         [this](const char *arg){m_fanout_mode = arg;
+            return m_fanout_mode == "hash" || m_fanout_mode == "qm" || m_fanout_mode == "lb" ||
+               m_fanout_mode == "rollover" || m_fanout_mode == "cpu";},
+         OptionFlags::RequiredArgument);
+      register_option("d", "defrag", "", "Reassemble IP fragments in kernel before fanout, so they reach pipeline of the first fragment. Reassembled datagram is counted as one packet",
+         [this](const char *arg){m_defrag = true; return true;}, OptionFlags::NoArgument);
+      register_option("n", "sockets", "NUM", "Number of sockets in fanout group, each one is read by separate pipeline",
+         [this](const char *arg){try {m_sockets = str2num<decltype(m_sockets)>(arg); if (!m_sockets) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("F", "filter", "STR", "Filter string in pcap syntax, packets are filtered by kernel before they are written to the ring (requires libpcap)",
+         [this](const char *arg){m_filter = arg; return true;}, OptionFlags::RequiredArgument);
+      register_option("e", "ebpf", "PATH", "Pinned eBPF socket filter program to run in kernel instead of the filter string",
+         [this](const char *arg){m_ebpf = arg; return true;}, OptionFlags::RequiredArgument);
       register_option("b", "blocks", "SIZE", "Number of packet blocks (should be power of two num)",
          [this](const char *arg){try {m_block_cnt = str2num<decltype(m_block_cnt)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
          OptionFlags::RequiredArgument);
@@ -78,6 +101,8 @@ public:
          [this](const char *arg){try {m_pkt_cnt = str2num<decltype(m_pkt_cnt)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
          OptionFlags::RequiredArgument);
       register_option("l", "list", "", "Print list of available interfaces", [this](const char *arg){m_list = true; return true;}, OptionFlags::NoArgument);
+      register_option("z", "zerocopy", "", "Pass packets to processing plugins directly from the ring without copying. Blocks are returned to kernel after the packets are processed, number of blocks must exceed twice the number of packet blocks of the input queue",
+         [this](const char *arg){m_zero_copy = true; return true;}, OptionFlags::NoArgument);
    }
 };
 
@@ -91,10 +116,15 @@ public:
    OptionsParser *get_parser() const { return new RawOptParser(); }
    std::string get_name() const { return "raw"; }
    InputPlugin::Result get(PacketBlock &packets);
+   bool zero_copy() const { return m_zero_copy; }
+   std::vector<std::string> expand(const char *params) const;
 
 private:
    int m_sock;
    uint16_t m_fanout;
+   int m_fanout_type;
+   std::string m_filter;
+   std::string m_ebpf;
    struct iovec *m_rd;
    struct pollfd m_pfd;
 
@@ -110,9 +140,16 @@ private:
    struct tpacket_block_desc *m_pbd;
    uint32_t m_pkts_left;
 
+   bool m_zero_copy;
+   std::vector<uint32_t> m_block_refs; /**< Number of references to each ring block in zero-copy mode. */
+   std::map<const PacketBlock *, std::vector<uint32_t>> m_held; /**< Ring blocks referenced by packet blocks. */
+
    void open_ifc(const std::string &ifc);
+   void attach_filter(int sock, const std::string &ifc);
    bool get_block();
    void return_block();
+   void unref_block(uint32_t idx);
+   void release_blocks(const PacketBlock &packets);
    int read_packets(PacketBlock &packets);
    int process_packets(struct tpacket_block_desc *pbd, PacketBlock &packets);
    void print_available_ifcs();
@@ -0,0 +1,78 @@
+/**
+ * \file replay.cpp
+ * \brief Pacing and looping of packets read from capture files
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <config.h>
+
+#include "replay.hpp"
+
+namespace ipxp {
+
+Replay::Replay() : m_speed(0), m_pps(0), m_loops(1), m_loop(0), m_started(false), m_start(0), m_trace_start(0),
+   m_records(0), m_loop_records(0), m_first(0), m_last(0), m_offset(0)
+{
+}
+
+void Replay::init(double speed, uint64_t pps, uint32_t loops)
+{
+   m_speed = speed;
+   m_pps = pps;
+   m_loops = loops;
+}
+
+bool Replay::rewind()
+{
+   m_loop++;
+   if ((m_loops && m_loop >= m_loops) || !m_loop_records) {
+      return false;
+   }
+   if (m_loop_records) {
+      // Next loop continues after the last packet with average gap between packets
+      timestamp_t duration = m_last - m_first;
+      timestamp_t gap = m_loop_records > 1 ? duration / (m_loop_records - 1) : 0;
+      m_offset += duration + (gap ? gap : 1);
+   }
+   m_loop_records = 0;
+   m_last = 0;
+   return true;
+}
+
+}
@@ -0,0 +1,175 @@
+/**
+ * \file replay.hpp
+ * \brief Pacing and looping of packets read from capture files
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+
+#ifndef IPXP_INPUT_REPLAY_HPP
+#define IPXP_INPUT_REPLAY_HPP
+
+#include <cstdint>
+
+#include <ipfixprobe/clock.hpp>
+#include <ipfixprobe/packet.hpp>
+
+namespace ipxp {
+
+/**
+ * \brief Replay of capture file with original timing, scaled speed or fixed packet rate.
+ *
+ * Input plugin asks whether each record is due before it is consumed and returns TIMEOUT when it is not,
+ * so idle storage workers keep expiring flows while waiting. Timestamps are shifted by trace duration
+ * when the file is read again in a loop.
+ */
+class Replay
+{
+public:
+   Replay();
+
+   /**
+    * \brief Configure replay.
+    * \param [in] speed Timing of trace scaled by this factor, 0 disables timing.
+    * \param [in] pps Fixed number of records per second, 0 disables rate limit.
+    * \param [in] loops Number of times the file is read, 0 loops forever.
+    */
+   void init(double speed, uint64_t pps, uint32_t loops);
+
+   /**
+    * \brief Tell whether records are read in other way than once as fast as possible.
+    */
+   bool enabled() const
+   {
+      return m_speed > 0 || m_pps || m_loops != 1;
+   }
+
+   /**
+    * \brief Check whether record with given timestamp should be passed now.
+    */
+   bool due(timestamp_t ts)
+   {
+      if (!m_speed && !m_pps) {
+         return true;
+      }
+      uint64_t now = clock_monotonic_precise();
+      if (!m_started) {
+         m_started = true;
+         m_start = now;
+         m_trace_start = ts;
+      }
+      uint64_t elapsed = now - m_start;
+      if (m_pps) {
+         return elapsed >= m_records / m_pps * NANO_SEC + m_records % m_pps * NANO_SEC / m_pps;
+      }
+      ts += m_offset;
+      return ts <= m_trace_start || elapsed >= static_cast<uint64_t>((ts - m_trace_start) / m_speed);
+   }
+
+   /**
+    * \brief Account consumed record.
+    * \return Timestamp shifted by duration of previous loops.
+    */
+   timestamp_t consume(timestamp_t ts)
+   {
+      if (!m_loop_records) {
+         m_first = ts;
+      }
+      if (ts > m_last) {
+         m_last = ts;
+      }
+      m_records++;
+      m_loop_records++;
+      return ts + m_offset;
+   }
+
+   /**
+    * \brief Called at the end of file.
+    * \return True when the file should be read again.
+    */
+   bool rewind();
+
+private:
+   double m_speed;
+   uint64_t m_pps;
+   uint32_t m_loops;
+   uint32_t m_loop;
+
+   bool m_started;
+   uint64_t m_start;            /**< Monotonic time of the first record */
+   timestamp_t m_trace_start;   /**< Timestamp of the first record */
+   uint64_t m_records;          /**< Records consumed in all loops */
+   uint64_t m_loop_records;     /**< Records consumed in current loop */
+   timestamp_t m_first;         /**< First timestamp of current loop */
+   timestamp_t m_last;          /**< Last timestamp of current loop */
+   timestamp_t m_offset;        /**< Shift of timestamps of current loop */
+};
+
+/**
+ * \brief Key XORed to addresses of packets replayed in given loop, 0 keeps the first loop unchanged.
+ */
+inline uint32_t loop_key(uint64_t id)
+{
+   if (!id) {
+      return 0;
+   }
+   id ^= id >> 33;
+   id *= 0xFF51AFD7ED558CCDULL;
+   id ^= id >> 33;
+   return id;
+}
+
+/**
+ * \brief XOR addresses of replayed packet with loop key, so replayed flows do not merge with flows of other loops.
+ */
+inline void loop_rewrite(Packet &pkt, uint32_t key)
+{
+   if (pkt.ip_version == IP::v4) {
+      pkt.src_ip.v4 ^= key;
+      pkt.dst_ip.v4 ^= key;
+   } else {
+      // Interface identifier is changed, prefixes are kept
+      uint32_t *src = reinterpret_cast<uint32_t *>(pkt.src_ip.v6 + 12);
+      uint32_t *dst = reinterpret_cast<uint32_t *>(pkt.dst_ip.v6 + 12);
+      *src ^= key;
+      *dst ^= key;
+   }
+}
+
+}
+#endif /* IPXP_INPUT_REPLAY_HPP */
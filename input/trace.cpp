@@ -0,0 +1,286 @@
+/**
+ * \file trace.cpp
+ * \brief Replay of packet trace preloaded to memory
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+
+#include <config.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <sys/mman.h>
+
+#include "trace.hpp"
+#include "pcapfile.hpp"
+
+namespace ipxp {
+
+__attribute__((constructor)) static void register_this_plugin()
+{
+   static PluginRecord rec = PluginRecord("trace", [](){return new TraceReader();});
+   register_plugin(&rec);
+}
+
+#define TRACE_HUGEPAGE_SIZE (2 * 1024 * 1024)
+#define TRACE_LOAD_BLOCK    64
+
+/**
+ * \brief Parsed packets with their data stored in one memory area.
+ */
+struct Trace {
+   std::vector<Packet> pkts;
+   uint8_t *data;
+   size_t size;
+   uint32_t refs;
+};
+
+static std::mutex traces_mtx;
+static std::map<std::string, Trace *> traces; /**< Loaded traces indexed by file and parser settings */
+
+TraceReader::TraceReader() : m_hugepages(false), m_trace(nullptr), m_pos(0), m_duration(0), m_start(0), m_pipelines(1),
+   m_index(0), m_loop(0), m_key(0)
+{
+}
+
+TraceReader::~TraceReader()
+{
+   close();
+}
+
+std::vector<std::string> TraceReader::expand(const char *params) const
+{
+   TraceOptParser parser;
+   try {
+      parser.parse(params);
+   } catch (ParserError &e) {
+      throw PluginError(e.what());
+   }
+
+   std::string args = params ? params : "";
+   if (parser.m_pipelines <= 1) {
+      return {args};
+   }
+
+   std::vector<std::string> res;
+   for (uint16_t i = 0; i < parser.m_pipelines; i++) {
+      res.push_back(args + OptionsParser::DELIM + "index=" + std::to_string(i));
+   }
+   return res;
+}
+
+void TraceReader::init(const char *params)
+{
+   TraceOptParser parser;
+   try {
+      parser.parse(params);
+   } catch (ParserError &e) {
+      throw PluginError(e.what());
+   }
+
+   if (parser.m_file.empty()) {
+      throw PluginError("specify path to a file or directory");
+   }
+   if (parser.m_index >= parser.m_pipelines) {
+      throw PluginError("pipeline index must be lower than number of pipelines");
+   }
+   if (!parser.m_duration && !parser.m_loops) {
+      throw PluginError("specify duration or number of loops");
+   }
+
+   // Trace is parsed on first read, parser settings are not known yet. Check the files now.
+   PcapFileReader reader;
+   reader.init(("file=" + parser.m_file).c_str());
+
+   m_file = parser.m_file;
+   m_hugepages = parser.m_hugepages;
+   m_duration = parser.m_duration * NANO_SEC;
+   m_pipelines = parser.m_pipelines;
+   m_index = parser.m_index;
+   m_replay.init(0, 0, parser.m_loops);
+}
+
+void TraceReader::close()
+{
+   if (m_trace == nullptr) {
+      return;
+   }
+   std::lock_guard<std::mutex> lock(traces_mtx);
+   if (--m_trace->refs == 0) {
+      for (auto it = traces.begin(); it != traces.end(); ++it) {
+         if (it->second == m_trace) {
+            traces.erase(it);
+            break;
+         }
+      }
+      munmap(m_trace->data, m_trace->size);
+      delete m_trace;
+   }
+   m_trace = nullptr;
+}
+
+/**
+ * \brief Parse all packets of the trace and copy them to one memory area, or reuse trace loaded by other pipeline.
+ */
+void TraceReader::load()
+{
+   std::string id = m_file + OptionsParser::DELIM + std::to_string(m_payload_horizon) + OptionsParser::DELIM +
+      std::to_string(m_decap_depth);
+   std::lock_guard<std::mutex> lock(traces_mtx);
+   auto it = traces.find(id);
+   if (it != traces.end()) {
+      m_trace = it->second;
+      m_trace->refs++;
+      return;
+   }
+
+   PcapFileReader reader;
+   reader.init(("file=" + m_file).c_str());
+   reader.m_payload_horizon = m_payload_horizon;
+   reader.m_decap_depth = m_decap_depth;
+
+   std::vector<uint8_t> buffers(TRACE_LOAD_BLOCK * UINT16_MAX);
+   std::vector<Packet> block_pkts(TRACE_LOAD_BLOCK);
+   for (size_t i = 0; i < block_pkts.size(); i++) {
+      block_pkts[i].buffer = buffers.data() + i * UINT16_MAX;
+      block_pkts[i].buffer_size = UINT16_MAX;
+   }
+   PacketBlock block;
+   block.pkts = block_pkts.data();
+   block.size = block_pkts.size();
+
+   // Packet data are staged first, pointers are set when final memory is allocated
+   std::unique_ptr<Trace> trace(new Trace{{}, nullptr, 0, 1});
+   std::vector<uint8_t> staging;
+   std::vector<size_t> offsets;
+   while (reader.get(block) != InputPlugin::Result::END_OF_FILE) {
+      for (size_t i = 0; i < block.cnt; i++) {
+         Packet &pkt = block.pkts[i];
+         offsets.push_back(staging.size());
+         staging.insert(staging.end(), pkt.packet, pkt.packet + pkt.packet_len + 1);
+         trace->pkts.push_back(pkt);
+      }
+   }
+   for (size_t i = 0; i < PARSER_STATUS_CNT; i++) {
+      m_malformed[i] += reader.m_malformed[i];
+   }
+   if (trace->pkts.empty()) {
+      throw PluginError("no packets parsed from " + m_file);
+   }
+
+   trace->size = staging.size();
+   void *data = MAP_FAILED;
+   if (m_hugepages) {
+      trace->size = (trace->size + TRACE_HUGEPAGE_SIZE - 1) & ~(TRACE_HUGEPAGE_SIZE - 1);
+      data = mmap(nullptr, trace->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (data == MAP_FAILED) {
+         std::cerr << "trace: unable to allocate hugepages, using transparent hugepages instead" << std::endl;
+      }
+   }
+   if (data == MAP_FAILED) {
+      data = mmap(nullptr, trace->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (data == MAP_FAILED) {
+         throw PluginError(std::string("unable to allocate memory for trace: ") + strerror(errno));
+      }
+      if (m_hugepages) {
+         madvise(data, trace->size, MADV_HUGEPAGE);
+      }
+   }
+   trace->data = static_cast<uint8_t *>(data);
+   memcpy(trace->data, staging.data(), staging.size());
+   mprotect(trace->data, trace->size, PROT_READ);
+
+   for (size_t i = 0; i < trace->pkts.size(); i++) {
+      Packet &pkt = trace->pkts[i];
+      uint8_t *packet = trace->data + offsets[i];
+      pkt.payload = packet + (pkt.payload - pkt.packet);
+      pkt.packet = packet;
+   }
+
+   m_trace = trace.release();
+   traces[id] = m_trace;
+}
+
+InputPlugin::Result TraceReader::get(PacketBlock &packets)
+{
+   if (m_trace == nullptr) {
+      load();
+      m_start = clock_monotonic();
+      m_key = loop_key(m_index);
+   }
+   if (m_duration && clock_monotonic() - m_start >= m_duration) {
+      return Result::END_OF_FILE;
+   }
+
+   const std::vector<Packet> &pkts = m_trace->pkts;
+   packets.cnt = 0;
+   while (packets.cnt < packets.size) {
+      if (m_pos == pkts.size()) {
+         if (!m_replay.rewind()) {
+            break;
+         }
+         m_pos = 0;
+         m_loop++;
+         m_key = loop_key(m_loop * m_pipelines + m_index);
+      }
+
+      const Packet &src = pkts[m_pos++];
+      Packet &pkt = packets.pkts[packets.cnt++];
+      uint8_t *buffer = pkt.buffer;
+      uint16_t buffer_size = pkt.buffer_size;
+      pkt = src;
+      pkt.buffer = buffer;
+      pkt.buffer_size = buffer_size;
+      pkt.ts = m_replay.consume(src.ts);
+      if (m_key) {
+         loop_rewrite(pkt, m_key);
+      }
+      packets.bytes += pkt.packet_len_wire;
+   }
+
+   m_seen += packets.cnt;
+   m_parsed += packets.cnt;
+   return packets.cnt ? Result::PARSED : Result::END_OF_FILE;
+}
+
+}
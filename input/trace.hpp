@@ -0,0 +1,132 @@
+/**
+ * \file trace.hpp
+ * \brief Replay of packet trace preloaded to memory
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+
+#ifndef IPXP_INPUT_TRACE_HPP
+#define IPXP_INPUT_TRACE_HPP
+
+#include <config.h>
+#include <string>
+#include <vector>
+
+#include <ipfixprobe/input.hpp>
+#include <ipfixprobe/packet.hpp>
+#include <ipfixprobe/options.hpp>
+#include <ipfixprobe/utils.hpp>
+
+#include "replay.hpp"
+
+namespace ipxp {
+
+#define TRACE_DEFAULT_DURATION 10 // 10s
+
+class TraceOptParser : public OptionsParser
+{
+public:
+   std::string m_file;
+   uint64_t m_duration;
+   uint32_t m_loops;
+   uint16_t m_pipelines;
+   uint16_t m_index;
+   bool m_hugepages;
+
+   TraceOptParser() : OptionsParser("trace", "Input plugin replaying pcap or pcapng trace preloaded to memory in a loop"),
+      m_file(""), m_duration(TRACE_DEFAULT_DURATION), m_loops(0), m_pipelines(1), m_index(0), m_hugepages(false)
+   {
+      register_option("f", "file", "PATH", "Path to a pcap or pcapng file or to a directory of them",
+         [this](const char *arg){m_file = arg; return true;}, OptionFlags::RequiredArgument);
+      register_option("d", "duration", "TIME", "Duration in seconds, 0 replays until loops are done",
+         [this](const char *arg){try {m_duration = str2num<decltype(m_duration)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("l", "loops", "NUM", "Number of times the trace is replayed, 0 loops until duration elapses",
+         [this](const char *arg){try {m_loops = str2num<decltype(m_loops)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("n", "pipelines", "NUM", "Replay the trace in NUM pipelines, each one with different addresses",
+         [this](const char *arg){try {m_pipelines = str2num<decltype(m_pipelines)>(arg); if (!m_pipelines) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("x", "index", "IDX", "Index of pipeline, set automatically for each pipeline",
+         [this](const char *arg){try {m_index = str2num<decltype(m_index)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("H", "hugepages", "", "Store packets in hugepages",
+         [this](const char *arg){m_hugepages = true; return true;}, OptionFlags::NoArgument);
+   }
+};
+
+struct Trace;
+
+/**
+ * \brief Replay of packets parsed once when the trace is loaded.
+ *
+ * Trace is shared by pipelines reading the same file. Each pipeline and loop XORs addresses
+ * with a different key, so replayed flows do not merge with flows of other loops.
+ */
+class TraceReader : public InputPlugin
+{
+public:
+   TraceReader();
+   ~TraceReader();
+
+   void init(const char *params);
+   void close();
+   OptionsParser *get_parser() const { return new TraceOptParser(); }
+   std::string get_name() const { return "trace"; }
+   InputPlugin::Result get(PacketBlock &packets);
+   std::vector<std::string> expand(const char *params) const;
+
+private:
+   std::string m_file;
+   bool m_hugepages;
+   Trace *m_trace;
+   size_t m_pos;            /**< Next packet of the trace */
+   uint64_t m_duration;     /**< Duration in nanoseconds */
+   uint64_t m_start;
+   uint16_t m_pipelines;
+   uint16_t m_index;
+   uint64_t m_loop;
+   uint32_t m_key;          /**< Key XORed to addresses of current loop */
+   Replay m_replay;
+
+   void load();
+};
+
+}
+#endif /* IPXP_INPUT_TRACE_HPP */
@@ -0,0 +1,430 @@
+/**
+ * \file xdp.cpp
+ * \brief Packet reader using AF_XDP sockets.
+ *    More info at https://www.kernel.org/doc/html/latest/networking/af_xdp.html
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <config.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/if_xdp.h>
+
+#include <ipfixprobe/clock.hpp>
+
+#include "xdp.hpp"
+#include "bpf.hpp"
+#include "parser.hpp"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+namespace ipxp {
+
+#define XDP_FRAME_SIZE 4096 /**< Size of UMEM frame, one packet per frame. */
+#define XDP_MAX_QUEUES 256 /**< Number of entries in the socket map. */
+#define XDP_STATS_PERIOD 1024 /**< Number of read batches between updates of drop counters. */
+
+__attribute__((constructor)) static void register_this_plugin()
+{
+   static PluginRecord rec = PluginRecord("xdp", [](){return new XdpReader();});
+   register_plugin(&rec);
+}
+
+/**
+ * \brief XDP program redirecting packets to sockets of an interface, shared by all queues.
+ */
+struct XdpProgram {
+   int map_fd;
+   int prog_fd;
+   int link_fd;
+   uint32_t refs;
+};
+
+static std::mutex xdp_programs_mtx;
+static std::map<int, XdpProgram> xdp_programs;
+
+/**
+ * \brief Load program equivalent to bpf_redirect_map(&xsks, ctx->rx_queue_index, XDP_PASS).
+ * Packets of queues without socket are passed to kernel.
+ */
+static int load_redirect_prog(int map_fd)
+{
+   BpfAsm prog;
+   prog.ldx(BPF_W, BPF_REG_2, BPF_REG_1, offsetof(struct xdp_md, rx_queue_index));
+   prog.ld_map(BPF_REG_1, map_fd);
+   prog.alu_imm(BPF_MOV, BPF_REG_3, XDP_PASS);
+   prog.call(BPF_FUNC_redirect_map);
+   prog.exit();
+
+   std::string log;
+   return bpf_prog_load(BPF_PROG_TYPE_XDP, prog.insns(), log);
+}
+
+/**
+ * \brief Attach redirect program to interface unless it is attached by other queue and register socket of queue.
+ */
+static void acquire_program(int ifindex, uint32_t queue, int sock, bool skb)
+{
+   std::lock_guard<std::mutex> lock(xdp_programs_mtx);
+   auto it = xdp_programs.find(ifindex);
+   if (it == xdp_programs.end()) {
+      XdpProgram prog = {-1, -1, -1, 0};
+      prog.map_fd = bpf_map_create(BPF_MAP_TYPE_XSKMAP, sizeof(uint32_t), sizeof(int), XDP_MAX_QUEUES);
+      if (prog.map_fd < 0) {
+         throw PluginError(std::string("unable to create socket map: ") + strerror(errno));
+      }
+      prog.prog_fd = load_redirect_prog(prog.map_fd);
+      if (prog.prog_fd < 0) {
+         int err = errno;
+         ::close(prog.map_fd);
+         throw PluginError(std::string("unable to load XDP program: ") + strerror(err));
+      }
+      prog.link_fd = bpf_xdp_attach(prog.prog_fd, ifindex, skb);
+      if (prog.link_fd < 0) {
+         int err = errno;
+         ::close(prog.prog_fd);
+         ::close(prog.map_fd);
+         throw PluginError(std::string("unable to attach XDP program: ") + strerror(err));
+      }
+      it = xdp_programs.insert(std::make_pair(ifindex, prog)).first;
+   }
+
+   if (bpf_map_update(it->second.map_fd, &queue, &sock, BPF_ANY) < 0) {
+      int err = errno;
+      if (!it->second.refs) {
+         ::close(it->second.link_fd);
+         ::close(it->second.prog_fd);
+         ::close(it->second.map_fd);
+         xdp_programs.erase(it);
+      }
+      throw PluginError(std::string("unable to register socket: ") + strerror(err));
+   }
+   it->second.refs++;
+}
+
+/**
+ * \brief Detach program from interface when sockets of all queues are closed.
+ */
+static void release_program(int ifindex)
+{
+   std::lock_guard<std::mutex> lock(xdp_programs_mtx);
+   auto it = xdp_programs.find(ifindex);
+   if (it == xdp_programs.end() || --it->second.refs) {
+      return;
+   }
+   ::close(it->second.link_fd);
+   ::close(it->second.prog_fd);
+   ::close(it->second.map_fd);
+   xdp_programs.erase(it);
+}
+
+XdpReader::XdpReader() : m_sock(-1), m_ifindex(0), m_queue(0), m_pfd({0}), m_umem(nullptr), m_umem_size(0),
+   m_frame_cnt(0), m_fill(), m_comp(), m_rx(), m_batches(0), m_attached(false), m_zero_copy(false)
+{
+}
+
+XdpReader::~XdpReader()
+{
+   close();
+}
+
+std::vector<std::string> XdpReader::expand(const char *params) const
+{
+   XdpOptParser parser;
+   try {
+      parser.parse(params);
+   } catch (ParserError &e) {
+      throw PluginError(e.what());
+   }
+
+   std::vector<std::string> args;
+   for (uint32_t i = 0; i < parser.m_queues; i++) {
+      args.push_back(std::string(params ? params : "") + OptionsParser::DELIM + "queue=" +
+         std::to_string(parser.m_queue + i) + OptionsParser::DELIM + "queues=1");
+   }
+   return args;
+}
+
+void XdpReader::init(const char *params)
+{
+   XdpOptParser parser;
+   try {
+      parser.parse(params);
+   } catch (ParserError &e) {
+      throw PluginError(e.what());
+   }
+
+   if (parser.m_ifc.empty()) {
+      throw PluginError("specify network interface");
+   }
+   m_ifindex = if_nametoindex(parser.m_ifc.c_str());
+   if (!m_ifindex) {
+      throw PluginError("unknown interface " + parser.m_ifc);
+   }
+   if (parser.m_queue >= XDP_MAX_QUEUES) {
+      throw PluginError("queue must be lower than " + std::to_string(XDP_MAX_QUEUES));
+   }
+   m_queue = parser.m_queue;
+   m_zero_copy = parser.m_zero_copy;
+   if (m_zero_copy) {
+      // Frames of queued packets are not in fill ring, the rest is left for kernel to receive packets
+      uint64_t held = static_cast<uint64_t>(m_queue_blocks) * m_block_size;
+      if (parser.m_frames <= held) {
+         throw PluginError("number of frames must exceed " + std::to_string(held) +
+            " in zero-copy mode, the number of packets in the input queue");
+      }
+   }
+
+   try {
+      open_socket(parser);
+   } catch (PluginError &e) {
+      close();
+      throw;
+   }
+}
+
+void XdpReader::close()
+{
+   if (m_sock >= 0) {
+      // Socket is removed from the socket map when closed
+      ::close(m_sock);
+      m_sock = -1;
+   }
+   if (m_attached) {
+      release_program(m_ifindex);
+      m_attached = false;
+   }
+   unmap_ring(m_fill);
+   unmap_ring(m_comp);
+   unmap_ring(m_rx);
+   if (m_umem != nullptr) {
+      munmap(m_umem, m_umem_size);
+      m_umem = nullptr;
+   }
+   m_held.clear();
+}
+
+void XdpReader::map_ring(XdpRing &ring, uint32_t size, size_t desc_size, off_t pgoff, const struct xdp_ring_offset &off)
+{
+   size_t map_size = off.desc + size * desc_size;
+   void *map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_sock, pgoff);
+   if (map == MAP_FAILED) {
+      throw PluginError(std::string("unable to map ring: ") + strerror(errno));
+   }
+   uint8_t *base = static_cast<uint8_t *>(map);
+   ring.producer = reinterpret_cast<uint32_t *>(base + off.producer);
+   ring.consumer = reinterpret_cast<uint32_t *>(base + off.consumer);
+   ring.flags = reinterpret_cast<uint32_t *>(base + off.flags);
+   ring.ring = base + off.desc;
+   ring.mask = size - 1;
+   ring.size = size;
+   ring.map = map;
+   ring.map_size = map_size;
+}
+
+void XdpReader::unmap_ring(XdpRing &ring)
+{
+   if (ring.map != nullptr) {
+      munmap(ring.map, ring.map_size);
+   }
+   ring = XdpRing();
+}
+
+void XdpReader::open_socket(const XdpOptParser &parser)
+{
+   m_sock = socket(AF_XDP, SOCK_RAW, 0);
+   if (m_sock == -1) {
+      throw PluginError(std::string("unable to create AF_XDP socket: ") + strerror(errno));
+   }
+
+   m_frame_cnt = parser.m_frames;
+   m_umem_size = static_cast<size_t>(m_frame_cnt) * XDP_FRAME_SIZE;
+   void *umem = mmap(nullptr, m_umem_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (umem == MAP_FAILED) {
+      throw PluginError(std::string("unable to allocate UMEM: ") + strerror(errno));
+   }
+   m_umem = static_cast<uint8_t *>(umem);
+
+   struct xdp_umem_reg reg;
+   memset(&reg, 0, sizeof(reg));
+   reg.addr = reinterpret_cast<uint64_t>(m_umem);
+   reg.len = m_umem_size;
+   reg.chunk_size = XDP_FRAME_SIZE;
+   reg.headroom = 0;
+   if (setsockopt(m_sock, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) == -1) {
+      throw PluginError(std::string("unable to register UMEM: ") + strerror(errno));
+   }
+
+   // Fill ring can hold all frames, so returning frames never waits for kernel
+   uint32_t ring_size = m_frame_cnt;
+   if (setsockopt(m_sock, SOL_XDP, XDP_UMEM_FILL_RING, &ring_size, sizeof(ring_size)) == -1 ||
+      setsockopt(m_sock, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ring_size, sizeof(ring_size)) == -1 ||
+      setsockopt(m_sock, SOL_XDP, XDP_RX_RING, &ring_size, sizeof(ring_size)) == -1) {
+      throw PluginError(std::string("unable to create rings: ") + strerror(errno));
+   }
+
+   struct xdp_mmap_offsets off;
+   socklen_t optlen = sizeof(off);
+   if (getsockopt(m_sock, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) == -1) {
+      throw PluginError(std::string("unable to get ring offsets: ") + strerror(errno));
+   }
+   map_ring(m_fill, ring_size, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING, off.fr);
+   map_ring(m_comp, ring_size, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING, off.cr);
+   map_ring(m_rx, ring_size, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING, off.rx);
+
+   struct sockaddr_xdp addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sxdp_family = AF_XDP;
+   addr.sxdp_ifindex = m_ifindex;
+   addr.sxdp_queue_id = m_queue;
+   addr.sxdp_flags = XDP_USE_NEED_WAKEUP | (parser.m_copy ? XDP_COPY : XDP_ZEROCOPY);
+   if (bind(m_sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1) {
+      // Driver does not support zero-copy, kernel copies packets to UMEM
+      addr.sxdp_flags = XDP_USE_NEED_WAKEUP | XDP_COPY;
+      if (parser.m_copy || bind(m_sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1) {
+         throw PluginError(std::string("bind failed: ") + strerror(errno));
+      }
+   }
+
+   std::vector<uint64_t> frames;
+   for (uint32_t i = 0; i < m_frame_cnt; i++) {
+      frames.push_back(static_cast<uint64_t>(i) * XDP_FRAME_SIZE);
+   }
+   fill_frames(frames.data(), frames.size());
+
+   acquire_program(m_ifindex, m_queue, m_sock, parser.m_skb);
+   m_attached = true;
+
+   memset(&m_pfd, 0, sizeof(m_pfd));
+   m_pfd.fd = m_sock;
+   m_pfd.events = POLLIN;
+   m_pfd.revents = 0;
+}
+
+void XdpReader::fill_frames(const uint64_t *addrs, uint32_t cnt)
+{
+   uint32_t prod = *m_fill.producer;
+   uint64_t *ring = static_cast<uint64_t *>(m_fill.ring);
+   for (uint32_t i = 0; i < cnt; i++) {
+      ring[(prod + i) & m_fill.mask] = addrs[i];
+   }
+   __atomic_store_n(m_fill.producer, prod + cnt, __ATOMIC_RELEASE);
+}
+
+void XdpReader::release_frames(const PacketBlock &packets)
+{
+   // Packet block is passed again only after it was consumed by storage or dropped
+   auto it = m_held.find(&packets);
+   if (it == m_held.end() || it->second.empty()) {
+      return;
+   }
+   fill_frames(it->second.data(), it->second.size());
+   it->second.clear();
+}
+
+void XdpReader::update_stats()
+{
+   struct xdp_statistics stats;
+   socklen_t optlen = sizeof(stats);
+   memset(&stats, 0, sizeof(stats));
+   if (getsockopt(m_sock, SOL_XDP, XDP_STATISTICS, &stats, &optlen) == 0) {
+      m_dropped = stats.rx_dropped + stats.rx_ring_full + stats.rx_fill_ring_empty_descs;
+   }
+}
+
+InputPlugin::Result XdpReader::get(PacketBlock &packets)
+{
+   if (m_zero_copy) {
+      release_frames(packets);
+   }
+   packets.cnt = 0;
+
+   uint32_t cons = *m_rx.consumer;
+   uint32_t avail = __atomic_load_n(m_rx.producer, __ATOMIC_ACQUIRE) - cons;
+   if (!avail) {
+      // Kernel stops filling the RX ring when the fill ring was empty until woken up
+      if (*m_fill.flags & XDP_RING_NEED_WAKEUP) {
+         if (poll(&m_pfd, 1, 0) == -1) {
+            throw PluginError(std::string("poll: ") + strerror(errno));
+         }
+      }
+      update_stats();
+      return Result::TIMEOUT;
+   }
+
+   parser_opt_t opt = {&packets, false, false, DLT_EN10MB, m_zero_copy, m_payload_horizon, m_decap_depth, &m_fragments, m_malformed};
+   uint32_t cnt = avail < packets.size ? avail : packets.size;
+   const struct xdp_desc *descs = static_cast<const struct xdp_desc *>(m_rx.ring);
+   std::vector<uint64_t> &frames = m_zero_copy ? m_held[&packets] : m_frames;
+   timestamp_t ts = clock_realtime_precise_ns();
+
+   for (uint32_t i = 0; i < cnt; i++) {
+      const struct xdp_desc &desc = descs[(cons + i) & m_rx.mask];
+      parse_packet(&opt, ts, m_umem + desc.addr, desc.len, desc.len);
+      frames.push_back(desc.addr & ~static_cast<uint64_t>(XDP_FRAME_SIZE - 1));
+   }
+   __atomic_store_n(m_rx.consumer, cons + cnt, __ATOMIC_RELEASE);
+   if (!m_zero_copy) {
+      fill_frames(frames.data(), frames.size());
+      frames.clear();
+   }
+
+   if (++m_batches % XDP_STATS_PERIOD == 0) {
+      update_stats();
+   }
+   m_seen += cnt;
+   m_parsed += packets.cnt;
+   return packets.cnt ? Result::PARSED : Result::NOT_PARSED;
+}
+
+}
@@ -0,0 +1,150 @@
+/**
+ * \file xdp.hpp
+ * \brief Packet reader using AF_XDP sockets
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_INPUT_XDP_HPP
+#define IPXP_INPUT_XDP_HPP
+
+#include <config.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <linux/if_xdp.h>
+
+#include <ipfixprobe/input.hpp>
+#include <ipfixprobe/packet.hpp>
+#include <ipfixprobe/options.hpp>
+#include <ipfixprobe/utils.hpp>
+
+namespace ipxp {
+
+class XdpOptParser : public OptionsParser
+{
+public:
+   std::string m_ifc;
+   uint32_t m_queue;
+   uint32_t m_queues;
+   uint32_t m_frames;
+   bool m_copy;
+   bool m_skb;
+   bool m_zero_copy;
+
+   XdpOptParser() : OptionsParser("xdp", "Input plugin for reading packets from AF_XDP sockets"),
+      m_ifc(""), m_queue(0), m_queues(1), m_frames(4096), m_copy(false), m_skb(false), m_zero_copy(false)
+   {
+      register_option("i", "ifc", "IFC", "Network interface name", [this](const char *arg){m_ifc = arg; return true;}, OptionFlags::RequiredArgument);
+      register_option("q", "queue", "ID", "First RX queue to read",
+         [this](const char *arg){try {m_queue = str2num<decltype(m_queue)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("n", "queues", "NUM", "Number of RX queues starting at the first one, each one is read by separate pipeline",
+         [this](const char *arg){try {m_queues = str2num<decltype(m_queues)>(arg); if (!m_queues) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("f", "frames", "NUM", "Number of UMEM frames per queue (power of two num)",
+         [this](const char *arg){try {m_frames = str2num<decltype(m_frames)>(arg); if (!m_frames || (m_frames & (m_frames - 1))) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("c", "copy", "", "Bind sockets in copy mode even if the driver supports zero-copy",
+         [this](const char *arg){m_copy = true; return true;}, OptionFlags::NoArgument);
+      register_option("s", "skb", "", "Attach XDP program in generic (skb) mode even if the driver supports native XDP",
+         [this](const char *arg){m_skb = true; return true;}, OptionFlags::NoArgument);
+      register_option("z", "zerocopy", "", "Pass packets to processing plugins directly from UMEM without copying. Frames are returned to kernel after the packets are processed, number of frames must exceed number of packets in the input queue",
+         [this](const char *arg){m_zero_copy = true; return true;}, OptionFlags::NoArgument);
+   }
+};
+
+/**
+ * \brief Producer and consumer indexes of one AF_XDP ring mapped to user space.
+ */
+struct XdpRing {
+   uint32_t *producer;
+   uint32_t *consumer;
+   uint32_t *flags;
+   void *ring;
+   uint32_t mask;
+   uint32_t size;
+   void *map;
+   size_t map_size;
+};
+
+class XdpReader : public InputPlugin
+{
+public:
+   XdpReader();
+   ~XdpReader();
+   void init(const char *params);
+   void close();
+   OptionsParser *get_parser() const { return new XdpOptParser(); }
+   std::string get_name() const { return "xdp"; }
+   InputPlugin::Result get(PacketBlock &packets);
+   bool zero_copy() const { return m_zero_copy; }
+   std::vector<std::string> expand(const char *params) const;
+
+private:
+   int m_sock;
+   int m_ifindex;
+   uint32_t m_queue;
+   struct pollfd m_pfd;
+
+   uint8_t *m_umem;
+   size_t m_umem_size;
+   uint32_t m_frame_cnt;
+
+   XdpRing m_fill;
+   XdpRing m_comp;
+   XdpRing m_rx;
+
+   uint32_t m_batches;
+   bool m_attached;
+   bool m_zero_copy;
+   std::vector<uint64_t> m_frames; /**< UMEM frames of the last batch in copy mode. */
+   std::map<const PacketBlock *, std::vector<uint64_t>> m_held; /**< UMEM frames referenced by packet blocks. */
+
+   void open_socket(const XdpOptParser &parser);
+   void map_ring(XdpRing &ring, uint32_t size, size_t desc_size, off_t pgoff, const struct xdp_ring_offset &off);
+   void unmap_ring(XdpRing &ring);
+   void fill_frames(const uint64_t *addrs, uint32_t cnt);
+   void release_frames(const PacketBlock &packets);
+   void update_stats();
+};
+
+}
+#endif /* IPXP_INPUT_XDP_HPP */
@@ -0,0 +1,573 @@
+/**
+ * \file xdpflow.cpp
+ * \brief Flow records aggregated by XDP program in kernel.
+ *    More info at https://www.kernel.org/doc/html/latest/bpf/map_hash.html
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <config.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <unordered_map>
+
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <net/ethernet.h>
+#include <netinet/in.h>
+
+#include <ipfixprobe/clock.hpp>
+
+#include "xdpflow.hpp"
+#include "bpf.hpp"
+
+namespace ipxp {
+
+__attribute__((constructor)) static void register_this_plugin()
+{
+   static PluginRecord rec = PluginRecord("xdpflow", [](){return new XdpFlowReader();});
+   register_plugin(&rec);
+}
+
+/**
+ * \brief Offset of map key or value field usable as instruction offset.
+ */
+#define FIELD(type, field) static_cast<int16_t>(offsetof(type, field))
+
+/**
+ * \brief Build program counting packets of each flow in per-CPU hash map.
+ * Packets which are not IPv4 or IPv6 are always passed to kernel.
+ * \param [in] flow_map Map of flows.
+ * \param [in] fail_map Per-CPU counter of packets not counted because flow map was full.
+ * \param [in] action Verdict of counted packets.
+ */
+static std::vector<struct bpf_insn> flow_prog(int flow_map, int fail_map, int action)
+{
+   const int16_t key = -static_cast<int16_t>(sizeof(XdpFlowKey));
+   const int16_t val = key - static_cast<int16_t>(sizeof(XdpFlowValue));
+   const int16_t fail_key = val - static_cast<int16_t>(sizeof(uint32_t));
+   BpfAsm p;
+   // r6 = current header, r7 = end of packet, r8 = IP length, r9 = protocol and later TCP flags
+   auto check_len = [&p](int32_t len, const std::string &fail) {
+      p.alu_reg(BPF_MOV, BPF_REG_2, BPF_REG_6);
+      p.alu_imm(BPF_ADD, BPF_REG_2, len);
+      p.jmp_reg(BPF_JGT, BPF_REG_2, BPF_REG_7, fail);
+   };
+
+   p.ldx(BPF_W, BPF_REG_6, BPF_REG_1, offsetof(struct xdp_md, data));
+   p.ldx(BPF_W, BPF_REG_7, BPF_REG_1, offsetof(struct xdp_md, data_end));
+   for (int16_t off = key; off < 0; off += 8) {
+      p.st(BPF_DW, BPF_REG_10, off, 0);
+   }
+
+   // Ethernet with optional VLAN tag
+   check_len(ETH_HLEN, "pass");
+   p.ldx(BPF_H, BPF_REG_8, BPF_REG_6, 12);
+   p.alu_imm(BPF_MOV, BPF_REG_9, ETH_HLEN);
+   p.jmp_imm(BPF_JEQ, BPF_REG_8, htons(ETH_P_8021Q), "vlan");
+   p.jmp_imm(BPF_JNE, BPF_REG_8, htons(ETH_P_8021AD), "l3");
+   p.label("vlan");
+   check_len(ETH_HLEN + 4, "pass");
+   p.ldx(BPF_H, BPF_REG_8, BPF_REG_6, 16);
+   p.alu_imm(BPF_MOV, BPF_REG_9, ETH_HLEN + 4);
+   p.label("l3");
+   p.alu_reg(BPF_ADD, BPF_REG_6, BPF_REG_9);
+   p.jmp_imm(BPF_JEQ, BPF_REG_8, htons(ETH_P_IP), "ipv4");
+   p.jmp_imm(BPF_JEQ, BPF_REG_8, htons(ETH_P_IPV6), "ipv6");
+   p.jmp("pass");
+
+   p.label("ipv4");
+   check_len(20, "pass");
+   p.st(BPF_B, BPF_REG_10, key + FIELD(XdpFlowKey, ip_version), 4);
+   p.ldx(BPF_B, BPF_REG_9, BPF_REG_6, 9);
+   p.stx(BPF_B, BPF_REG_10, BPF_REG_9, key + FIELD(XdpFlowKey, ip_proto));
+   p.ldx(BPF_W, BPF_REG_2, BPF_REG_6, 12);
+   p.stx(BPF_W, BPF_REG_10, BPF_REG_2, key + FIELD(XdpFlowKey, src_ip));
+   p.ldx(BPF_W, BPF_REG_2, BPF_REG_6, 16);
+   p.stx(BPF_W, BPF_REG_10, BPF_REG_2, key + FIELD(XdpFlowKey, dst_ip));
+   p.ldx(BPF_H, BPF_REG_8, BPF_REG_6, 2);
+   p.be16(BPF_REG_8);
+   // Only the first fragment has ports
+   p.ldx(BPF_H, BPF_REG_2, BPF_REG_6, 6);
+   p.alu_imm(BPF_AND, BPF_REG_2, htons(0x1FFF));
+   p.jmp_imm(BPF_JNE, BPF_REG_2, 0, "no_ports");
+   p.ldx(BPF_B, BPF_REG_2, BPF_REG_6, 0);
+   p.alu_imm(BPF_AND, BPF_REG_2, 0x0F);
+   p.alu_imm(BPF_LSH, BPF_REG_2, 2);
+   p.alu_reg(BPF_ADD, BPF_REG_6, BPF_REG_2);
+   p.jmp("l4");
+
+   p.label("ipv6");
+   check_len(40, "pass");
+   p.st(BPF_B, BPF_REG_10, key + FIELD(XdpFlowKey, ip_version), 6);
+   p.ldx(BPF_B, BPF_REG_9, BPF_REG_6, 6);
+   p.stx(BPF_B, BPF_REG_10, BPF_REG_9, key + FIELD(XdpFlowKey, ip_proto));
+   for (int16_t off = 0; off < 16; off += 4) {
+      p.ldx(BPF_W, BPF_REG_2, BPF_REG_6, 8 + off);
+      p.stx(BPF_W, BPF_REG_10, BPF_REG_2, key + FIELD(XdpFlowKey, src_ip) + off);
+      p.ldx(BPF_W, BPF_REG_2, BPF_REG_6, 24 + off);
+      p.stx(BPF_W, BPF_REG_10, BPF_REG_2, key + FIELD(XdpFlowKey, dst_ip) + off);
+   }
+   p.ldx(BPF_H, BPF_REG_8, BPF_REG_6, 4);
+   p.be16(BPF_REG_8);
+   p.alu_imm(BPF_ADD, BPF_REG_8, 40);
+   p.alu_imm(BPF_ADD, BPF_REG_6, 40);
+
+   // Ports are read like the userspace parser does, extension headers are not skipped
+   p.label("l4");
+   check_len(4, "no_ports");
+   p.jmp_imm(BPF_JEQ, BPF_REG_9, IPPROTO_ICMP, "icmp");
+   p.jmp_imm(BPF_JEQ, BPF_REG_9, IPPROTO_ICMPV6, "icmp");
+   p.jmp_imm(BPF_JEQ, BPF_REG_9, IPPROTO_UDP, "udp");
+   p.jmp_imm(BPF_JNE, BPF_REG_9, IPPROTO_TCP, "no_ports");
+   check_len(14, "udp");
+   p.ldx(BPF_B, BPF_REG_9, BPF_REG_6, 13);
+   p.jmp("ports");
+   p.label("udp");
+   p.alu_imm(BPF_MOV, BPF_REG_9, 0);
+   p.label("ports");
+   p.ldx(BPF_H, BPF_REG_2, BPF_REG_6, 0);
+   p.stx(BPF_H, BPF_REG_10, BPF_REG_2, key + FIELD(XdpFlowKey, src_port));
+   p.ldx(BPF_H, BPF_REG_2, BPF_REG_6, 2);
+   p.stx(BPF_H, BPF_REG_10, BPF_REG_2, key + FIELD(XdpFlowKey, dst_port));
+   p.jmp("lookup");
+   p.label("icmp");
+   p.ldx(BPF_H, BPF_REG_2, BPF_REG_6, 0);
+   p.stx(BPF_H, BPF_REG_10, BPF_REG_2, key + FIELD(XdpFlowKey, dst_port));
+   p.label("no_ports");
+   p.alu_imm(BPF_MOV, BPF_REG_9, 0);
+
+   // Update counters of this CPU, no atomic operations are needed in per-CPU map
+   p.label("lookup");
+   p.ld_map(BPF_REG_1, flow_map);
+   p.alu_reg(BPF_MOV, BPF_REG_2, BPF_REG_10);
+   p.alu_imm(BPF_ADD, BPF_REG_2, key);
+   p.call(BPF_FUNC_map_lookup_elem);
+   p.jmp_imm(BPF_JEQ, BPF_REG_0, 0, "create");
+   p.ldx(BPF_DW, BPF_REG_1, BPF_REG_0, FIELD(XdpFlowValue, packets));
+   p.alu_imm(BPF_ADD, BPF_REG_1, 1);
+   p.stx(BPF_DW, BPF_REG_0, BPF_REG_1, FIELD(XdpFlowValue, packets));
+   p.ldx(BPF_DW, BPF_REG_1, BPF_REG_0, FIELD(XdpFlowValue, bytes));
+   p.alu_reg(BPF_ADD, BPF_REG_1, BPF_REG_8);
+   p.stx(BPF_DW, BPF_REG_0, BPF_REG_1, FIELD(XdpFlowValue, bytes));
+   p.ldx(BPF_DW, BPF_REG_1, BPF_REG_0, FIELD(XdpFlowValue, tcp_flags));
+   p.alu_reg(BPF_OR, BPF_REG_1, BPF_REG_9);
+   p.stx(BPF_DW, BPF_REG_0, BPF_REG_1, FIELD(XdpFlowValue, tcp_flags));
+   p.alu_reg(BPF_MOV, BPF_REG_6, BPF_REG_0);
+   p.call(BPF_FUNC_ktime_get_ns);
+   p.stx(BPF_DW, BPF_REG_6, BPF_REG_0, FIELD(XdpFlowValue, last));
+   p.jmp("done");
+
+   // First packet of flow on this CPU, values of other CPUs are not touched by update
+   p.label("create");
+   p.call(BPF_FUNC_ktime_get_ns);
+   p.st(BPF_DW, BPF_REG_10, val + FIELD(XdpFlowValue, packets), 1);
+   p.stx(BPF_DW, BPF_REG_10, BPF_REG_8, val + FIELD(XdpFlowValue, bytes));
+   p.stx(BPF_DW, BPF_REG_10, BPF_REG_0, val + FIELD(XdpFlowValue, first));
+   p.stx(BPF_DW, BPF_REG_10, BPF_REG_0, val + FIELD(XdpFlowValue, last));
+   p.stx(BPF_DW, BPF_REG_10, BPF_REG_9, val + FIELD(XdpFlowValue, tcp_flags));
+   p.ld_map(BPF_REG_1, flow_map);
+   p.alu_reg(BPF_MOV, BPF_REG_2, BPF_REG_10);
+   p.alu_imm(BPF_ADD, BPF_REG_2, key);
+   p.alu_reg(BPF_MOV, BPF_REG_3, BPF_REG_10);
+   p.alu_imm(BPF_ADD, BPF_REG_3, val);
+   p.alu_imm(BPF_MOV, BPF_REG_4, BPF_ANY);
+   p.call(BPF_FUNC_map_update_elem);
+   p.jmp_imm(BPF_JEQ, BPF_REG_0, 0, "done");
+   p.st(BPF_W, BPF_REG_10, fail_key, 0);
+   p.ld_map(BPF_REG_1, fail_map);
+   p.alu_reg(BPF_MOV, BPF_REG_2, BPF_REG_10);
+   p.alu_imm(BPF_ADD, BPF_REG_2, fail_key);
+   p.call(BPF_FUNC_map_lookup_elem);
+   p.jmp_imm(BPF_JEQ, BPF_REG_0, 0, "done");
+   p.ldx(BPF_DW, BPF_REG_1, BPF_REG_0, 0);
+   p.alu_imm(BPF_ADD, BPF_REG_1, 1);
+   p.stx(BPF_DW, BPF_REG_0, BPF_REG_1, 0);
+
+   p.label("done");
+   p.alu_imm(BPF_MOV, BPF_REG_0, action);
+   p.exit();
+   p.label("pass");
+   p.alu_imm(BPF_MOV, BPF_REG_0, XDP_PASS);
+   p.exit();
+   return p.insns();
+}
+
+XdpFlowReader::XdpFlowReader() : m_flow_map(-1), m_fail_map(-1), m_prog(-1), m_link(-1), m_cpus(0),
+   m_active(0), m_inactive(0), m_period(0), m_next_scan(0), m_flushed(false), m_lookup_delete(true), m_expired_idx(0)
+{
+}
+
+XdpFlowReader::~XdpFlowReader()
+{
+   close();
+}
+
+void XdpFlowReader::init(const char *params)
+{
+   XdpFlowOptParser parser;
+   try {
+      parser.parse(params);
+   } catch (ParserError &e) {
+      throw PluginError(e.what());
+   }
+
+   if (parser.m_ifc.empty()) {
+      throw PluginError("specify network interface");
+   }
+   m_active = parser.m_active * NANO_SEC;
+   m_inactive = parser.m_inactive * NANO_SEC;
+   m_period = parser.m_period * NANO_SEC;
+   m_cpus = bpf_possible_cpus();
+
+   try {
+      load_program(parser.m_ifc, parser.m_entries, parser.m_skb, parser.m_drop);
+   } catch (PluginError &e) {
+      close();
+      throw;
+   }
+}
+
+void XdpFlowReader::close()
+{
+   // Program is detached from interface when the link is closed
+   int *fds[] = {&m_link, &m_prog, &m_fail_map, &m_flow_map};
+   for (auto fd : fds) {
+      if (*fd >= 0) {
+         ::close(*fd);
+         *fd = -1;
+      }
+   }
+   m_blocks.clear();
+}
+
+void XdpFlowReader::load_program(const std::string &ifc, uint32_t entries, bool skb, bool drop)
+{
+   int ifindex = if_nametoindex(ifc.c_str());
+   if (!ifindex) {
+      throw PluginError("unknown interface " + ifc);
+   }
+   m_flow_map = bpf_map_create(BPF_MAP_TYPE_PERCPU_HASH, sizeof(XdpFlowKey), sizeof(XdpFlowValue), entries);
+   if (m_flow_map < 0) {
+      throw PluginError(std::string("unable to create flow map: ") + strerror(errno));
+   }
+   m_fail_map = bpf_map_create(BPF_MAP_TYPE_PERCPU_ARRAY, sizeof(uint32_t), sizeof(uint64_t), 1);
+   if (m_fail_map < 0) {
+      throw PluginError(std::string("unable to create counter map: ") + strerror(errno));
+   }
+
+   std::string log;
+   m_prog = bpf_prog_load(BPF_PROG_TYPE_XDP, flow_prog(m_flow_map, m_fail_map, drop ? XDP_DROP : XDP_PASS), log);
+   if (m_prog < 0) {
+      throw PluginError(std::string("unable to load XDP program: ") + strerror(errno) + (log.empty() ? "" : "\n" + log));
+   }
+   m_link = bpf_xdp_attach(m_prog, ifindex, skb);
+   if (m_link < 0) {
+      throw PluginError(std::string("unable to attach XDP program: ") + strerror(errno));
+   }
+}
+
+/**
+ * \brief Get monotonic time of the same clock as bpf_ktime_get_ns() together with real time.
+ */
+static void get_times(uint64_t &mono, timestamp_t &real)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   mono = ts.tv_sec * NANO_SEC + ts.tv_nsec;
+   clock_gettime(CLOCK_REALTIME, &ts);
+   real = ts_from_nsec(ts.tv_sec, ts.tv_nsec);
+}
+
+/**
+ * \brief Hash of flow map key for merging both directions of biflows.
+ */
+struct XdpFlowKeyHash {
+   size_t operator()(const XdpFlowKey &key) const
+   {
+      size_t hash = key.ip_proto ^ (static_cast<size_t>(key.src_port) << 8) ^ (static_cast<size_t>(key.dst_port) << 24);
+      for (size_t i = 0; i < sizeof(key.src_ip); i++) {
+         hash = hash * 31 + (key.src_ip[i] ^ key.dst_ip[i]);
+      }
+      return hash;
+   }
+};
+
+struct XdpFlowKeyEqual {
+   bool operator()(const XdpFlowKey &a, const XdpFlowKey &b) const
+   {
+      return !memcmp(&a, &b, sizeof(a));
+   }
+};
+
+/**
+ * \brief Sum per-CPU values of a flow.
+ */
+static XdpFlowValue sum_values(const std::vector<XdpFlowValue> &values)
+{
+   XdpFlowValue total = {0, 0, UINT64_MAX, 0, 0};
+   for (auto &it : values) {
+      if (!it.packets) {
+         continue;
+      }
+      total.packets += it.packets;
+      total.bytes += it.bytes;
+      total.first = std::min(total.first, it.first);
+      total.last = std::max(total.last, it.last);
+      total.tcp_flags |= it.tcp_flags;
+   }
+   return total;
+}
+
+/**
+ * \brief Remove flow from kernel map and read its final values.
+ * \return False when the flow is not in the map anymore.
+ */
+bool XdpFlowReader::take(const XdpFlowKey &key, std::vector<XdpFlowValue> &values)
+{
+   if (m_lookup_delete) {
+      if (bpf_map_lookup_and_delete(m_flow_map, &key, values.data()) == 0) {
+         return true;
+      }
+      if (errno == ENOENT) {
+         return false;
+      }
+      // Per-CPU hash maps support lookup and delete since Linux 5.14
+      m_lookup_delete = false;
+   }
+
+   // Values are read again right before delete, so only packets counted in between are lost
+   if (bpf_map_lookup(m_flow_map, &key, values.data()) != 0) {
+      return false;
+   }
+   return bpf_map_delete(m_flow_map, &key) == 0;
+}
+
+/**
+ * \brief Read expired flows from kernel map.
+ * \param [in] all Read all flows regardless of timeouts.
+ */
+void XdpFlowReader::scan(bool all)
+{
+   uint64_t now;
+   timestamp_t real;
+   get_times(now, real);
+
+   // Keys are removed only after the whole map is walked, iteration starts over when the current key is deleted
+   std::vector<XdpFlowValue> values(m_cpus);
+   std::vector<XdpFlowKey> expired;
+   std::vector<uint8_t> expired_reasons;
+   XdpFlowKey key;
+   XdpFlowKey next;
+   const void *prev = nullptr;
+   while (bpf_map_next_key(m_flow_map, prev, &next) == 0) {
+      key = next;
+      prev = &key;
+      if (bpf_map_lookup(m_flow_map, &key, values.data()) != 0) {
+         continue;
+      }
+      XdpFlowValue total = sum_values(values);
+      if (!total.packets) {
+         continue;
+      }
+      if (all) {
+         expired_reasons.push_back(FLOW_END_FORCED);
+      } else if (now - total.last >= m_inactive) {
+         expired_reasons.push_back(FLOW_END_INACTIVE);
+      } else if (now - total.first >= m_active) {
+         expired_reasons.push_back(FLOW_END_ACTIVE);
+      } else {
+         continue;
+      }
+      expired.push_back(key);
+   }
+
+   // Counters are taken at removal, so packets counted since the walk are exported too
+   std::vector<XdpFlowKey> keys;
+   std::vector<XdpFlowValue> totals;
+   std::vector<uint8_t> reasons;
+   std::unordered_map<XdpFlowKey, size_t, XdpFlowKeyHash, XdpFlowKeyEqual> flows;
+   for (size_t i = 0; i < expired.size(); i++) {
+      if (!take(expired[i], values)) {
+         continue;
+      }
+      XdpFlowValue total = sum_values(values);
+      if (!total.packets) {
+         continue;
+      }
+      flows[expired[i]] = keys.size();
+      keys.push_back(expired[i]);
+      totals.push_back(total);
+      reasons.push_back(expired_reasons[i]);
+   }
+
+   m_expired.clear();
+   m_expired_idx = 0;
+   std::vector<bool> merged(keys.size(), false);
+   for (size_t i = 0; i < keys.size(); i++) {
+      if (merged[i]) {
+         continue;
+      }
+
+      // Opposite direction expired at the same time is merged into biflow started by the earlier direction
+      size_t src = i;
+      size_t dst = keys.size();
+      XdpFlowKey inv = keys[i];
+      inv.src_port = keys[i].dst_port;
+      inv.dst_port = keys[i].src_port;
+      memcpy(inv.src_ip, keys[i].dst_ip, sizeof(inv.src_ip));
+      memcpy(inv.dst_ip, keys[i].src_ip, sizeof(inv.dst_ip));
+      auto it = flows.find(inv);
+      if (it != flows.end() && it->second != i) {
+         dst = it->second;
+         merged[dst] = true;
+         if (totals[dst].first < totals[src].first) {
+            std::swap(src, dst);
+         }
+      }
+
+      const XdpFlowKey &k = keys[src];
+      Flow flow = Flow();
+      flow.ip_version = k.ip_version;
+      flow.ip_proto = k.ip_proto;
+      flow.src_port = ntohs(k.src_port);
+      flow.dst_port = ntohs(k.dst_port);
+      if (k.ip_version == IP::v4) {
+         memcpy(&flow.src_ip.v4, k.src_ip, sizeof(flow.src_ip.v4));
+         memcpy(&flow.dst_ip.v4, k.dst_ip, sizeof(flow.dst_ip.v4));
+      } else {
+         memcpy(flow.src_ip.v6, k.src_ip, sizeof(flow.src_ip.v6));
+         memcpy(flow.dst_ip.v6, k.dst_ip, sizeof(flow.dst_ip.v6));
+      }
+      flow.time_first = real - (now - totals[src].first);
+      flow.time_last = real - (now - totals[src].last);
+      flow.src_packets = totals[src].packets;
+      flow.src_bytes = totals[src].bytes;
+      flow.src_tcp_flags = totals[src].tcp_flags;
+      flow.end_reason = reasons[src];
+      if (dst != keys.size()) {
+         flow.time_last = std::max(flow.time_last, real - (now - totals[dst].last));
+         flow.dst_packets = totals[dst].packets;
+         flow.dst_bytes = totals[dst].bytes;
+         flow.dst_tcp_flags = totals[dst].tcp_flags;
+      }
+      m_expired.push_back(flow);
+   }
+}
+
+void XdpFlowReader::update_stats()
+{
+   uint32_t key = 0;
+   std::vector<uint64_t> values(m_cpus);
+   if (bpf_map_lookup(m_fail_map, &key, values.data()) != 0) {
+      return;
+   }
+   uint64_t dropped = 0;
+   for (auto it : values) {
+      dropped += it;
+   }
+   m_dropped = dropped;
+}
+
+InputPlugin::Result XdpFlowReader::get(PacketBlock &packets)
+{
+   packets.cnt = 0;
+   if (m_expired_idx == m_expired.size()) {
+      uint64_t now = clock_monotonic();
+      if (now < m_next_scan) {
+         return Result::TIMEOUT;
+      }
+      m_next_scan = now + m_period;
+      scan(false);
+      update_stats();
+      if (m_expired.empty()) {
+         return Result::TIMEOUT;
+      }
+   }
+   return fill(packets);
+}
+
+InputPlugin::Result XdpFlowReader::flush(PacketBlock &packets)
+{
+   packets.cnt = 0;
+   if (m_expired_idx == m_expired.size()) {
+      if (m_flushed || m_flow_map < 0) {
+         return Result::END_OF_FILE;
+      }
+      // Program is detached first, so no packets are counted after flows are read
+      if (m_link >= 0) {
+         ::close(m_link);
+         m_link = -1;
+      }
+      m_flushed = true;
+      scan(true);
+      update_stats();
+      if (m_expired.empty()) {
+         return Result::END_OF_FILE;
+      }
+   }
+   return fill(packets);
+}
+
+/**
+ * \brief Pass flows read from kernel map to storage.
+ */
+InputPlugin::Result XdpFlowReader::fill(PacketBlock &packets)
+{
+   // Flows stay valid until the block is passed again, i.e. it was consumed by storage or dropped
+   std::vector<Flow> &flows = m_blocks[&packets];
+   size_t cnt = std::min(packets.size, m_expired.size() - m_expired_idx);
+   flows.assign(m_expired.begin() + m_expired_idx, m_expired.begin() + m_expired_idx + cnt);
+   m_expired_idx += cnt;
+
+   packets.flows = flows.data();
+   packets.flow_cnt = cnt;
+   packets.bytes = 0;
+   for (auto &it : flows) {
+      packets.bytes += it.src_bytes + it.dst_bytes;
+      m_seen += it.src_packets + it.dst_packets;
+   }
+   m_parsed = m_seen;
+   return Result::PARSED;
+}
+
+}
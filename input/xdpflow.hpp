@@ -0,0 +1,158 @@
+/**
+ * \file xdpflow.hpp
+ * \brief Flow records aggregated by XDP program in kernel
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_INPUT_XDPFLOW_HPP
+#define IPXP_INPUT_XDPFLOW_HPP
+
+#include <config.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <ipfixprobe/input.hpp>
+#include <ipfixprobe/flowifc.hpp>
+#include <ipfixprobe/options.hpp>
+#include <ipfixprobe/utils.hpp>
+
+namespace ipxp {
+
+class XdpFlowOptParser : public OptionsParser
+{
+public:
+   std::string m_ifc;
+   uint32_t m_entries;
+   uint32_t m_active;
+   uint32_t m_inactive;
+   uint32_t m_period;
+   bool m_skb;
+   bool m_drop;
+
+   XdpFlowOptParser() : OptionsParser("xdpflow", "Input plugin exporting flows aggregated by XDP program in kernel, process plugins are not called for these flows"),
+      m_ifc(""), m_entries(65536), m_active(300), m_inactive(30), m_period(1), m_skb(false), m_drop(false)
+   {
+      register_option("i", "ifc", "IFC", "Network interface name", [this](const char *arg){m_ifc = arg; return true;}, OptionFlags::RequiredArgument);
+      register_option("e", "entries", "NUM", "Maximal number of flows in kernel map, 40 bytes of counters are allocated per flow and CPU",
+         [this](const char *arg){try {m_entries = str2num<decltype(m_entries)>(arg); if (!m_entries) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("a", "active", "TIME", "Active timeout in seconds",
+         [this](const char *arg){try {m_active = str2num<decltype(m_active)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("I", "inactive", "TIME", "Inactive timeout in seconds",
+         [this](const char *arg){try {m_inactive = str2num<decltype(m_inactive)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("p", "period", "TIME", "Interval of reading expired flows from kernel map in seconds",
+         [this](const char *arg){try {m_period = str2num<decltype(m_period)>(arg); if (!m_period) {return false;}} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("s", "skb", "", "Attach XDP program in generic (skb) mode even if the driver supports native XDP",
+         [this](const char *arg){m_skb = true; return true;}, OptionFlags::NoArgument);
+      register_option("d", "drop", "", "Drop packets after they are counted instead of passing them to kernel network stack",
+         [this](const char *arg){m_drop = true; return true;}, OptionFlags::NoArgument);
+   }
+};
+
+/**
+ * \brief Key of kernel flow map, layout is shared with the XDP program.
+ * Addresses and ports are in network byte order, ICMP type and code are stored as destination port.
+ */
+struct XdpFlowKey {
+   uint8_t ip_version;
+   uint8_t ip_proto;
+   uint16_t src_port;
+   uint16_t dst_port;
+   uint16_t pad;
+   uint8_t src_ip[16];
+   uint8_t dst_ip[16];
+};
+
+/**
+ * \brief Per-CPU value of kernel flow map, layout is shared with the XDP program.
+ */
+struct XdpFlowValue {
+   uint64_t packets;
+   uint64_t bytes;
+   uint64_t first; /**< Monotonic time of the first packet [ns]. */
+   uint64_t last; /**< Monotonic time of the last packet [ns]. */
+   uint64_t tcp_flags;
+};
+
+static_assert(sizeof(XdpFlowKey) == 40, "XDP flow key must not contain padding");
+static_assert(sizeof(XdpFlowValue) == 40, "XDP flow value must not contain padding");
+
+class XdpFlowReader : public InputPlugin
+{
+public:
+   XdpFlowReader();
+   ~XdpFlowReader();
+   void init(const char *params);
+   void close();
+   OptionsParser *get_parser() const { return new XdpFlowOptParser(); }
+   std::string get_name() const { return "xdpflow"; }
+   InputPlugin::Result get(PacketBlock &packets);
+   InputPlugin::Result flush(PacketBlock &packets);
+
+private:
+   int m_flow_map;
+   int m_fail_map;
+   int m_prog;
+   int m_link;
+   unsigned m_cpus;
+
+   uint64_t m_active; /**< Active timeout [ns]. */
+   uint64_t m_inactive; /**< Inactive timeout [ns]. */
+   uint64_t m_period; /**< Interval of reading kernel map [ns]. */
+   uint64_t m_next_scan; /**< Monotonic time of the next reading of kernel map [ns]. */
+   bool m_flushed; /**< All flows were read from kernel map after termination. */
+   bool m_lookup_delete; /**< Kernel supports atomic lookup and delete of per-CPU hash map entries. */
+
+   std::vector<Flow> m_expired; /**< Flows read from kernel map and not passed to storage yet. */
+   size_t m_expired_idx;
+   std::map<const PacketBlock *, std::vector<Flow>> m_blocks; /**< Flows referenced by packet blocks. */
+
+   void load_program(const std::string &ifc, uint32_t entries, bool skb, bool drop);
+   bool take(const XdpFlowKey &key, std::vector<XdpFlowValue> &values);
+   void scan(bool all);
+   void update_stats();
+   InputPlugin::Result fill(PacketBlock &packets);
+};
+
+}
+#endif /* IPXP_INPUT_XDPFLOW_HPP */
@@ -49,6 +49,8 @@
 #include <sstream>
 #include <fstream>
 #include <memory>
+#include <new>
+#include <algorithm>
 #include <thread>
 #include <future>
 #include <signal.h>
@@ -59,6 +61,8 @@
 #include <rte_errno.h>
 #endif
 
+#include <ipfixprobe/clock.hpp>
+
 #include "ipfixprobe.hpp"
 #ifdef WITH_LIBUNWIND
 #include "stacktrace.hpp"
@@ -68,6 +72,7 @@
 namespace ipxp {
 
 volatile sig_atomic_t stop = 0;
+volatile sig_atomic_t reload = 0;
 
 volatile sig_atomic_t terminate_export = 0;
 volatile sig_atomic_t terminate_storage = 0;
@@ -77,6 +82,8 @@ const uint32_t DEFAULT_IQUEUE_SIZE = 64;
 const uint32_t DEFAULT_IQUEUE_BLOCK = 32;
 const uint32_t DEFAULT_OQUEUE_SIZE = 16536;
 const uint32_t DEFAULT_FPS = 0; // unlimited
+const uint32_t RELOAD_WARN_INTERVAL = 1000; // [ms]
+const uint32_t PACKET_HEADERS_SIZE = 256; // part of packet buffer reserved for headers
 
 /**
  * \brief Signal handler function.
@@ -90,6 +97,10 @@ void signal_handler(int sig)
       abort();
    }
 #endif
+   if (sig == SIGHUP) {
+      reload = 1;
+      return;
+   }
    stop = 1;
 }
 
@@ -97,6 +108,7 @@ void register_handlers()
 {
    signal(SIGTERM, signal_handler);
    signal(SIGINT, signal_handler);
+   signal(SIGHUP, signal_handler);
 #ifdef WITH_LIBUNWIND
    signal(SIGSEGV, signal_handler);
 #endif
@@ -162,12 +174,20 @@ void print_help(ipxp_conf_t &conf, const std::string &arg)
 
 void init_packets(ipxp_conf_t &conf)
 {
-   // Reserve +1 more block as a "working block"
-   conf.blocks_cnt = static_cast<size_t>(conf.iqueue_size + 1U) * conf.worker_cnt;
+   // Reserve +1 more block as a "working block", run-to-completion pipelines use the working block only
+   size_t pipeline_blocks = conf.rtc ? 1U : conf.iqueue_size + 1U;
+   conf.blocks_cnt = pipeline_blocks * conf.worker_cnt;
    conf.pkts_cnt = conf.blocks_cnt * conf.iqueue_block;
    conf.pkt_data_cnt = conf.pkts_cnt * conf.pkt_bufsize;
    conf.blocks = new PacketBlock[conf.blocks_cnt];
-   conf.pkts = new Packet[conf.pkts_cnt];
+   void *pkts_mem;
+   if (posix_memalign(&pkts_mem, PACKET_CLINE_SIZE, conf.pkts_cnt * sizeof(Packet))) {
+      throw IPXPError("unable to allocate packet descriptors");
+   }
+   conf.pkts = static_cast<Packet *>(pkts_mem);
+   for (size_t i = 0; i < conf.pkts_cnt; i++) {
+      new (conf.pkts + i) Packet();
+   }
    conf.pkt_data = new uint8_t[conf.pkt_data_cnt];
 
    for (unsigned i = 0; i < conf.blocks_cnt; i++) {
@@ -197,34 +217,35 @@ void process_plugin_argline(const std::string &args, std::string &plugin, std::s
    trim_str(params);
 }
 
-bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
+static void read_process_file(const std::string &file, std::vector<std::string> &args)
 {
-   auto deleter = [&](OutputPlugin::Plugins *p) {
-      for (auto &it : *p) {
-         delete it.second;
+   std::ifstream in(file);
+   std::string line;
+   if (in.fail()) {
+      throw IPXPError("unable to open file " + file);
+   }
+   while (std::getline(in, line)) {
+      trim_str(line);
+      if (line.empty() || line[0] == '#') {
+         continue;
       }
-      delete p;
-   };
-   auto process_plugins = std::unique_ptr<OutputPlugin::Plugins, decltype(deleter)>(new OutputPlugin::Plugins(), deleter);
-   std::string storage_name = "cache";
-   std::string storage_params = "";
-   std::string output_name = "ipfix";
-   std::string output_params = "";
-
-   if (parser.m_storage.size()) {
-      process_plugin_argline(parser.m_storage[0], storage_name, storage_params);
+      args.push_back(line);
    }
-   if (parser.m_output.size()) {
-      process_plugin_argline(parser.m_output[0], output_name, output_params);
+}
+
+bool init_process_plugins(ipxp_conf_t &conf, OutputPlugin::Plugins &plugins)
+{
+   std::vector<std::string> args = conf.process_args;
+   if (!conf.process_file.empty()) {
+      read_process_file(conf.process_file, args);
    }
 
-   // Process
-   for (auto &it : parser.m_process) {
+   for (auto &it : args) {
       ProcessPlugin *process_plugin = nullptr;
       std::string process_params;
       std::string process_name;
       process_plugin_argline(it, process_name, process_params);
-      for (auto &it : *process_plugins) {
+      for (auto &it : plugins) {
          std::string plugin_name = it.first;
          if (plugin_name == process_name) {
             throw IPXPError(process_name + " plugin was specified multiple times");
@@ -240,7 +261,7 @@ bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
          }
 
          process_plugin->init(process_params.c_str());
-         process_plugins->push_back(std::make_pair(process_name, process_plugin));
+         plugins.push_back(std::make_pair(process_name, process_plugin));
       } catch (PluginError &e) {
          delete process_plugin;
          throw IPXPError(process_name + std::string(": ") + e.what());
@@ -251,48 +272,150 @@ bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
          throw IPXPError(process_name + std::string(": ") + e.what());
       }
    }
+   return false;
+}
 
-   // Output
-   ipx_ring_t *output_queue = ipx_ring_init(conf.oqueue_size, 1);
-   if (output_queue == nullptr) {
-      throw IPXPError("unable to initialize ring buffer");
+static uint32_t get_payload_horizon(const OutputPlugin::Plugins &plugins)
+{
+   uint32_t horizon = 0;
+   for (auto &it : plugins) {
+      horizon = std::max(horizon, it.second->get_payload_horizon());
    }
-   OutputPlugin *output_plugin = nullptr;
-   try {
-      output_plugin = dynamic_cast<OutputPlugin *>(conf.mgr.get(output_name));
-      if (output_plugin == nullptr) {
-         ipx_ring_destroy(output_queue);
-         throw IPXPError("invalid output plugin " + output_name);
-      }
-
-      output_plugin->init(output_params.c_str(), *process_plugins);
-      conf.active.output.push_back(output_plugin);
-      conf.active.all.push_back(output_plugin);
-   } catch (PluginError &e) {
-      ipx_ring_destroy(output_queue);
-      delete output_plugin;
-      throw IPXPError(output_name + std::string(": ") + e.what());
-   } catch (PluginExit &e) {
-      ipx_ring_destroy(output_queue);
-      delete output_plugin;
+   return horizon;
+}
+
+static void check_zero_copy(const std::string &input_name, const OutputPlugin::Plugins &plugins)
+{
+   for (auto &it : plugins) {
+      if (it.second->needs_terminated_payload()) {
+         throw IPXPError(input_name + ": zero-copy mode cannot be used together with " + it.first + " plugin");
+      }
+   }
+}
+
+/**
+ * \brief Replace input plugin arguments by arguments of each pipeline the plugins ask for.
+ */
+static void expand_input_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
+{
+   std::vector<std::string> input_args;
+   for (auto &it : parser.m_input) {
+      std::string input_params;
+      std::string input_name;
+      process_plugin_argline(it, input_name, input_params);
+
+      try {
+         std::unique_ptr<InputPlugin> input_plugin(dynamic_cast<InputPlugin *>(conf.mgr.get(input_name)));
+         if (input_plugin == nullptr) {
+            throw IPXPError("invalid input plugin " + input_name);
+         }
+         for (auto &params : input_plugin->expand(input_params.c_str())) {
+            input_args.push_back(input_name + OptionsParser::DELIM + params);
+         }
+      } catch (PluginError &e) {
+         throw IPXPError(input_name + std::string(": ") + e.what());
+      } catch (PluginManagerError &e) {
+         throw IPXPError(input_name + std::string(": ") + e.what());
+      }
+   }
+   parser.m_input = input_args;
+   conf.worker_cnt = parser.m_input.size();
+}
+
+bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
+{
+   auto deleter = [&](OutputPlugin::Plugins *p) {
+      for (auto &it : *p) {
+         delete it.second;
+      }
+      delete p;
+   };
+   auto process_plugins = std::unique_ptr<OutputPlugin::Plugins, decltype(deleter)>(new OutputPlugin::Plugins(), deleter);
+   std::string storage_name = "cache";
+   std::string storage_params = "";
+   std::vector<std::string> output_args = parser.m_output;
+   std::vector<ipx_ring_t *> output_queues;
+
+   expand_input_args(conf, parser);
+   if (parser.m_storage.size()) {
+      process_plugin_argline(parser.m_storage[0], storage_name, storage_params);
+   }
+   if (output_args.empty()) {
+      output_args.push_back("ipfix");
+   }
+   if (output_args.size() > parser.m_input.size()) {
+      throw IPXPError("number of output plugins cannot exceed number of input plugins");
+   }
+
+   // Process
+   if (init_process_plugins(conf, *process_plugins)) {
       return true;
-   } catch (PluginManagerError &e) {
-      throw IPXPError(output_name + std::string(": ") + e.what());
-   }
-
-   {
-      std::promise<WorkerResult> *output_res = new std::promise<WorkerResult>();
-      auto output_stats = new std::atomic<OutputStats>();
-      conf.output_stats.push_back(output_stats);
-      OutputWorker tmp = {
-              output_plugin,
-              new std::thread(output_worker, output_plugin, output_queue, output_res, output_stats, conf.fps),
-              output_res,
-              output_stats,
-              output_queue
-      };
-      conf.outputs.push_back(tmp);
-      conf.output_fut.push_back(output_res->get_future());
+   }
+
+   // Packets are copied only up to the payload horizon of plugins, which can grow when plugins are reloaded from file
+   // Each decapsulated tunnel repeats the header chain in front of the payload
+   uint32_t payload_horizon = conf.process_file.empty() ? get_payload_horizon(*process_plugins) : PAYLOAD_HORIZON_FULL;
+   uint32_t headers_size = PACKET_HEADERS_SIZE * (1 + conf.decap_depth);
+   if (payload_horizon != PAYLOAD_HORIZON_FULL && headers_size + payload_horizon + 1 < conf.pkt_bufsize) {
+      conf.pkt_bufsize = headers_size + payload_horizon + 1;
+   }
+   init_packets(conf);
+
+   // Output
+   size_t output_idx = 0;
+   for (auto &it : output_args) {
+      std::string output_params;
+      std::string output_name;
+      process_plugin_argline(it, output_name, output_params);
+
+      ipx_ring_t *output_queue = ipx_ring_init(conf.oqueue_size, 1);
+      if (output_queue == nullptr) {
+         throw IPXPError("unable to initialize ring buffer");
+      }
+      OutputPlugin *output_plugin = nullptr;
+      try {
+         output_plugin = dynamic_cast<OutputPlugin *>(conf.mgr.get(output_name));
+         if (output_plugin == nullptr) {
+            ipx_ring_destroy(output_queue);
+            throw IPXPError("invalid output plugin " + output_name);
+         }
+
+         output_plugin->init(output_params.c_str(), *process_plugins);
+         conf.active.output.push_back(output_plugin);
+         conf.active.all.push_back(output_plugin);
+      } catch (PluginError &e) {
+         ipx_ring_destroy(output_queue);
+         delete output_plugin;
+         throw IPXPError(output_name + std::string(": ") + e.what());
+      } catch (PluginExit &e) {
+         ipx_ring_destroy(output_queue);
+         delete output_plugin;
+         return true;
+      } catch (PluginManagerError &e) {
+         throw IPXPError(output_name + std::string(": ") + e.what());
+      }
+
+      {
+         // Split export limit among output workers, each of them gets at least 1 flow per second
+         uint32_t output_fps = conf.fps / output_args.size() + (output_idx < conf.fps % output_args.size() ? 1 : 0);
+         if (conf.fps != 0 && output_fps == 0) {
+            output_fps = 1;
+         }
+         std::promise<WorkerResult> *output_res = new std::promise<WorkerResult>();
+         auto output_stats = new std::atomic<OutputStats>();
+         conf.output_stats.push_back(output_stats);
+         OutputWorker tmp = {
+                 output_plugin,
+                 new std::thread(output_worker, output_plugin, output_queue, output_res, output_stats, output_fps),
+                 output_res,
+                 output_stats,
+                 output_queue
+         };
+         conf.outputs.push_back(tmp);
+         conf.output_fut.push_back(output_res->get_future());
+      }
+      output_queues.push_back(output_queue);
+      output_idx++;
    }
 
    // Input
@@ -309,7 +432,12 @@ bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
          if (input_plugin == nullptr) {
             throw IPXPError("invalid input plugin " + input_name);
          }
+         input_plugin->m_queue_blocks = conf.rtc ? 1U : conf.iqueue_size + 1U;
+         input_plugin->m_block_size = conf.iqueue_block;
          input_plugin->init(input_params.c_str());
+         input_plugin->m_payload_horizon = payload_horizon;
+         input_plugin->m_decap_depth = conf.decap_depth;
+         input_plugin->m_fragments.set_size(conf.frag_table_size);
          conf.active.input.push_back(input_plugin);
          conf.active.all.push_back(input_plugin);
       } catch (PluginError &e) {
@@ -321,13 +449,18 @@ bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
       } catch (PluginManagerError &e) {
          throw IPXPError(input_name + std::string(": ") + e.what());
       }
+      if (input_plugin->zero_copy()) {
+         check_zero_copy(input_name, *process_plugins);
+      }
 
       try {
          storage_plugin = dynamic_cast<StoragePlugin *>(conf.mgr.get(storage_name));
          if (storage_plugin == nullptr) {
             throw IPXPError("invalid storage plugin " + storage_name);
          }
-         storage_plugin->set_queue(output_queue);
+         // Flows of each pipeline are exported by one of the output plugins
+         storage_plugin->set_queue(output_queues[pipeline_idx % output_queues.size()]);
+         storage_plugin->set_queue_policy(conf.oqueue_policy);
          storage_plugin->init(storage_params.c_str());
          conf.active.storage.push_back(storage_plugin);
          conf.active.all.push_back(storage_plugin);
@@ -350,6 +483,39 @@ bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
          storage_process_plugins.push_back(tmp);
       }
 
+      PluginsUpdate *plugins_update = new PluginsUpdate(nullptr);
+      auto storage_stats = new std::atomic<StorageStats>();
+      conf.storage_stats.push_back(storage_stats);
+      if (conf.rtc) {
+         std::promise<WorkerResult> *input_res = new std::promise<WorkerResult>();
+         conf.input_fut.push_back(input_res->get_future());
+
+         auto input_stats = new std::atomic<InputStats>();
+         conf.input_stats.push_back(input_stats);
+
+         WorkPipeline tmp = {
+                 {
+                         input_plugin,
+                         new std::thread(rtc_worker, input_plugin, storage_plugin, &conf.blocks[pipeline_idx],
+                                         conf.max_pkts, plugins_update, input_res, input_stats, storage_stats),
+                         input_res,
+                         input_stats
+                 },
+                 {
+                         storage_plugin,
+                         nullptr,
+                         nullptr,
+                         storage_process_plugins,
+                         plugins_update,
+                         storage_stats
+                 },
+                 nullptr
+         };
+         conf.pipelines.push_back(tmp);
+         pipeline_idx++;
+         continue;
+      }
+
       ipx_ring_t *input_queue = ipx_ring_init(conf.iqueue_size, 0);
       if (input_queue == nullptr) {
          throw IPXPError("unable to initialize ring buffer");
@@ -367,15 +533,17 @@ bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
               {
                       input_plugin,
                       new std::thread(input_worker, input_plugin, &conf.blocks[pipeline_idx * (conf.iqueue_size + 1)],
-                                      conf.iqueue_size + 1, conf.max_pkts, input_queue, input_res, input_stats),
+                                      conf.iqueue_size + 1, conf.max_pkts, input_queue, conf.iqueue_policy, input_res, input_stats),
                       input_res,
                       input_stats
               },
               {
                       storage_plugin,
-                      new std::thread(storage_worker, storage_plugin, input_queue, storage_res),
+                      new std::thread(storage_worker, storage_plugin, input_queue, plugins_update, storage_res, storage_stats),
                       storage_res,
-                      storage_process_plugins
+                      storage_process_plugins,
+                      plugins_update,
+                      storage_stats
               },
               input_queue
       };
@@ -386,6 +554,82 @@ bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
    return false;
 }
 
+void reload_process_plugins(ipxp_conf_t &conf)
+{
+   auto deleter = [&](OutputPlugin::Plugins *p) {
+      for (auto &it : *p) {
+         delete it.second;
+      }
+      delete p;
+   };
+   auto process_plugins = std::unique_ptr<OutputPlugin::Plugins, decltype(deleter)>(new OutputPlugin::Plugins(), deleter);
+   if (init_process_plugins(conf, *process_plugins)) {
+      return;
+   }
+   for (auto &it : conf.outputs) {
+      try {
+         it.plugin->check_plugins(*process_plugins);
+      } catch (PluginError &e) {
+         throw IPXPError(e.what());
+      }
+   }
+   for (auto &it : conf.active.input) {
+      if (it->zero_copy()) {
+         check_zero_copy(it->get_name(), *process_plugins);
+      }
+   }
+
+   // Pass new plugins to storage workers, they are swapped between packet blocks
+   std::vector<std::vector<ProcessPlugin *>> updates(conf.pipelines.size());
+   for (size_t i = 0; i < conf.pipelines.size(); i++) {
+      for (auto &it : *process_plugins) {
+         updates[i].push_back(it.second->copy());
+      }
+      conf.pipelines[i].storage.plugins_update->store(&updates[i]);
+   }
+
+   std::string not_switched;
+   for (size_t i = 0; i < conf.pipelines.size(); i++) {
+      WorkPipeline &pipeline = conf.pipelines[i];
+      auto worker_exited = [&]() {
+         std::chrono::seconds now(0);
+         if (conf.rtc) {
+            return conf.input_fut[i].wait_for(now) == std::future_status::ready;
+         }
+         return conf.storage_fut[i].wait_for(now) == std::future_status::ready;
+      };
+      // Worker can be blocked by a full export queue, wait until it takes the plugins or exits
+      for (uint32_t waited = 1; pipeline.storage.plugins_update->load() && !worker_exited() && !stop; waited++) {
+         usleep(1000);
+         if (waited % RELOAD_WARN_INTERVAL == 0) {
+            error("reload of processing plugins is waiting for pipeline " + std::to_string(i));
+         }
+      }
+      if (pipeline.storage.plugins_update->exchange(nullptr) != nullptr) {
+         // Worker is not running anymore, keep old plugins
+         for (auto &it : updates[i]) {
+            delete it;
+         }
+         not_switched += (not_switched.empty() ? "" : ", ") + std::to_string(i);
+         continue;
+      }
+      for (auto &it : pipeline.storage.plugins) {
+         it->close();
+         conf.active.process.erase(std::remove(conf.active.process.begin(), conf.active.process.end(), it), conf.active.process.end());
+         conf.active.all.erase(std::remove(conf.active.all.begin(), conf.active.all.end(), it), conf.active.all.end());
+         delete it;
+      }
+      for (auto &it : updates[i]) {
+         conf.active.process.push_back(it);
+         conf.active.all.push_back(it);
+      }
+      pipeline.storage.plugins = updates[i];
+   }
+   if (!not_switched.empty()) {
+      error("processing plugins were not reloaded in stopped pipelines " + not_switched);
+   }
+}
+
 void finish(ipxp_conf_t &conf)
 {
    bool ok = true;
@@ -394,18 +638,24 @@ void finish(ipxp_conf_t &conf)
    terminate_input = 1;
    for (auto &it : conf.pipelines) {
       it.input.thread->join();
-      it.input.plugin->close();
    }
 
    // Terminate all storages
    terminate_storage = 1;
    for (auto &it : conf.pipelines) {
-      it.storage.thread->join();
+      if (it.storage.thread) {
+         it.storage.thread->join();
+      }
       for (auto &itp : it.storage.plugins) {
          itp->close();
       }
    }
 
+   // Queued packets may point to memory of input plugins until storages are done
+   for (auto &it : conf.pipelines) {
+      it.input.plugin->close();
+   }
+
    // Terminate all outputs
    terminate_export = 1;
    for (auto &it : conf.outputs) {
@@ -423,8 +673,20 @@ void finish(ipxp_conf_t &conf)
       std::setw(16) << "bytes" <<
       std::setw(10) << "dropped" <<
       std::setw(10) << "qtime" <<
+      std::setw(10) << "qdropped" <<
+      std::setw(10) << "malformed" <<
       std::setw(7) << "status" << std::endl;
 
+   std::ostringstream malformed;
+   malformed << "Malformed packets:" << std::endl <<
+      std::setw(3) << "#" <<
+      std::setw(10) << "l2" <<
+      std::setw(10) << "l3" <<
+      std::setw(10) << "l4" <<
+      std::setw(10) << "tcpopt" <<
+      std::setw(10) << "hdrlen" << std::endl;
+   bool malformed_print = false;
+
    int idx = 0;
    for (auto &it : conf.input_fut) {
       WorkerResult res = it.get();
@@ -441,29 +703,56 @@ void finish(ipxp_conf_t &conf)
          std::setw(15) << stats.bytes << " " <<
          std::setw(9) << stats.dropped << " " <<
          std::setw(9) << stats.qtime << " " <<
+         std::setw(9) << stats.qdropped << " " <<
+         std::setw(9) << stats.malformed() << " " <<
          std::setw(6) << status << std::endl;
+      malformed <<
+         std::setw(3) << idx - 1 << " " <<
+         std::setw(9) << stats.malformed_l2 << " " <<
+         std::setw(9) << stats.malformed_l3 << " " <<
+         std::setw(9) << stats.malformed_l4 << " " <<
+         std::setw(9) << stats.malformed_tcp_opt << " " <<
+         std::setw(9) << stats.malformed_hdr_len << std::endl;
+      if (stats.malformed()) {
+         malformed_print = true;
+      }
+   }
+   if (malformed_print) {
+      // Show reasons only when parser dropped malformed packets
+      std::cout << malformed.str();
    }
 
    std::ostringstream oss;
    oss << "Storage stats:" << std::endl <<
       std::setw(3) << "#" <<
+      std::setw(10) << "qtime" <<
+      std::setw(10) << "dropped" <<
       std::setw(7) << "status" << std::endl;
 
    idx = 0;
-   bool storage_ok = true;
-   for (auto &it : conf.storage_fut) {
-      WorkerResult res = it.get();
+   bool storage_print = false;
+   for (auto &it : conf.storage_stats) {
       std::string status = "ok";
-      if (res.error) {
-         ok = false;
-         storage_ok = false;
-         status = res.msg;
+      if (static_cast<size_t>(idx) < conf.storage_fut.size()) {
+         WorkerResult res = conf.storage_fut[idx].get();
+         if (res.error) {
+            ok = false;
+            storage_print = true;
+            status = res.msg;
+         }
+      }
+      StorageStats stats = it->load();
+      if (stats.qtime || stats.dropped) {
+         // Show storage stats when export queue was overloaded
+         storage_print = true;
       }
       oss <<
          std::setw(3) << idx++ << " " <<
+         std::setw(9) << stats.qtime << " " <<
+         std::setw(9) << stats.dropped << " " <<
          std::setw(6) << status << std::endl;
    }
-   if (!storage_ok) {
+   if (storage_print) {
       std::cout << oss.str();
    }
 
@@ -529,11 +818,17 @@ void serve_stat_clients(ipxp_conf_t &conf, struct pollfd pfds[2])
             *(OutputStats *)(buffer + written) = stats;
             written += sizeof(OutputStats);
          }
+         for (auto &it : conf.storage_stats) {
+            StorageStats stats = it->load();
+            *(StorageStats *)(buffer + written) = stats;
+            written += sizeof(StorageStats);
+         }
 
          hdr->magic = MSG_MAGIC;
          hdr->size = written - sizeof(msg_header_t);
          hdr->inputs = conf.input_stats.size();
          hdr->outputs = conf.output_stats.size();
+         hdr->storages = conf.storage_stats.size();
 
          send_data(pfds[1].fd, written, buffer);
       }
@@ -571,6 +866,15 @@ void main_loop(ipxp_conf_t &conf)
    while (!stop && futs.size()) {
       serve_stat_clients(conf, pfds);
 
+      if (reload) {
+         reload = 0;
+         try {
+            reload_process_plugins(conf);
+         } catch (IPXPError &e) {
+            error(std::string("reload of processing plugins failed: ") + e.what());
+         }
+      }
+
       for (auto it = futs.begin(); it != futs.end(); it++) {
          std::future_status status = (*it)->wait_for(std::chrono::seconds(0));
          if (status == std::future_status::ready) {
@@ -648,8 +952,8 @@ int run(int argc, char *argv[])
       std::cout << PACKAGE_VERSION << std::endl;
       goto EXIT;
    }
-   if (parser.m_storage.size() > 1 || parser.m_output.size() > 1) {
-      error("only one storage and output plugin can be specified");
+   if (parser.m_storage.size() > 1) {
+      error("only one storage plugin can be specified");
       status = EXIT_FAILURE;
       goto EXIT;
    }
@@ -688,16 +992,22 @@ int run(int argc, char *argv[])
       goto EXIT;
    }
 
-   conf.worker_cnt = parser.m_input.size();
    conf.iqueue_block = parser.m_iqueue_block;
    conf.iqueue_size = parser.m_iqueue;
    conf.oqueue_size = parser.m_oqueue;
+   conf.iqueue_policy = parser.m_iqueue_policy;
+   conf.oqueue_policy = parser.m_oqueue_policy;
    conf.fps = parser.m_fps;
    conf.pkt_bufsize = parser.m_pkt_bufsize;
    conf.max_pkts = parser.m_max_pkts;
+   conf.decap_depth = parser.m_decap_depth;
+   conf.frag_table_size = parser.m_frag_table_size;
+   conf.rtc = parser.m_rtc;
+   conf.process_args = parser.m_process;
+   conf.process_file = parser.m_process_file;
 
+   clock_start();
    try {
-      init_packets(conf);
       if (process_plugin_args(conf, parser)) {
          goto EXIT;
       }
@@ -717,6 +1027,7 @@ int run(int argc, char *argv[])
    }
 
 EXIT:
+   clock_stop();
 #ifdef WITH_DPDK
     rte_eal_cleanup();
 #endif
@@ -83,7 +83,9 @@ void register_handlers();
 void error(std::string msg);
 void print_help(ipxp_conf_t &conf, const std::string &arg);
 void init_packets(ipxp_conf_t &conf);
+bool init_process_plugins(ipxp_conf_t &conf, OutputPlugin::Plugins &plugins);
 bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser);
+void reload_process_plugins(ipxp_conf_t &conf);
 void main_loop(ipxp_conf_t &conf);
 int run(int argc, char *argv[]);
 
@@ -93,22 +95,30 @@ public:
    std::vector<std::string> m_storage;
    std::vector<std::string> m_output;
    std::vector<std::string> m_process;
+   std::string m_process_file;
    std::string m_pid;
    bool m_daemon;
    uint32_t m_iqueue;
    uint32_t m_iqueue_block;
    uint32_t m_oqueue;
+   QueuePolicy m_iqueue_policy;
+   QueuePolicy m_oqueue_policy;
    uint32_t m_fps;
    uint32_t m_pkt_bufsize;
    uint32_t m_max_pkts;
+   uint8_t m_decap_depth;
+   uint32_t m_frag_table_size;
+   bool m_rtc;
    bool m_help;
    std::string m_help_str;
    bool m_version;
 
    IpfixprobeOptParser() : OptionsParser("ipfixprobe", "flow exporter supporting various custom IPFIX elements"),
-                           m_pid(""), m_daemon(false),
-                           m_iqueue(DEFAULT_IQUEUE_SIZE), m_iqueue_block(DEFAULT_IQUEUE_BLOCK), m_oqueue(DEFAULT_OQUEUE_SIZE), m_fps(DEFAULT_FPS),
-                           m_pkt_bufsize(1600), m_max_pkts(0), m_help(false), m_help_str(""), m_version(false)
+                           m_process_file(""), m_pid(""), m_daemon(false),
+                           m_iqueue(DEFAULT_IQUEUE_SIZE), m_iqueue_block(DEFAULT_IQUEUE_BLOCK), m_oqueue(DEFAULT_OQUEUE_SIZE),
+                           m_iqueue_policy(QueuePolicy::BLOCK), m_oqueue_policy(QueuePolicy::BLOCK), m_fps(DEFAULT_FPS),
+                           m_pkt_bufsize(1600), m_max_pkts(0), m_decap_depth(0),
+                           m_frag_table_size(FRAG_TABLE_DEFAULT_SIZE), m_rtc(false), m_help(false), m_help_str(""), m_version(false)
    {
       m_delim = ' ';
 
@@ -132,6 +142,11 @@ public:
                           m_process.push_back(arg);
                           return true;
                       }, OptionFlags::RequiredArgument);
+      register_option("-R", "--reload", "FILE", "Read processing plugins from file, one per line. The file is read again on SIGHUP and running plugins are replaced",
+                      [this](const char *arg) {
+                          m_process_file = arg;
+                          return m_process_file != "";
+                      }, OptionFlags::RequiredArgument);
       register_option("-q", "--iqueue", "SIZE", "Size of queue between input and storage plugins",
                       [this](const char *arg) {
                           try { m_iqueue = str2num<decltype(m_iqueue)>(arg); } catch (
@@ -150,13 +165,21 @@ public:
                                   std::invalid_argument &e) { return false; }
                           return true;
                       }, OptionFlags::RequiredArgument);
+      register_option("-l", "--ipolicy", "POLICY", "Policy when queue between input and storage plugins is full: block (default) or drop, packets of dropped blocks are counted in qdropped",
+                      [this](const char *arg) {
+                          return parse_queue_policy(arg, m_iqueue_policy);
+                      }, OptionFlags::RequiredArgument);
+      register_option("-L", "--opolicy", "POLICY", "Policy when queue between storage and output plugins is full: block (default) or drop",
+                      [this](const char *arg) {
+                          return parse_queue_policy(arg, m_oqueue_policy);
+                      }, OptionFlags::RequiredArgument);
       register_option("-B", "--pbuf", "SIZE", "Size of packet buffer",
                       [this](const char *arg) {
                           try { m_pkt_bufsize = str2num<decltype(m_pkt_bufsize)>(arg); } catch (std::invalid_argument &e) { return false; }
                           return true;
                       },
                       OptionFlags::RequiredArgument);
-      register_option("-f", "--fps", "NUM", "Export max flows per second",
+      register_option("-f", "--fps", "NUM", "Export max flows per second, the limit is split among output plugins",
                       [this](const char *arg) {
                           try { m_fps = str2num<decltype(m_fps)>(arg); } catch (std::invalid_argument &e) { return false; }
                           return true;
@@ -168,6 +191,23 @@ public:
                                   std::invalid_argument &e) { return false; }
                           return true;
                       }, OptionFlags::RequiredArgument);
+      register_option("-t", "--decap", "DEPTH", "Number of tunnel headers (GRE, IP-in-IP, VXLAN, GENEVE, GTP-U) to decapsulate, flows are created from inner headers",
+                      [this](const char *arg) {
+                          try { m_decap_depth = str2num<decltype(m_decap_depth)>(arg); } catch (
+                                  std::invalid_argument &e) { return false; }
+                          return true;
+                      }, OptionFlags::RequiredArgument);
+      register_option("-F", "--frags", "SIZE", "Number of fragmented IP packets tracked by each input plugin to assign ports to fragments, 0 disables tracking, at most " + std::to_string(FRAG_TABLE_MAX_SIZE),
+                      [this](const char *arg) {
+                          try { m_frag_table_size = str2num<decltype(m_frag_table_size)>(arg); } catch (
+                                  std::invalid_argument &e) { return false; }
+                          return m_frag_table_size <= FRAG_TABLE_MAX_SIZE;
+                      }, OptionFlags::RequiredArgument);
+      register_option("-r", "--rtc", "", "Run input and storage plugins in a single thread without input queue",
+                      [this](const char *arg) {
+                          m_rtc = true;
+                          return true;
+                      }, OptionFlags::NoArgument);
       register_option("-P", "--pid", "FILE", "Create pid file", [this](const char *arg) {
           m_pid = arg;
           return m_pid != "";
@@ -186,15 +226,35 @@ public:
           return true;
       }, OptionFlags::NoArgument);
    }
+
+private:
+   static bool parse_queue_policy(const std::string &arg, QueuePolicy &policy)
+   {
+      if (arg == "block") {
+         policy = QueuePolicy::BLOCK;
+      } else if (arg == "drop") {
+         policy = QueuePolicy::DROP;
+      } else {
+         return false;
+      }
+      return true;
+   }
 };
 
 struct ipxp_conf_t {
    uint32_t iqueue_size;
    uint32_t iqueue_block;
    uint32_t oqueue_size;
+   QueuePolicy iqueue_policy;
+   QueuePolicy oqueue_policy;
    uint32_t worker_cnt;
    uint32_t fps;
    uint32_t max_pkts;
+   uint8_t decap_depth;
+   uint32_t frag_table_size;
+   bool rtc;
+   std::vector<std::string> process_args;
+   std::string process_file;
 
    PluginManager mgr;
    struct Plugins {
@@ -209,6 +269,7 @@ struct ipxp_conf_t {
    std::vector<OutputWorker> outputs;
 
    std::vector<std::atomic<InputStats> *> input_stats;
+   std::vector<std::atomic<StorageStats> *> storage_stats;
    std::vector<std::atomic<OutputStats> *> output_stats;
 
    std::vector<std::shared_future<WorkerResult>> input_fut;
@@ -225,8 +286,8 @@ struct ipxp_conf_t {
    uint8_t *pkt_data;
 
    ipxp_conf_t() : iqueue_size(DEFAULT_IQUEUE_SIZE), iqueue_block(DEFAULT_IQUEUE_BLOCK),
-                   oqueue_size(DEFAULT_OQUEUE_SIZE),
-                   worker_cnt(0), fps(0), max_pkts(0),
+                   oqueue_size(DEFAULT_OQUEUE_SIZE), iqueue_policy(QueuePolicy::BLOCK), oqueue_policy(QueuePolicy::BLOCK),
+                   worker_cnt(0), fps(0), max_pkts(0), decap_depth(0), frag_table_size(FRAG_TABLE_DEFAULT_SIZE), rtc(false),
                    pkt_bufsize(1600), blocks_cnt(0), pkts_cnt(0), pkt_data_cnt(0), blocks(nullptr), pkts(nullptr), pkt_data(nullptr)
    {
    }
@@ -245,13 +306,16 @@ struct ipxp_conf_t {
 
       terminate_storage = 1;
       for (auto &it : pipelines) {
-         if (it.storage.thread->joinable()) {
+         if (it.storage.thread && it.storage.thread->joinable()) {
             it.storage.thread->join();
          }
          delete it.storage.plugin;
          delete it.storage.thread;
          delete it.storage.promise;
-         ipx_ring_destroy(it.queue);
+         delete it.storage.plugins_update;
+         if (it.queue) {
+            ipx_ring_destroy(it.queue);
+         }
       }
 
       for (auto &it : pipelines) {
@@ -274,11 +338,14 @@ struct ipxp_conf_t {
       for (auto &it : input_stats) {
          delete it;
       }
+      for (auto &it : storage_stats) {
+         delete it;
+      }
       for (auto &it : output_stats) {
          delete it;
       }
 
-      delete[] pkts;
+      free(pkts);
       delete[] blocks;
       delete[] pkt_data;
    }
@@ -166,7 +166,9 @@ int main(int argc, char *argv[])
          std::setw(10) << "parsed" <<
          std::setw(16) << "bytes" <<
          std::setw(10) << "dropped" <<
-         std::setw(10) << "qtime" << std::endl;
+         std::setw(10) << "qtime" <<
+         std::setw(10) << "qdropped" <<
+         std::setw(10) << "malformed" << std::endl;
 
       uint8_t *data = buffer + sizeof(msg_header_t);
       size_t idx = 0;
@@ -179,7 +181,9 @@ int main(int argc, char *argv[])
             std::setw(9) << stats->parsed << " " <<
             std::setw(15) << stats->bytes << " " <<
             std::setw(9) << stats->dropped << " " <<
-            std::setw(9) << stats->qtime << " " << std::endl;
+            std::setw(9) << stats->qtime << " " <<
+            std::setw(9) << stats->qdropped << " " <<
+            std::setw(9) << stats->malformed() << " " << std::endl;
       }
 
       std::cout << "Output stats:" << std::endl <<
@@ -201,11 +205,26 @@ int main(int argc, char *argv[])
             std::setw(9) << stats->dropped << " " << std::endl;
       }
 
+      std::cout << "Storage stats:" << std::endl <<
+         std::setw(3) << "#" <<
+         std::setw(10) << "qtime" <<
+         std::setw(10) << "dropped" << std::endl;
+
+      idx = 0;
+      for (size_t i = 0; i < hdr->storages; i++) {
+         StorageStats *stats = (StorageStats *) data;
+         data += sizeof(StorageStats);
+         std::cout <<
+            std::setw(3) << idx++ << " " <<
+            std::setw(9) << stats->qtime << " " <<
+            std::setw(9) << stats->dropped << " " << std::endl;
+      }
+
       if (parser.m_one) {
          break;
       }
 
-      lines_written = hdr->inputs + hdr->outputs + 4;
+      lines_written = hdr->inputs + hdr->outputs + hdr->storages + 6;
       usleep(1000000);
    }
 EXIT:
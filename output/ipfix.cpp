@@ -207,6 +207,11 @@ void IPFIXExporter::init(const char *params, Plugins &plugins)
    for (int i = 0; i < extension_cnt; i++) {
       extensions[i] = nullptr;
    }
+   check_plugins(plugins);
+}
+
+void IPFIXExporter::check_plugins(Plugins &plugins)
+{
    for (auto &it : plugins) {
       std::string name = it.first;
       ProcessPlugin *plugin = it.second;
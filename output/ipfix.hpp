@@ -231,6 +231,7 @@ public:
    ~IPFIXExporter();
    void init(const char *params);
    void init(const char *params, Plugins &plugins);
+   void check_plugins(Plugins &plugins);
    void close();
    OptionsParser *get_parser() const { return new IpfixOptParser(); }
    std::string get_name() const { return "ipfix"; }
@@ -133,12 +133,12 @@ void TextExporter::print_basic_flow(const Flow &flow)
    std::string lb = "";
    std::string rb = "";
 
-   sec = flow.time_first.tv_sec;
+   sec = ts_sec(flow.time_first);
    strftime(tmp, sizeof(tmp), "%FT%T", localtime(&sec));
-   snprintf(time_begin, sizeof(time_begin), "%s.%06ld", tmp, flow.time_first.tv_usec);
-   sec = flow.time_last.tv_sec;
+   snprintf(time_begin, sizeof(time_begin), "%s.%09u", tmp, ts_nsec(flow.time_first));
+   sec = ts_sec(flow.time_last);
    strftime(tmp, sizeof(tmp), "%FT%T", localtime(&sec));
-   snprintf(time_end, sizeof(time_end), "%s.%06ld", tmp, flow.time_last.tv_usec);
+   snprintf(time_end, sizeof(time_end), "%s.%09u", tmp, ts_nsec(flow.time_last));
 
    const uint8_t *p = const_cast<uint8_t *>(flow.src_mac);
    snprintf(src_mac, sizeof(src_mac), "%02x:%02x:%02x:%02x:%02x:%02x", p[0], p[1], p[2], p[3], p[4], p[5]);
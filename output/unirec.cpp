@@ -302,6 +302,12 @@ void UnirecExporter::init(const char *params, Plugins &plugins)
    m_group_map.clear();
 }
 
+void UnirecExporter::check_plugins(Plugins &plugins)
+{
+   // Mapping of plugins to output interfaces is fixed by the interface specifier
+   throw PluginError("changing processing plugins at runtime is not supported");
+}
+
 void UnirecExporter::close()
 {
    if (m_eof) {
@@ -420,10 +426,10 @@ void UnirecExporter::fill_basic_flow(const Flow &flow, ur_template_t *tmplt_ptr,
       ur_set(tmplt_ptr, record_ptr, F_DST_IP, ip_from_16_bytes_be((char *) flow.dst_ip.v6));
    }
 
-   tmp_time = ur_time_from_sec_usec(flow.time_first.tv_sec, flow.time_first.tv_usec);
+   tmp_time = ur_time_from_sec_usec(ts_sec(flow.time_first), ts_usec(flow.time_first));
    ur_set(tmplt_ptr, record_ptr, F_TIME_FIRST, tmp_time);
 
-   tmp_time = ur_time_from_sec_usec(flow.time_last.tv_sec, flow.time_last.tv_usec);
+   tmp_time = ur_time_from_sec_usec(ts_sec(flow.time_last), ts_usec(flow.time_last));
    ur_set(tmplt_ptr, record_ptr, F_TIME_LAST, tmp_time);
 
    if (m_odid) {
@@ -183,6 +183,7 @@ public:
    ~UnirecExporter();
    void init(const char *params);
    void init(const char *params, Plugins &plugins);
+   void check_plugins(Plugins &plugins);
    void close();
    OptionsParser *get_parser() const { return new UnirecOptParser(); }
    std::string get_name() const { return "unirec"; }
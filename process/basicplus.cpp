@@ -99,6 +99,10 @@ int BASICPLUSPlugin::post_create(Flow &rec, const Packet &pkt)
 int BASICPLUSPlugin::pre_update(Flow &rec, Packet &pkt)
 {
    RecordExtBASICPLUS *p = (RecordExtBASICPLUS *) rec.get_extension(RecordExtBASICPLUS::REGISTERED_ID);
+   if (p == nullptr) {
+      // Flow was created before the plugin was loaded
+      return 0;
+   }
    uint8_t dir = pkt.source_pkt ? 0 : 1;
 
    if (p->ip_ttl[dir] < pkt.ip_ttl) {
@@ -186,6 +186,7 @@ public:
    OptionsParser *get_parser() const { return new OptionsParser("basicplus", "Extend basic fields with TTL, TCP window, options, MSS and SYN size"); }
    std::string get_name() const { return "basicplus"; }
    RecordExt *get_ext() const { return new RecordExtBASICPLUS(); }
+   uint32_t get_payload_horizon() const { return 0; }
    ProcessPlugin *copy();
 
    int post_create(Flow &rec, const Packet &pkt);
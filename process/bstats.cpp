@@ -56,8 +56,7 @@ __attribute__((constructor)) static void register_this_plugin()
    RecordExtBSTATS::REGISTERED_ID = register_extension();
 }
 
-const struct timeval BSTATSPlugin::min_packet_in_burst =
-{MAXIMAL_INTERPKT_TIME / 1000, (MAXIMAL_INTERPKT_TIME % 1000) * 1000};
+const int64_t BSTATSPlugin::min_packet_in_burst = MAXIMAL_INTERPKT_TIME * 1000000LL;
 
 
 BSTATSPlugin::BSTATSPlugin()
@@ -98,10 +97,9 @@ void BSTATSPlugin::initialize_new_burst(RecordExtBSTATS *bstats_record, uint8_t
 
 bool BSTATSPlugin::belogsToLastRecord(RecordExtBSTATS *bstats_record, uint8_t direction, const Packet &pkt)
 {
-   struct timeval timediff;
+   int64_t timediff = static_cast<int64_t>(pkt.ts - bstats_record->brst_end[direction][bstats_record->BCOUNT]);
 
-   timersub(&pkt.ts, &bstats_record->brst_end[direction][bstats_record->BCOUNT], &timediff);
-   if (timercmp(&timediff, &min_packet_in_burst, <)){
+   if (timediff < min_packet_in_burst){
       return true;
    }
    return false;
@@ -160,6 +158,10 @@ int BSTATSPlugin::post_create(Flow &rec, const Packet &pkt)
 int BSTATSPlugin::pre_update(Flow &rec, Packet &pkt)
 {
    RecordExtBSTATS *bstats_record = static_cast<RecordExtBSTATS *>(rec.get_extension(RecordExtBSTATS::REGISTERED_ID));
+   if (bstats_record == nullptr) {
+      // Flow was created before the plugin was loaded
+      return 0;
+   }
 
    update_record(bstats_record, pkt);
    return 0;
@@ -173,6 +175,9 @@ int BSTATSPlugin::post_update(Flow &rec, const Packet &pkt)
 void BSTATSPlugin::pre_export(Flow &rec)
 {
    RecordExtBSTATS *bstats_record = static_cast<RecordExtBSTATS *>(rec.get_extension(RecordExtBSTATS::REGISTERED_ID));
+   if (bstats_record == nullptr) {
+      return;
+   }
 
    for (int direction = 0; direction < 2; direction++){
       if (bstats_record->BCOUNT < BSTATS_MAXELENCOUNT && isLastRecordBurst(bstats_record, direction)){
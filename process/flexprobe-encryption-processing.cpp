@@ -75,8 +75,12 @@ int FlexprobeEncryptionProcessing::post_update(Flow& rec, const Packet& pkt)
     auto data_view = reinterpret_cast<const Flexprobe::FlexprobeData*>(pkt.custom);
 
     auto arrival = data_view->arrival_time.to_decimal();
-    Flexprobe::Timestamp::DecimalTimestamp flow_end = static_cast<Flexprobe::Timestamp::DecimalTimestamp>(rec.time_last.tv_sec) + static_cast<Flexprobe::Timestamp::DecimalTimestamp>(rec.time_last.tv_usec) * 1e-6f;
+    Flexprobe::Timestamp::DecimalTimestamp flow_end = static_cast<Flexprobe::Timestamp::DecimalTimestamp>(ts_sec(rec.time_last)) + static_cast<Flexprobe::Timestamp::DecimalTimestamp>(ts_nsec(rec.time_last)) * 1e-9;
     auto encr_data = dynamic_cast<FlexprobeEncryptionData*>(rec.get_extension(FlexprobeEncryptionData::REGISTERED_ID));
+    if (!encr_data) {
+        // flow was created before the plugin was loaded
+        return 0;
+    }
     auto total_packets = rec.src_packets + rec.dst_packets;
 
     encr_data->time_interpacket.update(arrival - flow_end, total_packets);
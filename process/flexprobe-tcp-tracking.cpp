@@ -130,6 +130,10 @@ namespace ipxp
         auto data_view = reinterpret_cast<const Flexprobe::FlexprobeData *>(pkt.custom);
 
         auto tcp_data = dynamic_cast<TcpTrackingData *>(rec.get_extension(TcpTrackingData::REGISTERED_ID));
+        if (!tcp_data) {
+            // flow was created before the plugin was loaded
+            return 0;
+        }
         auto next_tcp = pkt.tcp_seq;
         auto direction = pkt.source_pkt ? 0 : 1;
 
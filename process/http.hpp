@@ -212,6 +212,7 @@ public:
    void init(const char *params);
    void close();
    RecordExt *get_ext() const { return new RecordExtHTTP(); }
+   bool needs_terminated_payload() const { return true; }
    OptionsParser *get_parser() const { return new OptionsParser("http", "Parse HTTP traffic"); }
    std::string get_name() const { return "http"; }
    ProcessPlugin *copy();
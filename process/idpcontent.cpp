@@ -107,6 +107,10 @@ int IDPCONTENTPlugin::post_create(Flow &rec, const Packet &pkt)
 int IDPCONTENTPlugin::post_update(Flow &rec, const Packet &pkt)
 {
    RecordExtIDPCONTENT *idpcontent_data = static_cast<RecordExtIDPCONTENT *>(rec.get_extension(RecordExtIDPCONTENT::REGISTERED_ID));
+   if (idpcontent_data == nullptr) {
+      // Flow was created before the plugin was loaded
+      return 0;
+   }
    update_record(idpcontent_data, pkt);
    return 0;
 }
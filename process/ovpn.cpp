@@ -197,6 +197,10 @@ int OVPNPlugin::post_create(Flow &rec, const Packet &pkt)
 int OVPNPlugin::pre_update(Flow &rec, Packet &pkt)
 {
    RecordExtOVPN *vpn_data = (RecordExtOVPN *) rec.get_extension(RecordExtOVPN::REGISTERED_ID);
+   if (vpn_data == nullptr) {
+      // Flow was created before the plugin was loaded
+      return 0;
+   }
    update_record(vpn_data, pkt);
    return 0;
 }
@@ -204,6 +208,9 @@ int OVPNPlugin::pre_update(Flow &rec, Packet &pkt)
 void OVPNPlugin::pre_export(Flow &rec)
 {
    RecordExtOVPN *vpn_data = (RecordExtOVPN *) rec.get_extension(RecordExtOVPN::REGISTERED_ID);
+   if (vpn_data == nullptr) {
+      return;
+   }
    if (vpn_data->pkt_cnt > min_pckt_treshold && vpn_data->status == status_data) {
       vpn_data->possible_vpn = 100;
    } else if (vpn_data->pkt_cnt > min_pckt_treshold && ((double) vpn_data->data_pkt_cnt / (double) vpn_data->pkt_cnt) >= data_pckt_treshold) {
@@ -127,9 +127,9 @@ void PHISTSPlugin::update_hist(RecordExtPHISTS *phists_data, uint32_t value, uin
    return;
 }
 
-uint64_t PHISTSPlugin::calculate_ipt(RecordExtPHISTS *phists_data, const struct timeval tv, uint8_t direction)
+uint64_t PHISTSPlugin::calculate_ipt(RecordExtPHISTS *phists_data, const timestamp_t tv, uint8_t direction)
 {
-   int64_t ts = IpfixBasicList::Tv2Ts(tv);
+   int64_t ts = ts_to_msec(tv);
 
    if (phists_data->last_ts[direction] == 0) {
       phists_data->last_ts[direction] = ts;
@@ -180,6 +180,10 @@ int PHISTSPlugin::post_create(Flow &rec, const Packet &pkt)
 int PHISTSPlugin::post_update(Flow &rec, const Packet &pkt)
 {
    RecordExtPHISTS *phists_data = (RecordExtPHISTS *) rec.get_extension(RecordExtPHISTS::REGISTERED_ID);
+   if (phists_data == nullptr) {
+      // Flow was created before the plugin was loaded
+      return 0;
+   }
 
    update_record(phists_data, pkt);
    return 0;
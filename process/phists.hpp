@@ -206,6 +206,7 @@ public:
    OptionsParser *get_parser() const { return new PHISTSOptParser(); }
    std::string get_name() const { return "phists"; }
    RecordExt *get_ext() const { return new RecordExtPHISTS(); }
+   uint32_t get_payload_horizon() const { return 0; }
    ProcessPlugin *copy();
 
    int post_create(Flow &rec, const Packet &pkt);
@@ -217,7 +218,7 @@ private:
    void update_record(RecordExtPHISTS *phists_data, const Packet &pkt);
    void update_hist(RecordExtPHISTS *phists_data, uint32_t value, uint32_t *histogram);
    void pre_export(Flow &rec);
-   uint64_t calculate_ipt(RecordExtPHISTS *phists_data, const struct timeval tv, uint8_t direction);
+   uint64_t calculate_ipt(RecordExtPHISTS *phists_data, const timestamp_t tv, uint8_t direction);
 
    static const uint32_t log2_lookup32[32];
 
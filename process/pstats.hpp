@@ -48,6 +48,7 @@
 #include <string>
 #include <cstring>
 #include <sstream>
+#include <iomanip>
 
 #ifdef WITH_NEMEA
 # include "fields.h"
@@ -102,7 +103,7 @@ struct RecordExtPSTATS : public RecordExt {
 
    uint16_t       pkt_sizes[PSTATS_MAXELEMCOUNT];
    uint8_t        pkt_tcp_flgs[PSTATS_MAXELEMCOUNT];
-   struct timeval pkt_timestamps[PSTATS_MAXELEMCOUNT];
+   timestamp_t    pkt_timestamps[PSTATS_MAXELEMCOUNT];
    int8_t         pkt_dirs[PSTATS_MAXELEMCOUNT];
    uint16_t       pkt_count;
    uint32_t       tcp_seq[2];
@@ -134,7 +135,7 @@ struct RecordExtPSTATS : public RecordExt {
       ur_array_allocate(tmplt, record, F_PPI_PKT_DIRECTIONS, pkt_count);
 
       for (int i = 0; i < pkt_count; i++) {
-         ur_time_t ts = ur_time_from_sec_usec(pkt_timestamps[i].tv_sec, pkt_timestamps[i].tv_usec);
+         ur_time_t ts = ur_time_from_sec_usec(ts_sec(pkt_timestamps[i]), ts_usec(pkt_timestamps[i]));
          ur_array_set(tmplt, record, F_PPI_PKT_TIMES, i, ts);
          ur_array_set(tmplt, record, F_PPI_PKT_LENGTHS, i, pkt_sizes[i]);
          ur_array_set(tmplt, record, F_PPI_PKT_FLAGS, i, pkt_tcp_flgs[i]);
@@ -166,7 +167,7 @@ struct RecordExtPSTATS : public RecordExt {
       // Fill packet sizes
       bufferPtr = basiclist.FillBuffer(buffer, pkt_sizes, pkt_count, (uint16_t) PktSize);
       // Fill timestamps
-      bufferPtr += basiclist.FillBuffer(buffer + bufferPtr, pkt_timestamps, pkt_count,(uint16_t) PktTmstp);
+      bufferPtr += basiclist.FillBufferTs(buffer + bufferPtr, pkt_timestamps, pkt_count,(uint16_t) PktTmstp);
       // Fill tcp flags
       bufferPtr += basiclist.FillBuffer(buffer + bufferPtr, pkt_tcp_flgs, pkt_count, (uint16_t) PktFlags);
       // Fill directions
@@ -195,7 +196,7 @@ struct RecordExtPSTATS : public RecordExt {
       }
       out << "),ppitimes=(";
       for (int i = 0; i < pkt_count; i++) {
-         out << pkt_timestamps[i].tv_sec << "." << pkt_timestamps[i].tv_usec;
+         out << ts_sec(pkt_timestamps[i]) << "." << std::setfill('0') << std::setw(9) << ts_nsec(pkt_timestamps[i]);
          if (i != pkt_count - 1) {
             out << ",";
          }
@@ -232,6 +233,7 @@ public:
    OptionsParser *get_parser() const { return new PSTATSOptParser(); }
    std::string get_name() const { return "pstats"; }
    RecordExt *get_ext() const { return new RecordExtPSTATS(); }
+   uint32_t get_payload_horizon() const { return 0; }
    ProcessPlugin *copy();
    int post_create(Flow &rec, const Packet &pkt);
    int post_update(Flow &rec, const Packet &pkt);
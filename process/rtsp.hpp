@@ -215,6 +215,7 @@ public:
    OptionsParser *get_parser() const { return new OptionsParser("rtsp", "Parse RTSP traffic"); }
    std::string get_name() const { return "rtsp"; }
    RecordExt *get_ext() const { return new RecordExtRTSP(); }
+   bool needs_terminated_payload() const { return true; }
    ProcessPlugin *copy();
 
    int post_create(Flow &rec, const Packet &pkt);
@@ -254,6 +254,7 @@ public:
    OptionsParser *get_parser() const { return new OptionsParser("smtp", "Parse SMTP traffic"); }
    std::string get_name() const { return "smtp"; }
    RecordExt *get_ext() const { return new RecordExtSMTP(); }
+   bool needs_terminated_payload() const { return true; }
    ProcessPlugin *copy();
 
    int post_create(Flow &rec, const Packet &pkt);
@@ -118,7 +118,8 @@ int SSDPPlugin::post_create(Flow &rec, const Packet &pkt)
 
 int SSDPPlugin::pre_update(Flow &rec, Packet &pkt)
 {
-   if (pkt.dst_port == 1900) {
+   // Skip flows created before the plugin was loaded
+   if (pkt.dst_port == 1900 && rec.get_extension(RecordExtSSDP::REGISTERED_ID) != nullptr) {
       parse_ssdp_message(rec, pkt);
    }
    return 0;
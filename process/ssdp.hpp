@@ -194,6 +194,7 @@ public:
    OptionsParser *get_parser() const { return new OptionsParser("ssdp", "Parse SSDP traffic"); }
    std::string get_name() const { return "ssdp"; }
    RecordExt *get_ext() const { return new RecordExtSSDP(); }
+   bool needs_terminated_payload() const { return true; }
    ProcessPlugin *copy();
 
    int post_create(Flow &rec, const Packet &pkt);
@@ -59,7 +59,7 @@ __attribute__((constructor)) static void register_this_plugin()
 
 StatsPlugin::StatsPlugin() :
    m_packets(0), m_new_flows(0), m_cache_hits(0), m_flows_in_cache(0), m_init_ts(true),
-   m_interval({STATS_PRINT_INTERVAL, 0}), m_last_ts({0}), m_out(&std::cout)
+   m_interval(STATS_PRINT_INTERVAL * NANO_SEC), m_last_ts(0), m_out(&std::cout)
 {
 }
 
@@ -77,7 +77,7 @@ void StatsPlugin::init(const char *params)
       throw PluginError(e.what());
    }
 
-   m_interval = {parser.m_interval, 0};
+   m_interval = parser.m_interval * NANO_SEC;
    if (parser.m_out == "stdout") {
       m_out = &std::cout;
    } else if (parser.m_out == "stderr") {
@@ -132,12 +132,9 @@ void StatsPlugin::check_timestamp(const Packet &pkt)
       return;
    }
 
-   struct timeval tmp;
-   timeradd(&m_last_ts, &m_interval, &tmp);
-
-   if (timercmp(&pkt.ts, &tmp, >)) {
+   if (pkt.ts > m_last_ts + m_interval) {
       print_line(m_last_ts);
-      timeradd(&m_last_ts, &m_interval, &m_last_ts);
+      m_last_ts += m_interval;
       m_packets = 0;
       m_new_flows = 0;
       m_cache_hits = 0;
@@ -149,9 +146,9 @@ void StatsPlugin::print_header() const
    *m_out << "#timestamp packets hits newflows incache" << std::endl;
 }
 
-void StatsPlugin::print_line(const struct timeval &ts) const
+void StatsPlugin::print_line(timestamp_t ts) const
 {
-   *m_out << ts.tv_sec << "." << ts.tv_usec << " ";
+   *m_out << ts_sec(ts) << "." << ts_usec(ts) << " ";
    *m_out << m_packets << " " << m_cache_hits << " " << m_new_flows << " " << m_flows_in_cache << std::endl;
 }
 
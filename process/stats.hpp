@@ -82,6 +82,7 @@ public:
    OptionsParser *get_parser() const { return new StatsOptParser(); }
    std::string get_name() const { return "stats"; }
    ProcessPlugin *copy();
+   uint32_t get_payload_horizon() const { return 0; }
 
    int post_create(Flow &rec, const Packet &pkt);
    int post_update(Flow &rec, const Packet &pkt);
@@ -95,13 +96,13 @@ private:
    uint64_t m_flows_in_cache;
 
    bool m_init_ts;
-   struct timeval m_interval;
-   struct timeval m_last_ts;
+   timestamp_t m_interval;
+   timestamp_t m_last_ts;
    std::ostream *m_out;
 
    void check_timestamp(const Packet &pkt);
    void print_header() const;
-   void print_line(const struct timeval &ts) const;
+   void print_line(timestamp_t ts) const;
 };
 
 }
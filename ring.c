@@ -83,6 +83,7 @@ struct ring_reader {
     uint32_t data_idx;
     /**
      * \brief Reader head (start of the next read operation)
+     * \warning This value can be read by a writer! Therefore, modification MUST be always atomic.
      * \warning Not limited by the buffer's boundary. Overflow is expected behavior.
      * \note Value range [0..UINT32_MAX].
      */
@@ -351,6 +352,43 @@ ipx_ring_begin(ipx_ring_t *ring)
     return msg;
 }
 
+/**
+ * \brief Get a new empty field without waiting
+ *
+ * \note Same as ipx_ring_begin(), but the function doesn't block when the buffer is full.
+ *   Messages already processed by the reader are taken over even if the reader hasn't
+ *   synchronized yet, so NULL is returned only when the buffer is really full.
+ * \param[in] ring Ring buffer
+ * \return Pointer to a unused place in the buffer or NULL (the buffer is full)
+ */
+static inline ipx_msg_t **
+ipx_ring_try_begin(ipx_ring_t *ring)
+{
+    // Prepare the next pointer to write
+    ipx_msg_t **msg = &ring->data[ring->writer.data_idx];
+
+    // Is there enough space?
+    if (ring->writer.exchange_idx - ring->writer.write_idx > 0) {
+        return msg;
+    }
+
+    // Get an empty space -> reader-writer synchronization
+    pthread_mutex_lock(&ring->sync.mutex);
+    ring->writer.exchange_idx = ring->sync.write_idx;
+    if (ring->writer.exchange_idx - ring->writer.write_idx == 0) {
+        // Reader still didn't perform sync -> try to steal all processed messages from reader
+        ring->sync.write_idx = __atomic_load_n(&ring->reader.read_idx, __ATOMIC_ACQUIRE) + ring->writer.size;
+        ring->writer.exchange_idx = ring->sync.write_idx;
+    }
+    pthread_cond_signal(&ring->sync.cond_reader);
+    pthread_mutex_unlock(&ring->sync.mutex);
+
+    if (ring->writer.exchange_idx - ring->writer.write_idx == 0) {
+        return NULL;
+    }
+    return msg;
+}
+
 /**
  * \brief Commit modifications of memory
  * \param[in] ring Ring buffer
@@ -398,13 +436,34 @@ ipx_ring_push(ipx_ring_t *ring, ipx_msg_t *msg)
     }
 }
 
+bool
+ipx_ring_try_push(ipx_ring_t *ring, ipx_msg_t *msg)
+{
+    ipx_msg_t **msg_space;
+
+    if (ring->mw_mode) {
+        pthread_spin_lock(&ring->writer_lock);
+    }
+
+    msg_space = ipx_ring_try_begin(ring);
+    if (msg_space != NULL) {
+        *msg_space = msg;
+        ipx_ring_commit(ring);
+    }
+
+    if (ring->mw_mode) {
+        pthread_spin_unlock(&ring->writer_lock);
+    }
+    return msg_space != NULL;
+}
 
 ipx_msg_t *
 ipx_ring_pop(ipx_ring_t *ring)
 {
     // Consider previous memory block as processed
     ring->reader.data_idx += ring->reader.last;
-    ring->reader.read_idx += ring->reader.last;
+    // Atomic update of reader index (Note: can be read by a writer in ipx_ring_try_begin())
+    __atomic_store_n(&ring->reader.read_idx, ring->reader.read_idx + ring->reader.last, __ATOMIC_RELEASE);
     ring->reader.last = 0;
 
     if (ring->reader.size == ring->reader.data_idx) {
@@ -418,7 +477,7 @@ ipx_ring_pop(ipx_ring_t *ring)
     // Sync positions with writers, if necessary
     if (ring->reader.read_idx - ring->reader.read_commit_idx >= ring->reader.div_block) {
         pthread_mutex_lock(&ring->sync.mutex);
-        ring->sync.write_idx += ring->reader.read_idx - ring->reader.read_commit_idx;
+        ring->sync.write_idx = ring->reader.read_idx + ring->reader.size;
         ring->reader.exchange_idx = ring->sync.read_idx;
         ring->reader.read_commit_idx = ring->reader.read_idx;
         pthread_cond_signal(&ring->sync.cond_writer);
@@ -58,6 +58,22 @@ struct InputStats {
    uint64_t bytes;
    uint64_t qtime;
    uint64_t dropped;
+   uint64_t qdropped; /**< Packets of blocks dropped because input queue was full, including packets of aggregated flows */
+   uint64_t malformed_l2; /**< Truncated link layer headers */
+   uint64_t malformed_l3; /**< Truncated IP headers */
+   uint64_t malformed_l4; /**< Truncated transport headers */
+   uint64_t malformed_tcp_opt; /**< Malformed TCP options */
+   uint64_t malformed_hdr_len; /**< Header lengths pointing behind captured data */
+
+   uint64_t malformed() const
+   {
+      return malformed_l2 + malformed_l3 + malformed_l4 + malformed_tcp_opt + malformed_hdr_len;
+   }
+};
+
+struct StorageStats {
+   uint64_t qtime;
+   uint64_t dropped;
 };
 
 struct OutputStats {
@@ -73,6 +89,7 @@ typedef struct msg_header_s
    uint16_t size;
    uint16_t inputs;
    uint16_t outputs;
+   uint16_t storages;
 
    // followed by arrays of plugin stats
 } msg_header_t;
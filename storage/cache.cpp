@@ -52,7 +52,6 @@
 
 #include <ipfixprobe/ring.h>
 #include "cache.hpp"
-#include "xxhash.h"
 
 namespace ipxp {
 
@@ -77,8 +76,8 @@ void FlowRecord::erase()
    m_flow.remove_extensions();
    m_hash = 0;
 
-   memset(&m_flow.time_first, 0, sizeof(m_flow.time_first));
-   memset(&m_flow.time_last, 0, sizeof(m_flow.time_last));
+   m_flow.time_first = 0;
+   m_flow.time_last = 0;
    m_flow.ip_version = 0;
    m_flow.ip_proto = 0;
    memset(&m_flow.src_ip, 0, sizeof(m_flow.src_ip));
@@ -104,6 +103,14 @@ void FlowRecord::reuse()
    m_flow.dst_tcp_flags = 0;
 }
 
+/**
+ * \brief Difference of timestamps in whole seconds, negative when packets are reordered.
+ */
+static inline int64_t ts_sec_diff(timestamp_t end, timestamp_t start)
+{
+   return static_cast<int64_t>(ts_sec(end)) - static_cast<int64_t>(ts_sec(start));
+}
+
 inline __attribute__((always_inline)) bool FlowRecord::is_empty() const
 {
    return m_hash == 0;
@@ -178,7 +185,7 @@ void FlowRecord::update(const Packet &pkt, bool src)
 NHTFlowCache::NHTFlowCache() :
    m_cache_size(0), m_line_size(0), m_line_mask(0), m_line_new_idx(0),
    m_qsize(0), m_qidx(0), m_timeout_idx(0), m_active(0), m_inactive(0),
-   m_split_biflow(false), m_keylen(0), m_key(), m_key_inv(), m_flow_table(nullptr), m_flow_records(nullptr)
+   m_split_biflow(false), m_hash(nullptr), m_keylen(0), m_key(), m_key_inv(), m_flow_table(nullptr), m_flow_records(nullptr)
 {
 }
 
@@ -200,6 +207,7 @@ void NHTFlowCache::init(const char *params)
    m_line_size = parser.m_line_size;
    m_active = parser.m_active;
    m_inactive = parser.m_inactive;
+   m_hash = flow_hash_get(parser.m_hash);
    m_qidx = 0;
    m_timeout_idx = 0;
    m_line_mask = (m_cache_size - 1) & ~(m_line_size - 1);
@@ -208,6 +216,9 @@ void NHTFlowCache::init(const char *params)
    if (m_export_queue == nullptr) {
       throw PluginError("output queue must be set before init");
    }
+   if (m_hash == nullptr) {
+      throw PluginError("unknown or unsupported hash function " + parser.m_hash);
+   }
 
    if (m_line_size > m_cache_size) {
       throw PluginError("flow cache line size must be greater or equal to cache size");
@@ -259,12 +270,27 @@ void NHTFlowCache::set_queue(ipx_ring_t *queue)
 
 void NHTFlowCache::export_flow(size_t index)
 {
-   ipx_ring_push(m_export_queue, &m_flow_table[index]->m_flow);
+   if (!export_queue_push(&m_flow_table[index]->m_flow)) {
+      m_flow_table[index]->erase();
+      return;
+   }
    std::swap(m_flow_table[index], m_flow_table[m_cache_size + m_qidx]);
    m_flow_table[index]->erase();
    m_qidx = (m_qidx + 1) % m_qsize;
 }
 
+void NHTFlowCache::put_flow(const Flow &flow)
+{
+   // Flow bypasses the cache and is exported from a spare record, the same way as records leaving the cache
+   FlowRecord *rec = m_flow_table[m_cache_size + m_qidx];
+   rec->erase();
+   rec->m_flow = flow;
+   rec->m_flow.m_exts = nullptr;
+   if (export_queue_push(&rec->m_flow)) {
+      m_qidx = (m_qidx + 1) % m_qsize;
+   }
+}
+
 void NHTFlowCache::finish()
 {
    for (decltype(m_cache_size) i = 0; i < m_cache_size; i++) {
@@ -288,16 +314,19 @@ void NHTFlowCache::flush(Packet &pkt, size_t flow_index, int ret, bool source_fl
    if (ret == FLOW_FLUSH_WITH_REINSERT) {
       FlowRecord *flow = m_flow_table[flow_index];
       flow->m_flow.end_reason = FLOW_END_FORCED;
-      ipx_ring_push(m_export_queue, &flow->m_flow);
+      if (export_queue_push(&flow->m_flow)) {
+         std::swap(m_flow_table[flow_index], m_flow_table[m_cache_size + m_qidx]);
 
-      std::swap(m_flow_table[flow_index], m_flow_table[m_cache_size + m_qidx]);
-
-      flow = m_flow_table[flow_index];
-      flow->m_flow.remove_extensions();
-      *flow = *m_flow_table[m_cache_size + m_qidx];
-      m_qidx = (m_qidx + 1) % m_qsize;
+         flow = m_flow_table[flow_index];
+         flow->m_flow.remove_extensions();
+         *flow = *m_flow_table[m_cache_size + m_qidx];
+         m_qidx = (m_qidx + 1) % m_qsize;
 
-      flow->m_flow.m_exts = nullptr;
+         flow->m_flow.m_exts = nullptr;
+      } else {
+         // Flow was dropped, reuse the record in place
+         flow->m_flow.remove_extensions();
+      }
       flow->reuse(); // Clean counters, set time first to last
       flow->update(pkt, source_flow); // Set new counters from packet
 
@@ -319,7 +348,7 @@ int NHTFlowCache::put_pkt(Packet &pkt)
       return 0;
    }
 
-   uint64_t hashval = XXH64(m_key, m_keylen, 0); /* Calculates hash value from key created before. */
+   uint64_t hashval = m_hash(m_key, m_keylen); /* Calculates hash value from key created before. */
 
    FlowRecord *flow; /* Pointer to flow we will be working with. */
    bool found = false;
@@ -338,7 +367,7 @@ int NHTFlowCache::put_pkt(Packet &pkt)
 
    /* Find inversed flow. */
    if (!found && !m_split_biflow) {
-      uint64_t hashval_inv = XXH64(m_key_inv, m_keylen, 0);
+      uint64_t hashval_inv = m_hash(m_key_inv, m_keylen);
       uint64_t line_index_inv = hashval_inv & m_line_mask;
       uint64_t next_line_inv = line_index_inv + m_line_size;
       for (flow_index = line_index_inv; flow_index < next_line_inv; flow_index++) {
@@ -428,7 +457,7 @@ int NHTFlowCache::put_pkt(Packet &pkt)
 #endif /* FLOW_CACHE_STATS */
       }
    } else {
-      if (pkt.ts.tv_sec - flow->m_flow.time_last.tv_sec >= m_inactive) {
+      if (ts_sec_diff(pkt.ts, flow->m_flow.time_last) >= m_inactive) {
          m_flow_table[flow_index]->m_flow.end_reason = get_export_reason(flow->m_flow);
          plugins_pre_export(flow->m_flow);
          export_flow(flow_index);
@@ -452,7 +481,7 @@ int NHTFlowCache::put_pkt(Packet &pkt)
       }
 
       /* Check if flow record is expired. */
-      if (pkt.ts.tv_sec - flow->m_flow.time_first.tv_sec >= m_active) {
+      if (ts_sec_diff(pkt.ts, flow->m_flow.time_first) >= m_active) {
          m_flow_table[flow_index]->m_flow.end_reason = FLOW_END_ACTIVE;
          plugins_pre_export(flow->m_flow);
          export_flow(flow_index);
@@ -462,7 +491,7 @@ int NHTFlowCache::put_pkt(Packet &pkt)
       }
    }
 
-   export_expired(pkt.ts.tv_sec);
+   export_expired(ts_sec(pkt.ts));
    return 0;
 }
 
@@ -479,7 +508,7 @@ uint8_t NHTFlowCache::get_export_reason(Flow &flow)
 void NHTFlowCache::export_expired(time_t ts)
 {
    for (decltype(m_timeout_idx) i = m_timeout_idx; i < m_timeout_idx + m_line_new_idx; i++) {
-      if (!m_flow_table[i]->is_empty() && ts - m_flow_table[i]->m_flow.time_last.tv_sec >= m_inactive) {
+      if (!m_flow_table[i]->is_empty() && ts - static_cast<time_t>(ts_sec(m_flow_table[i]->m_flow.time_last)) >= m_inactive) {
          m_flow_table[i]->m_flow.end_reason = get_export_reason(m_flow_table[i]->m_flow);
          plugins_pre_export(m_flow_table[i]->m_flow);
          export_flow(i);
@@ -53,6 +53,7 @@
 #include <ipfixprobe/options.hpp>
 #include <ipfixprobe/flowifc.hpp>
 #include <ipfixprobe/utils.hpp>
+#include "flowhash.hpp"
 
 namespace ipxp {
 
@@ -106,10 +107,11 @@ public:
    uint32_t m_active;
    uint32_t m_inactive;
    bool m_split_biflow;
+   std::string m_hash;
 
    CacheOptParser() : OptionsParser("cache", "Storage plugin implemented as a hash table"),
       m_cache_size(1 << DEFAULT_FLOW_CACHE_SIZE), m_line_size(1 << DEFAULT_FLOW_LINE_SIZE),
-      m_active(DEFAULT_ACTIVE_TIMEOUT), m_inactive(DEFAULT_INACTIVE_TIMEOUT), m_split_biflow(false)
+      m_active(DEFAULT_ACTIVE_TIMEOUT), m_inactive(DEFAULT_INACTIVE_TIMEOUT), m_split_biflow(false), m_hash("")
    {
       register_option("s", "size", "EXPONENT", "Cache size exponent to the power of two",
          [this](const char *arg){try {unsigned exp = str2num<decltype(exp)>(arg);
@@ -134,6 +136,8 @@ public:
          OptionFlags::RequiredArgument);
       register_option("S", "split", "", "Split biflows into uniflows",
          [this](const char *arg){ m_split_biflow = true; return true;}, OptionFlags::NoArgument);
+      register_option("H", "hash", "NAME", "Flow hash function xxh64, xxh3, ipv4 or crc32c (requires SSE4.2), ipv4 by default",
+         [this](const char *arg){ m_hash = arg; return true;}, OptionFlags::RequiredArgument);
    }
 };
 
@@ -168,6 +172,7 @@ public:
    std::string get_name() const { return "cache"; }
 
    int put_pkt(Packet &pkt);
+   void put_flow(const Flow &flow);
    void export_expired(time_t ts);
 
 private:
@@ -190,6 +195,7 @@ private:
    uint32_t m_active;
    uint32_t m_inactive;
    bool m_split_biflow;
+   flow_hash_t m_hash;
    uint8_t m_keylen;
    char m_key[MAX_KEY_LENGTH];
    char m_key_inv[MAX_KEY_LENGTH];
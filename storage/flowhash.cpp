@@ -0,0 +1,185 @@
+/**
+ * \file flowhash.cpp
+ * \brief Hash functions of flow cache keys
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#include "flowhash.hpp"
+#include "cache.hpp"
+#include "xxhash.h"
+
+namespace ipxp {
+
+#define FLOW_HASH_PRIME1 0x9E3779B185EBCA87ULL
+#define FLOW_HASH_PRIME2 0xC2B2AE3D27D4EB4FULL
+
+/**
+ * \brief Final mix of 64 bit value with full avalanche (MurmurHash3 finalizer).
+ */
+static inline uint64_t fmix64(uint64_t h)
+{
+   h ^= h >> 33;
+   h *= 0xFF51AFD7ED558CCDULL;
+   h ^= h >> 33;
+   h *= 0xC4CEB9FE1A85EC53ULL;
+   h ^= h >> 33;
+   return h;
+}
+
+static inline uint64_t load64(const uint8_t *p)
+{
+   uint64_t v;
+   memcpy(&v, p, sizeof(v));
+   return v;
+}
+
+uint64_t flow_hash_xxh64(const void *key, size_t len)
+{
+   return XXH64(key, len, 0);
+}
+
+uint64_t flow_hash_xxh3(const void *key, size_t len)
+{
+   return XXH3_64bits(key, len);
+}
+
+/**
+ * IPv4 keys have fixed length, so they are hashed by two overlapping 8 byte loads without any branching on length.
+ * Other keys are hashed by XXH3.
+ */
+uint64_t flow_hash_ipv4(const void *key, size_t len)
+{
+   static_assert(sizeof(flow_key_v4_t) > 8 && sizeof(flow_key_v4_t) <= 16, "IPv4 flow key must be 9 to 16 bytes long");
+   if (len != sizeof(flow_key_v4_t)) {
+      return XXH3_64bits(key, len);
+   }
+   const uint8_t *p = static_cast<const uint8_t *>(key);
+   uint64_t lo = load64(p);
+   uint64_t hi = load64(p + sizeof(flow_key_v4_t) - 8);
+   return fmix64(lo * FLOW_HASH_PRIME1 ^ (hi + FLOW_HASH_PRIME2));
+}
+
+#if defined(__x86_64__)
+/**
+ * Two CRC32C lanes form 64 bit value. CRC is linear, so the second lane processes words multiplied by odd constant,
+ * otherwise both lanes would differ only by a constant and the value would carry just 32 bits of information.
+ */
+__attribute__((target("sse4.2"))) uint64_t flow_hash_crc32c(const void *key, size_t len)
+{
+   const uint8_t *p = static_cast<const uint8_t *>(key);
+   uint64_t lane1 = 0;
+   uint64_t lane2 = 0xFFFFFFFF;
+   size_t i = 0;
+   for (; i + 8 <= len; i += 8) {
+      uint64_t v = load64(p + i);
+      lane1 = _mm_crc32_u64(lane1, v);
+      lane2 = _mm_crc32_u64(lane2, v * FLOW_HASH_PRIME1);
+   }
+   if (i < len) {
+      // Tail is loaded as overlapping last 8 bytes when key is long enough
+      uint64_t v = 0;
+      if (len >= 8) {
+         v = load64(p + len - 8) >> (8 * (8 - (len - i)));
+      } else {
+         memcpy(&v, p + i, len - i);
+      }
+      lane1 = _mm_crc32_u64(lane1, v);
+      lane2 = _mm_crc32_u64(lane2, v * FLOW_HASH_PRIME1);
+   }
+   return fmix64(lane1 << 32 | lane2);
+}
+#else
+uint64_t flow_hash_crc32c(const void *key, size_t len)
+{
+   return XXH3_64bits(key, len);
+}
+#endif
+
+static bool cpu_has_crc32c()
+{
+#if defined(__x86_64__)
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("sse4.2");
+#else
+   return false;
+#endif
+}
+
+std::vector<std::string> flow_hash_names()
+{
+   std::vector<std::string> names = {"xxh64", "xxh3", "ipv4"};
+   if (cpu_has_crc32c()) {
+      names.push_back("crc32c");
+   }
+   return names;
+}
+
+/*
+ * Keys of both directions hashed per packet (make bench, -s hash) take about 7 ns with
+ * ipv4, 7-8 ns with xxh3, 7-13 ns with crc32c and 13-20 ns with xxh64. The two-lane crc32c
+ * loses on IPv6 keys, so the fixed-length IPv4 hash with XXH3 for IPv6 is used everywhere.
+ */
+std::string flow_hash_default()
+{
+   return "ipv4";
+}
+
+flow_hash_t flow_hash_get(const std::string &name)
+{
+   if (name.empty()) {
+      return flow_hash_get(flow_hash_default());
+   } else if (name == "xxh64") {
+      return flow_hash_xxh64;
+   } else if (name == "xxh3") {
+      return flow_hash_xxh3;
+   } else if (name == "ipv4") {
+      return flow_hash_ipv4;
+   } else if (name == "crc32c" && cpu_has_crc32c()) {
+      return flow_hash_crc32c;
+   }
+   return nullptr;
+}
+
+}
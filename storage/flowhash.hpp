@@ -0,0 +1,81 @@
+/**
+ * \file flowhash.hpp
+ * \brief Hash functions of flow cache keys
+ * \date 2021
+ */
+/*
+ * Copyright (C) 2021 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_STORAGE_FLOWHASH_HPP
+#define IPXP_STORAGE_FLOWHASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ipxp {
+
+/**
+ * \brief Hash function of flow key, zero value is reserved for empty flow records.
+ */
+typedef uint64_t (*flow_hash_t)(const void *key, size_t len);
+
+uint64_t flow_hash_xxh64(const void *key, size_t len);
+uint64_t flow_hash_xxh3(const void *key, size_t len);
+uint64_t flow_hash_crc32c(const void *key, size_t len);
+uint64_t flow_hash_ipv4(const void *key, size_t len);
+
+/**
+ * \brief Get names of hash functions supported by this CPU.
+ */
+std::vector<std::string> flow_hash_names();
+
+/**
+ * \brief Get name of the default hash function, ipv4 on all CPUs.
+ */
+std::string flow_hash_default();
+
+/**
+ * \brief Get hash function by name.
+ * \param [in] name Name of hash function, default one is returned for empty name.
+ * \return Hash function or nullptr when it is unknown or not supported by this CPU.
+ */
+flow_hash_t flow_hash_get(const std::string &name);
+
+}
+#endif /* IPXP_STORAGE_FLOWHASH_HPP */
@@ -0,0 +1,671 @@
+/**
+ * \file stages.cpp
+ * \brief Microbenchmarks of single pipeline stages (parser, flow hash, flow cache, process plugins and IPFIX exporter)
+ *
+ * Traces are loaded into memory and replayed in a loop, so only the measured stage is timed.
+ * Results are printed as CSV lines: stage,variant,trace,items,ns_per_item,unit
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <ipfixprobe/clock.hpp>
+#include <ipfixprobe/options.hpp>
+#include <ipfixprobe/output.hpp>
+#include <ipfixprobe/process.hpp>
+#include <ipfixprobe/ring.h>
+#include <ipfixprobe/storage.hpp>
+#include <ipfixprobe/utils.hpp>
+
+#include "pluginmgr.hpp"
+#include "parser.hpp"
+#include "storage/cache.hpp"
+
+using namespace ipxp;
+
+#define PCAP_MAGIC_USEC 0xA1B2C3D4
+#define PCAP_MAGIC_NSEC 0xA1B23C4D
+#define BENCH_BLOCK_SIZE 64
+#define BENCH_BUFFER_SIZE 1600
+#define BENCH_EXPORT_RING 65536
+
+class BenchOptParser : public OptionsParser {
+public:
+   std::vector<std::string> m_traces;
+   uint64_t m_count;
+   uint32_t m_rounds;
+   std::string m_stage;
+   bool m_synthetic;
+   bool m_help;
+
+   BenchOptParser() : OptionsParser("stages", "Measure throughput of single pipeline stages"),
+                      m_count(200000), m_rounds(5), m_stage(""), m_synthetic(true), m_help(false)
+   {
+      m_delim = ' ';
+
+      register_option("-t", "--trace", "FILE", "Pcap file to replay, can be specified multiple times",
+         [this](const char *arg) {
+            m_traces.push_back(arg);
+            return true;
+         }, OptionFlags::RequiredArgument);
+      register_option("-n", "--count", "NUM", "Minimal number of packets or flows processed in one round",
+         [this](const char *arg) {
+            try { m_count = str2num<decltype(m_count)>(arg); } catch (std::invalid_argument &e) { return false; }
+            return m_count > 0;
+         }, OptionFlags::RequiredArgument);
+      register_option("-r", "--rounds", "NUM", "Number of rounds, the fastest one is reported",
+         [this](const char *arg) {
+            try { m_rounds = str2num<decltype(m_rounds)>(arg); } catch (std::invalid_argument &e) { return false; }
+            return m_rounds > 0;
+         }, OptionFlags::RequiredArgument);
+      register_option("-s", "--stage", "NAME", "Run only one stage: parser, hash, cache or export",
+         [this](const char *arg) {
+            m_stage = arg;
+            return m_stage == "parser" || m_stage == "hash" || m_stage == "cache" || m_stage == "export";
+         }, OptionFlags::RequiredArgument);
+      register_option("-S", "--no-synthetic", "", "Do not generate synthetic traces",
+         [this](const char *arg) {
+            m_synthetic = false;
+            return true;
+         }, OptionFlags::NoArgument);
+      register_option("-h", "--help", "", "Print help",
+         [this](const char *arg) {
+            m_help = true;
+            return true;
+         }, OptionFlags::NoArgument);
+   }
+};
+
+/**
+ * \brief Packets of one trace stored in memory.
+ */
+struct Trace {
+   struct Record {
+      timestamp_t ts;
+      uint32_t offset;
+      uint16_t caplen;
+      uint16_t len;
+   };
+
+   std::string name;
+   int datalink;
+   std::vector<uint8_t> data;
+   std::vector<Record> records;
+   timestamp_t span; /**< Time shift of one replay loop, whole seconds */
+
+   const uint8_t *packet(size_t i) const
+   {
+      return data.data() + records[i].offset;
+   }
+};
+
+/**
+ * \brief Parsed packets of one trace.
+ */
+struct ParsedTrace {
+   std::vector<Packet> pkts;
+   std::vector<timestamp_t> ts;
+   std::vector<uint8_t> buffers;
+};
+
+static void error(const std::string &msg)
+{
+   std::cerr << "Error: " << msg << std::endl;
+}
+
+static void report(const std::string &stage, const std::string &variant, const std::string &trace, uint64_t items,
+   double ns_per_item, const char *unit)
+{
+   printf("%s,%s,%s,%" PRIu64 ",%.2f,%s\n", stage.c_str(), variant.c_str(), trace.c_str(), items, ns_per_item, unit);
+   fflush(stdout);
+}
+
+static uint32_t swap32(uint32_t val, bool swap)
+{
+   return swap ? __builtin_bswap32(val) : val;
+}
+
+static void finish_trace(Trace &trace)
+{
+   uint64_t first = ts_sec(trace.records.front().ts);
+   uint64_t last = ts_sec(trace.records.back().ts);
+   trace.span = (last - first + 1) * NANO_SEC;
+}
+
+/**
+ * \brief Load classic pcap file into memory.
+ */
+static bool load_pcap(const std::string &file, Trace &trace)
+{
+   std::ifstream in(file, std::ios::binary);
+   if (in.fail()) {
+      error("unable to open " + file);
+      return false;
+   }
+   trace.data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+   trace.name = file.substr(file.find_last_of('/') + 1);
+
+   uint32_t hdr[6];
+   if (trace.data.size() < sizeof(hdr)) {
+      error(file + ": file is too short");
+      return false;
+   }
+   memcpy(hdr, trace.data.data(), sizeof(hdr));
+   bool swap = false;
+   bool nsec = false;
+   if (hdr[0] == PCAP_MAGIC_USEC || hdr[0] == PCAP_MAGIC_NSEC) {
+      nsec = hdr[0] == PCAP_MAGIC_NSEC;
+   } else if (hdr[0] == __builtin_bswap32(PCAP_MAGIC_USEC) || hdr[0] == __builtin_bswap32(PCAP_MAGIC_NSEC)) {
+      swap = true;
+      nsec = hdr[0] == __builtin_bswap32(PCAP_MAGIC_NSEC);
+   } else {
+      error(file + ": only classic pcap format is supported, skipping");
+      return false;
+   }
+   trace.datalink = swap32(hdr[5], swap);
+
+   size_t offset = sizeof(hdr);
+   while (offset + 16 <= trace.data.size()) {
+      uint32_t rec[4];
+      memcpy(rec, trace.data.data() + offset, sizeof(rec));
+      offset += sizeof(rec);
+      uint32_t caplen = swap32(rec[2], swap);
+      if (offset + caplen > trace.data.size() || caplen > UINT16_MAX) {
+         break;
+      }
+      Trace::Record r;
+      r.ts = nsec ? ts_from_nsec(swap32(rec[0], swap), swap32(rec[1], swap)) :
+         ts_from_usec(swap32(rec[0], swap), swap32(rec[1], swap));
+      r.offset = offset;
+      r.caplen = caplen;
+      r.len = std::min<uint32_t>(swap32(rec[3], swap), UINT16_MAX);
+      trace.records.push_back(r);
+      offset += caplen;
+   }
+   if (trace.records.empty()) {
+      error(file + ": no packets");
+      return false;
+   }
+   finish_trace(trace);
+   return true;
+}
+
+/**
+ * \brief Generate trace of small TCP packets or larger UDP packets spread over many flows.
+ */
+static void generate_trace(Trace &trace, const std::string &name, bool ipv6, uint8_t proto, uint16_t size,
+   uint32_t flows, uint32_t packets)
+{
+   trace.name = name;
+   trace.datalink = DLT_EN10MB;
+   uint32_t state = 1;
+   for (uint32_t i = 0; i < packets; i++) {
+      state = state * 1103515245 + 12345;
+      uint32_t flow = (state >> 8) % flows;
+      std::vector<uint8_t> pkt(size, 0);
+      uint8_t *l3 = pkt.data() + 14;
+      uint8_t *l4;
+      pkt[0] = 0x02;
+      pkt[6] = 0x02;
+      if (ipv6) {
+         pkt[12] = 0x86;
+         pkt[13] = 0xDD;
+         l3[0] = 0x60;
+         uint16_t plen = htons(size - 14 - 40);
+         memcpy(l3 + 4, &plen, 2);
+         l3[6] = proto;
+         l3[7] = 64;
+         l3[8] = 0x20;
+         l3[9] = 0x01;
+         memcpy(l3 + 20, &flow, sizeof(flow));
+         l3[24] = 0x20;
+         l3[25] = 0x01;
+         l3[39] = 1;
+         l4 = l3 + 40;
+      } else {
+         pkt[12] = 0x08;
+         pkt[13] = 0x00;
+         l3[0] = 0x45;
+         uint16_t tot_len = htons(size - 14);
+         memcpy(l3 + 2, &tot_len, 2);
+         l3[8] = 64;
+         l3[9] = proto;
+         uint32_t src = htonl(0x0A000000 | (flow & 0xFFFFFF));
+         uint32_t dst = htonl(0xC0A80001);
+         memcpy(l3 + 12, &src, 4);
+         memcpy(l3 + 16, &dst, 4);
+         l4 = l3 + 20;
+      }
+      uint16_t sport = htons(1024 + flow % 50000);
+      uint16_t dport = htons(proto == IPPROTO_TCP ? 443 : 53);
+      memcpy(l4, &sport, 2);
+      memcpy(l4 + 2, &dport, 2);
+      if (proto == IPPROTO_TCP) {
+         l4[12] = 0x50;
+         l4[13] = 0x10;
+      } else {
+         uint16_t ulen = htons(pkt.data() + size - l4);
+         memcpy(l4 + 4, &ulen, 2);
+      }
+
+      Trace::Record r;
+      r.ts = ts_from_usec(i / 1000000, i % 1000000);
+      r.offset = trace.data.size();
+      r.caplen = size;
+      r.len = size;
+      trace.records.push_back(r);
+      trace.data.insert(trace.data.end(), pkt.begin(), pkt.end());
+   }
+   finish_trace(trace);
+}
+
+static uint64_t loops_for(uint64_t count, size_t items)
+{
+   return (count + items - 1) / items;
+}
+
+static void bench_parser(const BenchOptParser &opts, const Trace &trace)
+{
+   std::vector<Packet> pkts(BENCH_BLOCK_SIZE);
+   std::vector<uint8_t> buffers(BENCH_BLOCK_SIZE * BENCH_BUFFER_SIZE);
+   for (size_t i = 0; i < pkts.size(); i++) {
+      pkts[i].buffer = buffers.data() + i * BENCH_BUFFER_SIZE;
+      pkts[i].buffer_size = BENCH_BUFFER_SIZE;
+   }
+   PacketBlock block;
+   block.pkts = pkts.data();
+   block.size = pkts.size();
+   FragmentTable fragments;
+   uint64_t malformed[PARSER_STATUS_CNT] = {};
+   parser_opt_t opt = {&block, false, false, trace.datalink, false, PAYLOAD_HORIZON_FULL, 0, &fragments, malformed};
+
+   uint64_t loops = loops_for(opts.m_count, trace.records.size());
+   uint64_t best = UINT64_MAX;
+   for (uint32_t round = 0; round < opts.m_rounds; round++) {
+      uint64_t start = clock_monotonic();
+      for (uint64_t loop = 0; loop < loops; loop++) {
+         for (size_t i = 0; i < trace.records.size(); i++) {
+            const Trace::Record &r = trace.records[i];
+            if (block.cnt == block.size) {
+               block.cnt = 0;
+            }
+            parse_packet(&opt, r.ts, trace.packet(i), r.len, r.caplen);
+         }
+      }
+      best = std::min(best, clock_monotonic() - start);
+   }
+   uint64_t items = loops * trace.records.size();
+   report("parser", "-", trace.name, items, static_cast<double>(best) / items, "ns/packet");
+}
+
+static void parse_trace(const Trace &trace, ParsedTrace &parsed)
+{
+   size_t cnt = trace.records.size();
+   parsed.pkts.resize(cnt);
+   parsed.ts.clear();
+   parsed.buffers.resize(trace.data.size() + cnt);
+   PacketBlock block;
+   block.pkts = parsed.pkts.data();
+   block.size = cnt;
+   size_t offset = 0;
+   for (size_t i = 0; i < cnt; i++) {
+      parsed.pkts[i].buffer = parsed.buffers.data() + offset;
+      parsed.pkts[i].buffer_size = trace.records[i].caplen + 1;
+      offset += trace.records[i].caplen + 1;
+   }
+   parser_opt_t opt = {&block, false, false, trace.datalink, false, PAYLOAD_HORIZON_FULL, 0, nullptr, nullptr};
+   for (size_t i = 0; i < cnt; i++) {
+      const Trace::Record &r = trace.records[i];
+      parse_packet(&opt, r.ts, trace.packet(i), r.len, r.caplen);
+   }
+   parsed.pkts.resize(block.cnt);
+   for (auto &it : parsed.pkts) {
+      parsed.ts.push_back(it.ts);
+   }
+}
+
+static void drain(ipx_ring_t *ring, std::vector<Flow *> *flows = nullptr)
+{
+   Flow *flow;
+   while ((flow = static_cast<Flow *>(ipx_ring_pop(ring))) != nullptr) {
+      if (flows != nullptr) {
+         flows->push_back(flow);
+      }
+   }
+}
+
+/**
+ * \brief Create flow cache with given process plugins, flows which do not fit into export ring are dropped.
+ */
+static StoragePlugin *create_cache(PluginManager &mgr, ipx_ring_t *ring, const OutputPlugin::Plugins &plugins,
+   const std::string &params = "")
+{
+   StoragePlugin *cache = dynamic_cast<StoragePlugin *>(mgr.get("cache"));
+   if (cache == nullptr) {
+      throw PluginError("cache plugin is not available");
+   }
+   cache->set_queue(ring);
+   cache->set_queue_policy(QueuePolicy::DROP);
+   cache->init(params.c_str());
+   for (auto &it : plugins) {
+      cache->add_plugin(it.second);
+   }
+   return cache;
+}
+
+/**
+ * \brief Flow keys of one packet in both directions, built the same way as in flow cache.
+ */
+struct FlowKeys {
+   uint8_t len;
+   char key[MAX_KEY_LENGTH];
+   char key_inv[MAX_KEY_LENGTH];
+};
+
+static bool make_keys(const Packet &pkt, FlowKeys &keys)
+{
+   if (pkt.ip_version == IP::v4) {
+      flow_key_v4_t key = {pkt.src_port, pkt.dst_port, pkt.ip_proto, IP::v4, pkt.src_ip.v4, pkt.dst_ip.v4};
+      flow_key_v4_t key_inv = {pkt.dst_port, pkt.src_port, pkt.ip_proto, IP::v4, pkt.dst_ip.v4, pkt.src_ip.v4};
+      memcpy(keys.key, &key, sizeof(key));
+      memcpy(keys.key_inv, &key_inv, sizeof(key_inv));
+      keys.len = sizeof(key);
+   } else if (pkt.ip_version == IP::v6) {
+      flow_key_v6_t key = {pkt.src_port, pkt.dst_port, pkt.ip_proto, IP::v6, {}, {}};
+      flow_key_v6_t key_inv = {pkt.dst_port, pkt.src_port, pkt.ip_proto, IP::v6, {}, {}};
+      memcpy(key.src_ip, pkt.src_ip.v6, sizeof(key.src_ip));
+      memcpy(key.dst_ip, pkt.dst_ip.v6, sizeof(key.dst_ip));
+      memcpy(key_inv.src_ip, pkt.dst_ip.v6, sizeof(key_inv.src_ip));
+      memcpy(key_inv.dst_ip, pkt.src_ip.v6, sizeof(key_inv.dst_ip));
+      memcpy(keys.key, &key, sizeof(key));
+      memcpy(keys.key_inv, &key_inv, sizeof(key_inv));
+      keys.len = sizeof(key);
+   } else {
+      return false;
+   }
+   return true;
+}
+
+static volatile uint64_t hash_sink;
+
+/**
+ * \brief Hash flow keys in both directions, as the cache does for packets of new or reversed flows.
+ */
+static void bench_hash(const BenchOptParser &opts, const std::string &name, const std::string &trace_name,
+   const ParsedTrace &parsed)
+{
+   flow_hash_t hash = flow_hash_get(name);
+   std::vector<FlowKeys> keys(parsed.pkts.size());
+   size_t cnt = 0;
+   for (auto &pkt : parsed.pkts) {
+      cnt += make_keys(pkt, keys[cnt]);
+   }
+   keys.resize(cnt);
+   if (keys.empty()) {
+      return;
+   }
+
+   uint64_t loops = loops_for(opts.m_count, keys.size());
+   uint64_t best = UINT64_MAX;
+   uint64_t sum = 0;
+   for (uint32_t round = 0; round < opts.m_rounds; round++) {
+      uint64_t start = clock_monotonic();
+      for (uint64_t loop = 0; loop < loops; loop++) {
+         for (auto &it : keys) {
+            sum ^= hash(it.key, it.len) + hash(it.key_inv, it.len);
+         }
+      }
+      best = std::min(best, clock_monotonic() - start);
+   }
+   hash_sink = sum;
+   uint64_t items = loops * keys.size();
+   report("hash", name, trace_name, items, static_cast<double>(best) / items, "ns/packet");
+}
+
+static void bench_cache(const BenchOptParser &opts, PluginManager &mgr, const std::string &variant,
+   const OutputPlugin::Plugins &plugins, const std::string &trace_name, const Trace &trace, ParsedTrace &parsed,
+   const std::string &params = "")
+{
+   if (parsed.pkts.empty()) {
+      return;
+   }
+   uint64_t loops = loops_for(opts.m_count, parsed.pkts.size());
+   uint64_t best = UINT64_MAX;
+   for (uint32_t round = 0; round < opts.m_rounds; round++) {
+      ipx_ring_t *ring = ipx_ring_init(BENCH_EXPORT_RING, false);
+      std::unique_ptr<StoragePlugin> cache(create_cache(mgr, ring, plugins, params));
+
+      uint64_t start = clock_monotonic();
+      for (uint64_t loop = 0; loop < loops; loop++) {
+         // Every replay loop continues in time after the previous one
+         timestamp_t shift = loop * trace.span;
+         for (size_t i = 0; i < parsed.pkts.size(); i++) {
+            Packet &pkt = parsed.pkts[i];
+            pkt.ts = parsed.ts[i] + shift;
+            cache->put_pkt(pkt);
+         }
+      }
+      best = std::min(best, clock_monotonic() - start);
+
+      cache->finish();
+      cache.reset();
+      drain(ring);
+      ipx_ring_destroy(ring);
+   }
+   for (size_t i = 0; i < parsed.pkts.size(); i++) {
+      parsed.pkts[i].ts = parsed.ts[i];
+   }
+   uint64_t items = loops * parsed.pkts.size();
+   report("cache", variant, trace_name, items, static_cast<double>(best) / items, "ns/packet");
+}
+
+/**
+ * \brief Create UDP socket which is never read, packets sent to it are dropped by kernel.
+ */
+static int create_null_socket(uint16_t &port)
+{
+   int fd = socket(AF_INET, SOCK_DGRAM, 0);
+   if (fd < 0) {
+      return -1;
+   }
+   struct sockaddr_in addr;
+   socklen_t addr_len = sizeof(addr);
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || getsockname(fd, (struct sockaddr *) &addr, &addr_len)) {
+      close(fd);
+      return -1;
+   }
+   port = ntohs(addr.sin_port);
+   return fd;
+}
+
+static void bench_export(const BenchOptParser &opts, PluginManager &mgr, const std::string &variant,
+   OutputPlugin::Plugins &plugins, const std::string &trace_name, ParsedTrace &parsed)
+{
+   uint16_t port;
+   int sink = create_null_socket(port);
+   if (sink < 0) {
+      error("unable to create sink socket");
+      return;
+   }
+
+   ipx_ring_t *ring = ipx_ring_init(BENCH_EXPORT_RING, false);
+   std::unique_ptr<StoragePlugin> cache(create_cache(mgr, ring, plugins));
+   for (auto &pkt : parsed.pkts) {
+      cache->put_pkt(pkt);
+   }
+   cache->finish();
+   std::vector<Flow *> flows;
+   drain(ring, &flows);
+
+   if (!flows.empty()) {
+      std::unique_ptr<OutputPlugin> exporter(dynamic_cast<OutputPlugin *>(mgr.get("ipfix")));
+      if (exporter == nullptr) {
+         throw PluginError("ipfix plugin is not available");
+      }
+      std::string params = "h=127.0.0.1;p=" + std::to_string(port) + ";u";
+      exporter->init(params.c_str(), plugins);
+
+      uint64_t loops = loops_for(opts.m_count, flows.size());
+      uint64_t best = UINT64_MAX;
+      for (uint32_t round = 0; round < opts.m_rounds; round++) {
+         uint64_t start = clock_monotonic();
+         for (uint64_t loop = 0; loop < loops; loop++) {
+            for (auto flow : flows) {
+               exporter->export_flow(*flow);
+            }
+         }
+         best = std::min(best, clock_monotonic() - start);
+      }
+      exporter->close();
+      uint64_t items = loops * flows.size();
+      report("export", variant, trace_name, items, static_cast<double>(best) / items, "ns/flow");
+   }
+
+   cache.reset();
+   ipx_ring_destroy(ring);
+   close(sink);
+}
+
+static void delete_plugins(OutputPlugin::Plugins &plugins)
+{
+   for (auto &it : plugins) {
+      delete it.second;
+   }
+   plugins.clear();
+}
+
+static bool create_plugin(PluginManager &mgr, const std::string &name, OutputPlugin::Plugins &plugins)
+{
+   ProcessPlugin *plugin = dynamic_cast<ProcessPlugin *>(mgr.get(name));
+   if (plugin == nullptr) {
+      return false;
+   }
+   try {
+      plugin->init("");
+   } catch (std::exception &e) {
+      error(name + ": " + e.what());
+      delete plugin;
+      return false;
+   }
+   plugins.push_back(std::make_pair(name, plugin));
+   return true;
+}
+
+static std::vector<std::string> process_plugin_names(PluginManager &mgr)
+{
+   std::vector<std::string> names;
+   for (auto &it : mgr.get()) {
+      ProcessPlugin *plugin = dynamic_cast<ProcessPlugin *>(it);
+      // stats plugin prints cache statistics to stdout which would break CSV output
+      if (plugin != nullptr && plugin->get_name() != BASIC_PLUGIN_NAME && plugin->get_name() != "stats") {
+         names.push_back(plugin->get_name());
+      }
+      delete it;
+   }
+   std::sort(names.begin(), names.end());
+   return names;
+}
+
+int main(int argc, char *argv[])
+{
+   BenchOptParser opts;
+   try {
+      opts.parse(argc - 1, const_cast<const char **>(argv) + 1);
+   } catch (ParserError &e) {
+      error(e.what());
+      return EXIT_FAILURE;
+   }
+   if (opts.m_help) {
+      opts.usage(std::cout, 0);
+      return EXIT_SUCCESS;
+   }
+
+   std::vector<Trace> traces;
+   if (opts.m_synthetic) {
+      traces.resize(2);
+      generate_trace(traces[0], "synthetic-tcp64", false, IPPROTO_TCP, 64, 4096, 65536);
+      generate_trace(traces[1], "synthetic-udp512-ipv6", true, IPPROTO_UDP, 512, 1024, 16384);
+   }
+   for (auto &it : opts.m_traces) {
+      Trace trace;
+      if (load_pcap(it, trace)) {
+         traces.push_back(std::move(trace));
+      }
+   }
+
+   PluginManager mgr;
+   std::vector<std::string> names = process_plugin_names(mgr);
+   bool run_parser = opts.m_stage.empty() || opts.m_stage == "parser";
+   bool run_hash = opts.m_stage.empty() || opts.m_stage == "hash";
+   bool run_cache = opts.m_stage.empty() || opts.m_stage == "cache";
+   bool run_export = opts.m_stage.empty() || opts.m_stage == "export";
+
+   printf("stage,variant,trace,items,ns_per_item,unit\n");
+   try {
+      for (auto &trace : traces) {
+         if (run_parser) {
+            bench_parser(opts, trace);
+         }
+         if (!run_hash && !run_cache && !run_export) {
+            continue;
+         }
+
+         ParsedTrace parsed;
+         parse_trace(trace, parsed);
+         if (run_hash) {
+            for (auto &name : flow_hash_names()) {
+               bench_hash(opts, name, trace.name, parsed);
+            }
+         }
+         if (!run_cache && !run_export) {
+            continue;
+         }
+
+         OutputPlugin::Plugins plugins;
+         if (run_cache) {
+            bench_cache(opts, mgr, "basic", plugins, trace.name, trace, parsed);
+            for (auto &name : flow_hash_names()) {
+               bench_cache(opts, mgr, "basic-" + name, plugins, trace.name, trace, parsed, "hash=" + name);
+            }
+            for (auto &name : names) {
+               if (create_plugin(mgr, name, plugins)) {
+                  bench_cache(opts, mgr, name, plugins, trace.name, trace, parsed);
+                  delete_plugins(plugins);
+               }
+            }
+         }
+         if (run_export) {
+            bench_export(opts, mgr, "basic", plugins, trace.name, parsed);
+         }
+
+         for (auto &name : names) {
+            create_plugin(mgr, name, plugins);
+         }
+         if (run_cache) {
+            bench_cache(opts, mgr, "all", plugins, trace.name, trace, parsed);
+         }
+         if (run_export) {
+            bench_export(opts, mgr, "all", plugins, trace.name, parsed);
+         }
+         delete_plugins(plugins);
+      }
+   } catch (std::exception &e) {
+      error(e.what());
+      return EXIT_FAILURE;
+   }
+   return EXIT_SUCCESS;
+}
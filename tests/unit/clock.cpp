@@ -0,0 +1,81 @@
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "gtest/gtest.h"
+
+#include "ipfixprobe/clock.hpp"
+#include "ipfixprobe/ipfix-elements.hpp"
+
+namespace ipxp_test {
+
+using namespace ipxp;
+
+TEST(clock, fallback) {
+   struct timeval sys;
+   struct timeval tv;
+   gettimeofday(&sys, nullptr);
+   clock_realtime(&tv);
+   EXPECT_LE(sys.tv_sec, tv.tv_sec);
+   EXPECT_GE(sys.tv_sec + 1, tv.tv_sec);
+   EXPECT_LT(tv.tv_usec, 1000000);
+
+   uint64_t first = clock_monotonic();
+   EXPECT_LE(first, clock_monotonic());
+}
+
+TEST(clock, timekeeper) {
+   struct timeval sys;
+   struct timeval tv;
+
+   clock_start(100);
+   uint64_t first = clock_monotonic();
+   usleep(20000);
+   uint64_t second = clock_monotonic();
+   EXPECT_LT(first, second);
+   EXPECT_GE(second - first, 10000000U);
+
+   // Precise clock is not behind the coarse one
+   EXPECT_LE(second, clock_monotonic_precise());
+   EXPECT_LE(clock_realtime_ns(), clock_realtime_precise_ns());
+
+   gettimeofday(&sys, nullptr);
+   clock_realtime(&tv);
+   EXPECT_LE(tv.tv_sec, sys.tv_sec);
+   EXPECT_GE(tv.tv_sec + 1, sys.tv_sec);
+   clock_stop();
+   clock_stop();
+}
+
+TEST(clock, timestamp) {
+   struct timeval tv = {1460053411, 194983};
+   timestamp_t ts = ts_from_timeval(tv);
+   EXPECT_EQ(ts, 1460053411194983000ULL);
+   EXPECT_EQ(ts_sec(ts), 1460053411U);
+   EXPECT_EQ(ts_usec(ts), 194983U);
+   EXPECT_EQ(ts_to_msec(ts), 1460053411194ULL);
+
+   ts = ts_from_nsec(1460053411, 999999999);
+   EXPECT_EQ(ts_nsec(ts), 999999999U);
+   EXPECT_EQ(ts_usec(ts), 999999U);
+}
+
+TEST(clock, ntpTimestamp) {
+   for (uint32_t nsec : {0U, 1U, 500000000U, 123456789U, 999999999U}) {
+      timestamp_t ts = ts_from_nsec(1460053411, nsec);
+      uint64_t ntp = MK_NTP_TS_NSEC(ts);
+      EXPECT_EQ(ntp >> 32, 1460053411ULL + EPOCH_DIFF);
+      // Collectors convert fraction back by truncation
+      EXPECT_EQ(((ntp & 0xFFFFFFFFULL) * NANO_SEC) >> 32, nsec);
+   }
+   timestamp_t ts = ts_from_usec(1460053411, 194983);
+   EXPECT_EQ(((MK_NTP_TS(ts) & 0xFFFFFFFFULL) * 1000000ULL) >> 32, 194983U);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+   // invoking the tests
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
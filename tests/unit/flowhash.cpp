@@ -0,0 +1,157 @@
+#include <cstring>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+
+#include "gtest/gtest.h"
+
+#include "flowhash.hpp"
+#include "cache.hpp"
+
+namespace ipxp_test {
+
+using namespace ipxp;
+
+/**
+ * \brief Bitwise CRC32C without initial and final inversion, the same as SSE4.2 crc32 instruction.
+ */
+static uint32_t crc32c_ref(uint32_t crc, const uint8_t *data, size_t len)
+{
+   for (size_t i = 0; i < len; i++) {
+      crc ^= data[i];
+      for (int bit = 0; bit < 8; bit++) {
+         crc = crc & 1 ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+      }
+   }
+   return crc;
+}
+
+static uint64_t fmix64_ref(uint64_t h)
+{
+   h ^= h >> 33;
+   h *= 0xFF51AFD7ED558CCDULL;
+   h ^= h >> 33;
+   h *= 0xC4CEB9FE1A85EC53ULL;
+   h ^= h >> 33;
+   return h;
+}
+
+/**
+ * \brief Two lane CRC32C hash of 8 byte little endian words, tail word is zero extended.
+ */
+static uint64_t crc32c_hash_ref(const uint8_t *key, size_t len)
+{
+   uint32_t lane1 = 0;
+   uint32_t lane2 = 0xFFFFFFFF;
+   for (size_t i = 0; i < len; i += 8) {
+      uint64_t v = 0;
+      memcpy(&v, key + i, len - i < 8 ? len - i : 8);
+      uint64_t w = v * 0x9E3779B185EBCA87ULL;
+      lane1 = crc32c_ref(lane1, reinterpret_cast<const uint8_t *>(&v), 8);
+      lane2 = crc32c_ref(lane2, reinterpret_cast<const uint8_t *>(&w), 8);
+   }
+   return fmix64_ref(static_cast<uint64_t>(lane1) << 32 | lane2);
+}
+
+static flow_key_v4_t key_v4(uint32_t src, uint32_t dst, uint16_t sport, uint16_t dport)
+{
+   flow_key_v4_t key;
+   memset(&key, 0, sizeof(key));
+   key.src_port = htons(sport);
+   key.dst_port = htons(dport);
+   key.proto = IPPROTO_TCP;
+   key.ip_version = 4;
+   key.src_ip = htonl(src);
+   key.dst_ip = htonl(dst);
+   return key;
+}
+
+static flow_key_v6_t key_v6(uint8_t last_byte)
+{
+   flow_key_v6_t key;
+   memset(&key, 0, sizeof(key));
+   key.src_port = htons(1234);
+   key.dst_port = htons(443);
+   key.proto = IPPROTO_TCP;
+   key.ip_version = 6;
+   key.src_ip[0] = 0x20;
+   key.src_ip[15] = last_byte;
+   key.dst_ip[0] = 0x20;
+   key.dst_ip[15] = 1;
+   return key;
+}
+
+TEST(FlowHash, crc32cReference) {
+   // Check value of CRC32C (Castagnoli) with standard initial and final inversion
+   const char *check = "123456789";
+   EXPECT_EQ(~crc32c_ref(0xFFFFFFFF, reinterpret_cast<const uint8_t *>(check), 9), 0xE3069283u);
+}
+
+TEST(FlowHash, crc32c) {
+   if (flow_hash_get("crc32c") == nullptr) {
+      // CPU without SSE4.2
+      return;
+   }
+   flow_key_v4_t v4 = key_v4(0x0A000001, 0x0A000002, 1234, 80);
+   flow_key_v6_t v6 = key_v6(2);
+   EXPECT_EQ(flow_hash_crc32c(&v4, sizeof(v4)), crc32c_hash_ref(reinterpret_cast<uint8_t *>(&v4), sizeof(v4)));
+   EXPECT_EQ(flow_hash_crc32c(&v6, sizeof(v6)), crc32c_hash_ref(reinterpret_cast<uint8_t *>(&v6), sizeof(v6)));
+
+   std::vector<uint8_t> data(32);
+   for (size_t i = 0; i < data.size(); i++) {
+      data[i] = i * 7 + 1;
+   }
+   for (size_t len = 1; len <= data.size(); len++) {
+      EXPECT_EQ(flow_hash_crc32c(data.data(), len), crc32c_hash_ref(data.data(), len)) << "length " << len;
+   }
+}
+
+TEST(FlowHash, ipv4) {
+   flow_key_v4_t key = key_v4(0x0A000001, 0x0A000002, 1234, 80);
+   EXPECT_EQ(flow_hash_ipv4(&key, sizeof(key)), 0x7C9CA51447BA4CB8ULL);
+
+   uint8_t bytes[sizeof(flow_key_v4_t)];
+   for (size_t i = 0; i < sizeof(bytes); i++) {
+      bytes[i] = i;
+   }
+   EXPECT_EQ(flow_hash_ipv4(bytes, sizeof(bytes)), 0x108F253C501FF140ULL);
+
+   // Keys of other length are hashed by XXH3
+   flow_key_v6_t v6 = key_v6(2);
+   EXPECT_EQ(flow_hash_ipv4(&v6, sizeof(v6)), flow_hash_xxh3(&v6, sizeof(v6)));
+   EXPECT_EQ(flow_hash_ipv4(bytes, sizeof(bytes) - 1), flow_hash_xxh3(bytes, sizeof(bytes) - 1));
+}
+
+TEST(FlowHash, deterministic) {
+   for (auto &name : flow_hash_names()) {
+      flow_hash_t hash = flow_hash_get(name);
+      ASSERT_NE(hash, nullptr) << name;
+
+      flow_key_v4_t a = key_v4(0x0A000001, 0x0A000002, 1234, 80);
+      flow_key_v4_t b = key_v4(0x0A000001, 0x0A000002, 1234, 80);
+      flow_key_v4_t c = key_v4(0x0A000001, 0x0A000002, 1234, 81);
+      EXPECT_EQ(hash(&a, sizeof(a)), hash(&b, sizeof(b))) << name;
+      EXPECT_NE(hash(&a, sizeof(a)), hash(&c, sizeof(c))) << name;
+
+      flow_key_v6_t d = key_v6(2);
+      flow_key_v6_t e = key_v6(2);
+      flow_key_v6_t f = key_v6(3);
+      EXPECT_EQ(hash(&d, sizeof(d)), hash(&e, sizeof(e))) << name;
+      EXPECT_NE(hash(&d, sizeof(d)), hash(&f, sizeof(f))) << name;
+   }
+}
+
+TEST(FlowHash, names) {
+   EXPECT_EQ(flow_hash_default(), "ipv4");
+   EXPECT_EQ(flow_hash_get(""), flow_hash_ipv4);
+   EXPECT_EQ(flow_hash_get("unknown"), nullptr);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+   // invoking the tests
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,430 @@
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+
+#include "gtest/gtest.h"
+
+#include "parser.hpp"
+#include "headers.hpp"
+
+namespace ipxp_test {
+
+using namespace ipxp;
+
+class Parser : public ::testing::Test
+{
+protected:
+   std::vector<uint8_t> m_data;
+   std::vector<uint8_t> m_buffer;
+   Packet m_pkt;
+   PacketBlock m_block;
+   FragmentTable m_frags;
+   uint64_t m_malformed[PARSER_STATUS_CNT] = {};
+   time_t m_time = 0;
+
+   void SetUp() {
+      m_buffer.resize(1600);
+      m_pkt.buffer = m_buffer.data();
+      m_pkt.buffer_size = m_buffer.size();
+      m_block.pkts = &m_pkt;
+      m_block.size = 1;
+   }
+
+   void add8(uint8_t val) { m_data.push_back(val); }
+   void add16(uint16_t val) { add8(val >> 8); add8(val & 0xFF); }
+   void add32(uint32_t val) { add16(val >> 16); add16(val & 0xFFFF); }
+
+   void eth(uint16_t ethertype)
+   {
+      for (int i = 0; i < 12; i++) {
+         add8(i);
+      }
+      add16(ethertype);
+   }
+   void ipv4(uint8_t proto, uint32_t src, uint32_t dst, uint16_t id = 0, uint16_t frag_off = 0)
+   {
+      add8(0x45); add8(0); add16(1000); add16(id); add16(frag_off);
+      add8(64); add8(proto); add16(0);
+      add32(src); add32(dst);
+   }
+   void ipv6(uint8_t next, uint8_t last_byte)
+   {
+      add32(0x60000000); add16(1000); add8(next); add8(64);
+      for (int i = 0; i < 32; i++) {
+         add8(i == 15 || i == 31 ? last_byte : 0);
+      }
+   }
+   void tcp(uint16_t src, uint16_t dst)
+   {
+      add16(src); add16(dst); add32(0); add32(0);
+      add8(0x50); add8(0x02); add16(1024); add32(0);
+   }
+   void udp(uint16_t src, uint16_t dst)
+   {
+      add16(src); add16(dst); add16(8); add16(0);
+   }
+
+   bool parse(uint8_t depth)
+   {
+      parser_opt_t opt = {&m_block, false, false, DLT_EN10MB, false, PAYLOAD_HORIZON_FULL, depth, &m_frags, m_malformed};
+      m_block.cnt = 0;
+      parse_packet(&opt, ts_from_nsec(m_time, 0), m_data.data(), m_data.size(), m_data.size());
+      return m_block.cnt == 1;
+   }
+};
+
+TEST_F(Parser, plain) {
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_TCP, 0x0A000001, 0x0A000002);
+   tcp(1234, 80);
+
+   ASSERT_TRUE(parse(1));
+   EXPECT_EQ(m_pkt.ip_proto, IPPROTO_TCP);
+   EXPECT_EQ(m_pkt.src_port, 1234);
+   EXPECT_EQ(m_pkt.dst_port, 80);
+   EXPECT_EQ(m_pkt.tunnel_depth, 0);
+   EXPECT_EQ(m_pkt.tunnel_type, TUNNEL_NONE);
+}
+
+TEST_F(Parser, vlan) {
+   eth(ETH_P_8021Q);
+   add16(100); add16(ETH_P_IPV6);
+   ipv6(IPPROTO_UDP, 1);
+   udp(5000, 53);
+   add32(0xDEADBEEF);
+
+   ASSERT_TRUE(parse(0));
+   EXPECT_EQ(m_pkt.ethertype, ETH_P_IPV6);
+   EXPECT_EQ(m_pkt.ip_version, IP::v6);
+   EXPECT_EQ(m_pkt.ip_proto, IPPROTO_UDP);
+   EXPECT_EQ(m_pkt.src_ip.v6[15], 1);
+   EXPECT_EQ(m_pkt.src_port, 5000);
+   EXPECT_EQ(m_pkt.dst_port, 53);
+   EXPECT_EQ(m_pkt.tcp_flags, 0);
+   EXPECT_EQ(m_pkt.payload, m_pkt.packet + 18 + 40 + 8);
+
+   // Double tagged frame is handled by the general parser
+   m_data.clear();
+   eth(ETH_P_8021Q);
+   add16(100); add16(ETH_P_8021Q);
+   add16(200); add16(ETH_P_IP);
+   ipv4(IPPROTO_TCP, 0x0A000001, 0x0A000002);
+   tcp(1234, 80);
+
+   ASSERT_TRUE(parse(0));
+   EXPECT_EQ(m_pkt.ethertype, ETH_P_IP);
+   EXPECT_EQ(m_pkt.src_ip.v4, htonl(0x0A000001));
+   EXPECT_EQ(m_pkt.dst_port, 80);
+   EXPECT_EQ(m_pkt.tcp_flags, 0x02);
+}
+
+TEST_F(Parser, vxlan) {
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_UDP, 0x0A000001, 0x0A000002);
+   udp(50000, VXLAN_PORT);
+   add32(0x08000000); add32(42 << 8);
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_TCP, 0xC0A80001, 0xC0A80002);
+   tcp(1234, 443);
+
+   ASSERT_TRUE(parse(0));
+   EXPECT_EQ(m_pkt.ip_proto, IPPROTO_UDP);
+   EXPECT_EQ(m_pkt.dst_port, VXLAN_PORT);
+   EXPECT_EQ(m_pkt.tunnel_depth, 0);
+
+   ASSERT_TRUE(parse(1));
+   EXPECT_EQ(m_pkt.ip_proto, IPPROTO_TCP);
+   EXPECT_EQ(m_pkt.src_ip.v4, htonl(0xC0A80001));
+   EXPECT_EQ(m_pkt.dst_port, 443);
+   EXPECT_EQ(m_pkt.tunnel_depth, 1);
+   EXPECT_EQ(m_pkt.tunnel_type, TUNNEL_VXLAN);
+   EXPECT_EQ(m_pkt.tunnel_id, 42U);
+   EXPECT_EQ(m_pkt.outer_ip_version, IP::v4);
+   EXPECT_EQ(m_pkt.outer_src_ip.v4, htonl(0x0A000001));
+   EXPECT_EQ(m_pkt.outer_dst_ip.v4, htonl(0x0A000002));
+   EXPECT_EQ(m_pkt.payload, m_pkt.packet + m_data.size());
+}
+
+TEST_F(Parser, greKey) {
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_GRE, 0x0A000001, 0x0A000002);
+   add16(GRE_FLAG_KEY); add16(ETH_P_IPV6); add32(7);
+   ipv6(IPPROTO_UDP, 1);
+   udp(53, 5353);
+
+   ASSERT_TRUE(parse(1));
+   EXPECT_EQ(m_pkt.ip_version, IP::v6);
+   EXPECT_EQ(m_pkt.ip_proto, IPPROTO_UDP);
+   EXPECT_EQ(m_pkt.dst_port, 5353);
+   EXPECT_EQ(m_pkt.tunnel_type, TUNNEL_GRE);
+   EXPECT_EQ(m_pkt.tunnel_id, 7U);
+}
+
+TEST_F(Parser, ipip) {
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_IPIP, 0x0A000001, 0x0A000002);
+   ipv4(IPPROTO_TCP, 0xC0A80001, 0xC0A80002);
+   tcp(1234, 22);
+
+   ASSERT_TRUE(parse(0));
+   EXPECT_EQ(m_pkt.ip_proto, IPPROTO_IPIP);
+   EXPECT_EQ(m_pkt.src_port, 0);
+
+   ASSERT_TRUE(parse(1));
+   EXPECT_EQ(m_pkt.ip_proto, IPPROTO_TCP);
+   EXPECT_EQ(m_pkt.dst_ip.v4, htonl(0xC0A80002));
+   EXPECT_EQ(m_pkt.dst_port, 22);
+   EXPECT_EQ(m_pkt.tunnel_type, TUNNEL_IPIP);
+}
+
+TEST_F(Parser, gtpuExtension) {
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_UDP, 0x0A000001, 0x0A000002);
+   udp(GTPU_PORT, GTPU_PORT);
+   add8(0x34); add8(GTPU_TYPE_GPDU); add16(100); add32(0xABCDEF);
+   add16(0); add8(0); add8(0x85);
+   add8(1); add8(0x10); add8(0); add8(0);
+   ipv4(IPPROTO_UDP, 0xC0A80001, 0xC0A80002);
+   udp(1000, 2000);
+
+   ASSERT_TRUE(parse(1));
+   EXPECT_EQ(m_pkt.src_ip.v4, htonl(0xC0A80001));
+   EXPECT_EQ(m_pkt.src_port, 1000);
+   EXPECT_EQ(m_pkt.dst_port, 2000);
+   EXPECT_EQ(m_pkt.tunnel_type, TUNNEL_GTPU);
+   EXPECT_EQ(m_pkt.tunnel_id, 0xABCDEFU);
+}
+
+TEST_F(Parser, geneveOptions) {
+   eth(ETH_P_IPV6);
+   ipv6(IPPROTO_UDP, 1);
+   udp(50000, GENEVE_PORT);
+   add8(2); add8(0); add16(ETH_P_TEB); add32(5 << 8);
+   add32(0); add32(0);
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_TCP, 0xC0A80001, 0xC0A80002);
+   tcp(1234, 8080);
+
+   ASSERT_TRUE(parse(1));
+   EXPECT_EQ(m_pkt.ip_version, IP::v4);
+   EXPECT_EQ(m_pkt.dst_port, 8080);
+   EXPECT_EQ(m_pkt.tunnel_type, TUNNEL_GENEVE);
+   EXPECT_EQ(m_pkt.tunnel_id, 5U);
+   EXPECT_EQ(m_pkt.outer_ip_version, IP::v6);
+   EXPECT_EQ(m_pkt.outer_src_ip.v6[15], 1);
+}
+
+TEST_F(Parser, nestedDepth) {
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_GRE, 0x0A000001, 0x0A000002);
+   add16(0); add16(ETH_P_IP);
+   ipv4(IPPROTO_UDP, 0x0B000001, 0x0B000002);
+   udp(50000, VXLAN_PORT);
+   add32(0x08000000); add32(9 << 8);
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_TCP, 0xC0A80001, 0xC0A80002);
+   tcp(1234, 443);
+
+   ASSERT_TRUE(parse(1));
+   EXPECT_EQ(m_pkt.ip_proto, IPPROTO_UDP);
+   EXPECT_EQ(m_pkt.dst_port, VXLAN_PORT);
+   EXPECT_EQ(m_pkt.tunnel_depth, 1);
+
+   ASSERT_TRUE(parse(2));
+   EXPECT_EQ(m_pkt.ip_proto, IPPROTO_TCP);
+   EXPECT_EQ(m_pkt.dst_port, 443);
+   EXPECT_EQ(m_pkt.tunnel_depth, 2);
+   EXPECT_EQ(m_pkt.tunnel_type, TUNNEL_GRE);
+   EXPECT_EQ(m_pkt.outer_src_ip.v4, htonl(0x0A000001));
+}
+
+TEST_F(Parser, truncatedTunnel) {
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_UDP, 0x0A000001, 0x0A000002);
+   udp(50000, VXLAN_PORT);
+   add32(0x08000000);
+
+   ASSERT_TRUE(parse(1));
+   EXPECT_EQ(m_pkt.ip_proto, IPPROTO_UDP);
+   EXPECT_EQ(m_pkt.dst_port, VXLAN_PORT);
+   EXPECT_EQ(m_pkt.tunnel_depth, 0);
+   EXPECT_EQ(m_pkt.payload_len, 4);
+
+   // Valid tunnel header followed by malformed inner packet
+   add32(1 << 8);
+   add16(0);
+   ASSERT_TRUE(parse(1));
+   EXPECT_EQ(m_pkt.ip_proto, IPPROTO_UDP);
+   EXPECT_EQ(m_pkt.src_ip.v4, htonl(0x0A000001));
+   EXPECT_EQ(m_pkt.tunnel_depth, 0);
+   EXPECT_EQ(m_pkt.payload_len, 10);
+}
+
+
+TEST_F(Parser, headersLongerThanBuffer) {
+   eth(ETH_P_IPV6);
+   ipv6(0, 1); // hop-by-hop options
+   add8(60); add8(31);
+   for (int i = 0; i < 254; i++) {
+      add8(0);
+   }
+   add8(IPPROTO_TCP); add8(31); // destination options
+   for (int i = 0; i < 254; i++) {
+      add8(0);
+   }
+   tcp(1234, 80);
+   for (int i = 0; i < 100; i++) {
+      add8(0xAA);
+   }
+   m_pkt.buffer_size = 300;
+
+   ASSERT_TRUE(parse(0));
+   EXPECT_EQ(m_pkt.ip_proto, IPPROTO_TCP);
+   EXPECT_EQ(m_pkt.dst_port, 80);
+   EXPECT_EQ(m_pkt.packet_len, 299);
+   EXPECT_EQ(m_pkt.payload_len, 0);
+   EXPECT_EQ(m_pkt.payload, m_pkt.packet + m_pkt.packet_len);
+}
+
+TEST_F(Parser, ipv4Fragments) {
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_UDP, 0x0A000001, 0x0A000002, 77, IP_MF);
+   udp(1234, 53);
+   ASSERT_TRUE(parse(0));
+   EXPECT_TRUE(m_pkt.ip_frag);
+   EXPECT_EQ(m_pkt.ip_frag_off, 0);
+   EXPECT_EQ(m_pkt.dst_port, 53);
+
+   m_data.clear();
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_UDP, 0x0A000001, 0x0A000002, 77, 185);
+   add32(0xFFFFFFFF);
+   ASSERT_TRUE(parse(0));
+   EXPECT_TRUE(m_pkt.ip_frag);
+   EXPECT_EQ(m_pkt.ip_frag_off, 1480);
+   EXPECT_EQ(m_pkt.src_port, 1234);
+   EXPECT_EQ(m_pkt.dst_port, 53);
+   EXPECT_EQ(m_pkt.payload_len, 4);
+
+   // Different datagram of the same hosts
+   m_data.clear();
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_UDP, 0x0A000001, 0x0A000002, 78, 185);
+   add32(0xFFFFFFFF);
+   ASSERT_TRUE(parse(0));
+   EXPECT_EQ(m_pkt.src_port, 0);
+   EXPECT_EQ(m_pkt.dst_port, 0);
+}
+
+TEST_F(Parser, ipv6Fragments) {
+   eth(ETH_P_IPV6);
+   ipv6(IPPROTO_FRAGMENT, 1);
+   add8(IPPROTO_TCP); add8(0); add16(1); add32(0x12345678);
+   tcp(1234, 443);
+   ASSERT_TRUE(parse(0));
+   EXPECT_EQ(m_pkt.ip_proto, IPPROTO_TCP);
+   EXPECT_TRUE(m_pkt.ip_frag);
+   EXPECT_EQ(m_pkt.ip_frag_id, 0x12345678U);
+   EXPECT_EQ(m_pkt.dst_port, 443);
+
+   m_data.clear();
+   eth(ETH_P_IPV6);
+   ipv6(IPPROTO_FRAGMENT, 1);
+   add8(IPPROTO_TCP); add8(0); add16(1448); add32(0x12345678);
+   add32(0xFFFFFFFF);
+   ASSERT_TRUE(parse(0));
+   EXPECT_EQ(m_pkt.ip_proto, IPPROTO_TCP);
+   EXPECT_EQ(m_pkt.ip_frag_off, 1448);
+   EXPECT_EQ(m_pkt.src_port, 1234);
+   EXPECT_EQ(m_pkt.dst_port, 443);
+   EXPECT_EQ(m_pkt.tcp_flags, 0);
+}
+
+TEST_F(Parser, fragmentTimeout) {
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_UDP, 0x0A000001, 0x0A000002, 5, IP_MF);
+   udp(1234, 53);
+   ASSERT_TRUE(parse(0));
+
+   m_data.clear();
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_UDP, 0x0A000001, 0x0A000002, 5, 185);
+   m_time = FRAG_TABLE_TIMEOUT + 1;
+   ASSERT_TRUE(parse(0));
+   EXPECT_EQ(m_pkt.dst_port, 0);
+
+   // Tracking disabled
+   m_frags.set_size(0);
+   std::vector<uint8_t> later = m_data;
+   m_data.clear();
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_UDP, 0x0A000001, 0x0A000002, 5, IP_MF);
+   udp(1234, 53);
+   ASSERT_TRUE(parse(0));
+   m_data = later;
+   ASSERT_TRUE(parse(0));
+   EXPECT_EQ(m_pkt.dst_port, 0);
+}
+
+TEST_F(Parser, fragmentTableSize) {
+   // Size is limited, so the number of rows does not overflow
+   m_frags.set_size(UINT32_MAX);
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_UDP, 0x0A000001, 0x0A000002, 5, IP_MF);
+   udp(1234, 53);
+   ASSERT_TRUE(parse(0));
+
+   m_data.clear();
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_UDP, 0x0A000001, 0x0A000002, 5, 185);
+   ASSERT_TRUE(parse(0));
+   EXPECT_EQ(m_pkt.dst_port, 53);
+}
+
+
+TEST_F(Parser, malformedReasons) {
+   eth(ETH_P_IP);
+   add16(0x4500);
+   EXPECT_FALSE(parse(0));
+   EXPECT_EQ(m_malformed[PARSER_TRUNCATED_L3], 1U);
+
+   m_data.clear();
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_TCP, 0x0A000001, 0x0A000002);
+   add32(0);
+   EXPECT_FALSE(parse(0));
+   EXPECT_EQ(m_malformed[PARSER_TRUNCATED_L4], 1U);
+
+   // Data offset points behind captured data
+   m_data.clear();
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_TCP, 0x0A000001, 0x0A000002);
+   tcp(1234, 80);
+   m_data[14 + 20 + 12] = 0xF0;
+   EXPECT_FALSE(parse(0));
+   EXPECT_EQ(m_malformed[PARSER_BAD_HDR_LEN], 1U);
+
+   // Zero length option
+   m_data.clear();
+   eth(ETH_P_IP);
+   ipv4(IPPROTO_TCP, 0x0A000001, 0x0A000002);
+   tcp(1234, 80);
+   m_data[14 + 20 + 12] = 0x60;
+   add8(2); add8(0); add16(0);
+   EXPECT_FALSE(parse(0));
+   EXPECT_EQ(m_malformed[PARSER_BAD_TCP_OPTIONS], 1U);
+
+   m_data.resize(10);
+   EXPECT_FALSE(parse(0));
+   EXPECT_EQ(m_malformed[PARSER_TRUNCATED_L2], 1U);
+   EXPECT_EQ(m_malformed[PARSER_OK], 0U);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+   // invoking the tests
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,384 @@
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "gtest/gtest.h"
+
+#include "pcapfile.hpp"
+#include "trace.hpp"
+#include "parser.hpp"
+#include "headers.hpp"
+
+namespace ipxp_test {
+
+using namespace ipxp;
+
+class PcapFile : public ::testing::Test
+{
+protected:
+   std::string m_dir;
+   std::vector<std::string> m_files;
+   std::vector<uint8_t> m_data;
+   bool m_big = false;
+
+   std::vector<std::vector<uint8_t>> m_buffers;
+   std::vector<Packet> m_pkts;
+   PacketBlock m_block;
+
+   void SetUp() {
+      char tmpl[] = "/tmp/ipxp-pcapfile-XXXXXX";
+      ASSERT_NE(mkdtemp(tmpl), nullptr);
+      m_dir = tmpl;
+
+      m_buffers.resize(8, std::vector<uint8_t>(1600));
+      m_pkts.resize(8);
+      for (size_t i = 0; i < m_pkts.size(); i++) {
+         m_pkts[i].buffer = m_buffers[i].data();
+         m_pkts[i].buffer_size = m_buffers[i].size();
+      }
+      m_block.pkts = m_pkts.data();
+      m_block.size = m_pkts.size();
+   }
+
+   void TearDown() {
+      for (auto &it : m_files) {
+         unlink(it.c_str());
+      }
+      rmdir(m_dir.c_str());
+   }
+
+   void add8(uint8_t val) { m_data.push_back(val); }
+   void add16(uint16_t val)
+   {
+      if (m_big) {
+         add8(val >> 8); add8(val & 0xFF);
+      } else {
+         add8(val & 0xFF); add8(val >> 8);
+      }
+   }
+   void add32(uint32_t val)
+   {
+      if (m_big) {
+         add16(val >> 16); add16(val & 0xFFFF);
+      } else {
+         add16(val & 0xFFFF); add16(val >> 16);
+      }
+   }
+
+   /**
+    * \brief Ethernet frame with IPv4 UDP packet, 42 bytes.
+    */
+   std::vector<uint8_t> frame(uint32_t src, uint32_t dst, uint16_t sport, uint16_t dport)
+   {
+      std::vector<uint8_t> f(12, 0);
+      auto be16 = [&f](uint16_t v) { f.push_back(v >> 8); f.push_back(v & 0xFF); };
+      auto be32 = [&be16](uint32_t v) { be16(v >> 16); be16(v & 0xFFFF); };
+      be16(ETH_P_IP);
+      be16(0x4500); be16(28); be32(0); be16(0x4011); be16(0);
+      be32(src); be32(dst);
+      be16(sport); be16(dport); be16(8); be16(0);
+      return f;
+   }
+
+   void pcap_header(uint32_t magic, uint32_t linktype = DLT_EN10MB)
+   {
+      add32(magic); add16(2); add16(4); add32(0); add32(0); add32(65535); add32(linktype);
+   }
+   void pcap_record(uint32_t sec, uint32_t frac, const std::vector<uint8_t> &f)
+   {
+      add32(sec); add32(frac); add32(f.size()); add32(f.size());
+      m_data.insert(m_data.end(), f.begin(), f.end());
+   }
+
+   void ng_block(uint32_t type, const std::vector<uint8_t> &body)
+   {
+      uint32_t len = 12 + ((body.size() + 3) & ~3);
+      add32(type); add32(len);
+      m_data.insert(m_data.end(), body.begin(), body.end());
+      m_data.resize(m_data.size() + len - 12 - body.size(), 0);
+      add32(len);
+   }
+   std::vector<uint8_t> body(const std::function<void()> &fill)
+   {
+      std::vector<uint8_t> tmp;
+      tmp.swap(m_data);
+      fill();
+      tmp.swap(m_data);
+      return tmp;
+   }
+   void ng_section()
+   {
+      ng_block(0x0A0D0D0A, body([this](){ add32(0x1A2B3C4D); add16(1); add16(0); add32(0xFFFFFFFF); add32(0xFFFFFFFF); }));
+   }
+   void ng_interface(int tsresol = -1)
+   {
+      ng_block(1, body([this, tsresol](){
+         add16(DLT_EN10MB); add16(0); add32(65535);
+         if (tsresol >= 0) {
+            add16(9); add16(1); add8(tsresol); add8(0); add16(0);
+         }
+         add16(0); add16(0);
+      }));
+   }
+   void ng_packet(uint32_t ifc, uint64_t ts, const std::vector<uint8_t> &f)
+   {
+      ng_block(6, body([&](){
+         add32(ifc); add32(ts >> 32); add32(ts & 0xFFFFFFFF); add32(f.size()); add32(f.size());
+         m_data.insert(m_data.end(), f.begin(), f.end());
+      }));
+   }
+
+   std::string write(const std::string &name)
+   {
+      std::string path = m_dir + "/" + name;
+      FILE *fp = fopen(path.c_str(), "wb");
+      fwrite(m_data.data(), 1, m_data.size(), fp);
+      fclose(fp);
+      m_files.push_back(path);
+      m_data.clear();
+      return path;
+   }
+
+   std::vector<Packet> read_all(InputPlugin &reader)
+   {
+      std::vector<Packet> res;
+      InputPlugin::Result ret;
+      while ((ret = reader.get(m_block)) != InputPlugin::Result::END_OF_FILE) {
+         for (size_t i = 0; i < m_block.cnt; i++) {
+            res.push_back(m_pkts[i]);
+         }
+      }
+      return res;
+   }
+};
+
+TEST_F(PcapFile, pcapUsec) {
+   pcap_header(0xA1B2C3D4);
+   pcap_record(100, 250000, frame(0x0A000001, 0x0A000002, 1000, 53));
+   pcap_record(101, 5, frame(0x0A000002, 0x0A000001, 53, 1000));
+
+   PcapFileReader reader;
+   reader.init(("file=" + write("usec.pcap")).c_str());
+   auto pkts = read_all(reader);
+   ASSERT_EQ(pkts.size(), 2u);
+   EXPECT_EQ(pkts[0].ts, ts_from_usec(100, 250000));
+   EXPECT_EQ(pkts[1].ts, ts_from_usec(101, 5));
+   EXPECT_EQ(pkts[0].src_port, 1000);
+   EXPECT_EQ(pkts[1].src_port, 53);
+   EXPECT_EQ(reader.m_seen, 2u);
+}
+
+TEST_F(PcapFile, pcapNsecSwapped) {
+   m_big = true;
+   pcap_header(0xA1B23C4D);
+   pcap_record(100, 123456789, frame(0x0A000001, 0x0A000002, 1000, 53));
+
+   PcapFileReader reader;
+   reader.init(("file=" + write("nsec.pcap")).c_str());
+   auto pkts = read_all(reader);
+   ASSERT_EQ(pkts.size(), 1u);
+   EXPECT_EQ(pkts[0].ts, ts_from_nsec(100, 123456789));
+   EXPECT_EQ(pkts[0].dst_port, 53);
+}
+
+TEST_F(PcapFile, rawIp) {
+   // Link type from pcap headers and the one assigned by tcpdump.org
+   for (uint32_t linktype : {static_cast<uint32_t>(DLT_RAW), 101u}) {
+      std::vector<uint8_t> f = frame(0x0A000001, 0x0A000002, 1000, 53);
+      f.erase(f.begin(), f.begin() + 14);
+      pcap_header(0xA1B2C3D4, linktype);
+      pcap_record(100, 0, f);
+
+      PcapFileReader reader;
+      reader.init(("file=" + write("raw" + std::to_string(linktype) + ".pcap")).c_str());
+      auto pkts = read_all(reader);
+      ASSERT_EQ(pkts.size(), 1u);
+      EXPECT_EQ(pkts[0].ethertype, ETH_P_IP);
+      EXPECT_EQ(pkts[0].src_ip.v4, htonl(0x0A000001));
+      EXPECT_EQ(pkts[0].dst_port, 53);
+      EXPECT_EQ(reader.m_parsed, 1u);
+   }
+}
+
+TEST_F(PcapFile, sll) {
+   std::vector<uint8_t> f = frame(0x0A000001, 0x0A000002, 1000, 53);
+   // Replace Ethernet header with cooked header of an outgoing Ethernet packet
+   std::vector<uint8_t> sll = {0, 4, 0, ARPHRD_ETHER, 0, 6, 2, 0, 0, 0, 0, 1, 0, 0, ETH_P_IP >> 8, ETH_P_IP & 0xFF};
+   f.erase(f.begin(), f.begin() + 14);
+   f.insert(f.begin(), sll.begin(), sll.end());
+   pcap_header(0xA1B2C3D4, DLT_LINUX_SLL);
+   pcap_record(100, 0, f);
+
+   PcapFileReader reader;
+   reader.init(("file=" + write("sll.pcap")).c_str());
+   auto pkts = read_all(reader);
+   ASSERT_EQ(pkts.size(), 1u);
+   EXPECT_EQ(pkts[0].ethertype, ETH_P_IP);
+   EXPECT_EQ(pkts[0].src_mac[0], 2);
+   EXPECT_EQ(pkts[0].src_mac[5], 1);
+   EXPECT_EQ(pkts[0].src_port, 1000);
+   EXPECT_EQ(reader.m_parsed, 1u);
+}
+
+TEST_F(PcapFile, pcapng) {
+   for (bool big : {false, true}) {
+      m_big = big;
+      ng_section();
+      ng_interface();
+      ng_interface(9);
+      ng_block(0x80000001, {1, 2, 3, 4}); // custom block is skipped
+      ng_packet(0, 100000001ULL, frame(0x0A000001, 0x0A000002, 1000, 53));
+      ng_packet(1, 100000000002ULL, frame(0x0A000002, 0x0A000001, 53, 1000));
+      ng_block(3, body([this](){
+         auto f = frame(0x0A000003, 0x0A000004, 1, 2);
+         add32(f.size());
+         m_data.insert(m_data.end(), f.begin(), f.end());
+      }));
+
+      PcapFileReader reader;
+      reader.init(("file=" + write(big ? "be.pcapng" : "le.pcapng")).c_str());
+      auto pkts = read_all(reader);
+      ASSERT_EQ(pkts.size(), 3u);
+      EXPECT_EQ(pkts[0].ts, ts_from_usec(100, 1));
+      EXPECT_EQ(pkts[1].ts, ts_from_nsec(100, 2));
+      // Simple packet block has no timestamp
+      EXPECT_EQ(pkts[2].ts, pkts[1].ts);
+      EXPECT_EQ(pkts[2].dst_port, 2);
+   }
+}
+
+TEST_F(PcapFile, directory) {
+   pcap_header(0xA1B2C3D4);
+   pcap_record(2, 0, frame(0x0A000001, 0x0A000002, 2, 2));
+   write("b.pcap");
+   ng_section();
+   ng_interface();
+   ng_packet(0, 1000000, frame(0x0A000001, 0x0A000002, 1, 1));
+   write("a.pcapng");
+
+   PcapFileReader reader;
+   reader.init(("file=" + m_dir).c_str());
+   auto pkts = read_all(reader);
+   ASSERT_EQ(pkts.size(), 2u);
+   EXPECT_EQ(pkts[0].src_port, 1);
+   EXPECT_EQ(pkts[1].src_port, 2);
+}
+
+TEST_F(PcapFile, split) {
+   pcap_header(0xA1B2C3D4);
+   for (uint32_t i = 0; i < 64; i++) {
+      pcap_record(i, 0, frame(0x0A000000 + i, 0x0B000000 + i, 1000, 53));
+      pcap_record(i, 1, frame(0x0B000000 + i, 0x0A000000 + i, 53, 1000));
+   }
+   std::string file = write("split.pcap");
+
+   PcapFileReader parser;
+   auto params = parser.expand(("file=" + file + ";pipelines=3").c_str());
+   ASSERT_EQ(params.size(), 3u);
+
+   std::set<uint32_t> hosts;
+   size_t total = 0;
+   for (auto &it : params) {
+      PcapFileReader reader;
+      reader.init(it.c_str());
+      auto pkts = read_all(reader);
+      EXPECT_GT(pkts.size(), 0u);
+      std::set<uint32_t> local;
+      for (auto &pkt : pkts) {
+         local.insert(ntohl(pkt.src_ip.v4) & 0xFF);
+      }
+      for (auto &host : local) {
+         // Both directions of each flow are read by the same pipeline
+         EXPECT_EQ(hosts.count(host), 0u);
+      }
+      hosts.insert(local.begin(), local.end());
+      EXPECT_EQ(pkts.size(), 2 * local.size());
+      total += pkts.size();
+   }
+   EXPECT_EQ(total, 128u);
+   EXPECT_EQ(hosts.size(), 64u);
+}
+
+TEST_F(PcapFile, loop) {
+   pcap_header(0xA1B2C3D4);
+   pcap_record(100, 0, frame(0x0A000001, 0x0A000002, 1000, 53));
+   pcap_record(101, 0, frame(0x0A000002, 0x0A000001, 53, 1000));
+   pcap_record(102, 0, frame(0x0A000001, 0x0A000002, 1000, 53));
+
+   PcapFileReader reader;
+   reader.init(("file=" + write("loop.pcap") + ";loop=3").c_str());
+   auto pkts = read_all(reader);
+   ASSERT_EQ(pkts.size(), 9u);
+   for (size_t i = 1; i < pkts.size(); i++) {
+      // Next loop follows the previous one with average gap between packets
+      EXPECT_EQ(pkts[i].ts, pkts[i - 1].ts + NANO_SEC);
+   }
+}
+
+TEST_F(PcapFile, pps) {
+   pcap_header(0xA1B2C3D4);
+   for (uint32_t i = 0; i < 20; i++) {
+      pcap_record(100, i, frame(0x0A000001, 0x0A000002, 1000, 53));
+   }
+
+   PcapFileReader reader;
+   reader.init(("file=" + write("pps.pcap") + ";pps=200").c_str());
+   uint64_t start = clock_monotonic();
+   auto pkts = read_all(reader);
+   EXPECT_EQ(pkts.size(), 20u);
+   EXPECT_GE(clock_monotonic() - start, 90 * NANO_SEC / 1000);
+}
+
+TEST_F(PcapFile, traceLoops) {
+   pcap_header(0xA1B2C3D4);
+   pcap_record(100, 0, frame(0x0A000001, 0x0A000002, 1000, 53));
+   pcap_record(101, 0, frame(0x0A000002, 0x0A000001, 53, 1000));
+
+   TraceReader reader;
+   reader.init(("file=" + write("trace.pcap") + ";loops=3;duration=0").c_str());
+   auto pkts = read_all(reader);
+   ASSERT_EQ(pkts.size(), 6u);
+   EXPECT_EQ(pkts[0].src_ip.v4, htonl(0x0A000001));
+   EXPECT_EQ(pkts[4].ts, ts_from_nsec(104, 0));
+   for (size_t loop = 1; loop < 3; loop++) {
+      const Packet &fwd = pkts[2 * loop];
+      const Packet &rev = pkts[2 * loop + 1];
+      // Addresses differ from previous loops, both directions are rewritten the same way
+      EXPECT_NE(fwd.src_ip.v4, pkts[0].src_ip.v4);
+      EXPECT_NE(fwd.src_ip.v4, pkts[2 * loop - 2].src_ip.v4);
+      EXPECT_EQ(fwd.src_ip.v4, rev.dst_ip.v4);
+      EXPECT_EQ(fwd.dst_ip.v4, rev.src_ip.v4);
+      EXPECT_EQ(fwd.payload_len, pkts[0].payload_len);
+   }
+}
+
+TEST_F(PcapFile, invalid) {
+   pcap_header(0xA1B2C3D4);
+   pcap_record(1, 0, frame(0x0A000001, 0x0A000002, 1000, 53));
+   m_data.resize(m_data.size() - 10);
+   PcapFileReader truncated;
+   truncated.init(("file=" + write("truncated.pcap")).c_str());
+   EXPECT_THROW(read_all(truncated), PluginError);
+
+   pcap_header(0xA1B2C3D4, 105);
+   PcapFileReader linktype;
+   EXPECT_THROW(linktype.init(("file=" + write("wlan.pcap")).c_str()), PluginError);
+
+   add32(0x12345678);
+   PcapFileReader format;
+   EXPECT_THROW(format.init(("file=" + write("text.pcap")).c_str()), PluginError);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+   // invoking the tests
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,132 @@
+#include <cstring>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "gtest/gtest.h"
+
+#include <ipfixprobe/ring.h>
+#include <ipfixprobe/packet.hpp>
+#include "cache.hpp"
+#include "basicplus.hpp"
+#include "bstats.hpp"
+#include "idpcontent.hpp"
+#include "ovpn.hpp"
+#include "phists.hpp"
+#include "pstats.hpp"
+#include "ssdp.hpp"
+
+namespace ipxp_test {
+
+using namespace ipxp;
+
+class Reload : public ::testing::Test {
+protected:
+   void SetUp() override
+   {
+      m_queue = ipx_ring_init(64, false);
+      ASSERT_NE(m_queue, nullptr);
+      m_cache.set_queue(m_queue);
+      m_cache.init("");
+      memset(m_data, 'A', sizeof(m_data));
+   }
+
+   void TearDown() override
+   {
+      m_cache.close();
+      ipx_ring_destroy(m_queue);
+      for (auto &it : m_plugins) {
+         it->close();
+         delete it;
+      }
+   }
+
+   Packet packet(uint16_t sport, uint16_t dport, bool reply, timestamp_t ts)
+   {
+      Packet pkt;
+      pkt.ts = ts;
+      pkt.ip_version = IP::v4;
+      pkt.ip_proto = IPPROTO_UDP;
+      pkt.ip_ttl = 64;
+      pkt.src_ip.v4 = htonl(reply ? 0x0A000002 : 0x0A000001);
+      pkt.dst_ip.v4 = htonl(reply ? 0x0A000001 : 0x0A000002);
+      pkt.src_port = reply ? dport : sport;
+      pkt.dst_port = reply ? sport : dport;
+      pkt.packet = m_data;
+      pkt.packet_len = sizeof(m_data);
+      pkt.packet_len_wire = sizeof(m_data);
+      pkt.payload = m_data + 42;
+      pkt.payload_len = sizeof(m_data) - 42;
+      pkt.payload_len_wire = pkt.payload_len;
+      pkt.ip_len = sizeof(m_data) - 14;
+      pkt.ip_payload_len = pkt.ip_len - 20;
+      pkt.source_pkt = !reply;
+      return pkt;
+   }
+
+   void put(uint16_t sport, uint16_t dport, timestamp_t ts)
+   {
+      for (int i = 0; i < 4; i++) {
+         Packet pkt = packet(sport, dport, i % 2, ts + i * 1000000);
+         m_cache.put_pkt(pkt);
+      }
+   }
+
+   template<class T>
+   void load(T *plugin)
+   {
+      plugin->init("");
+      m_plugins.push_back(plugin);
+   }
+
+   ipx_ring_t *m_queue;
+   NHTFlowCache m_cache;
+   std::vector<ProcessPlugin *> m_plugins;
+   uint8_t m_data[200];
+};
+
+TEST_F(Reload, flowsCreatedBeforeReload) {
+   // Flows in cache were created without plugins
+   put(1000, 1900, 1000000000ULL);
+   put(1001, 2000, 1000000000ULL);
+
+   load(new BASICPLUSPlugin());
+   load(new BSTATSPlugin());
+   load(new IDPCONTENTPlugin());
+   load(new OVPNPlugin());
+   load(new PHISTSPlugin());
+   load(new PSTATSPlugin());
+   load(new SSDPPlugin());
+   m_cache.set_plugins(m_plugins);
+
+   put(1000, 1900, 2000000000ULL);
+   put(1001, 2000, 2000000000ULL);
+   put(1002, 1900, 2000000000ULL);
+   static_cast<StoragePlugin &>(m_cache).finish();
+
+   unsigned flows = 0;
+   Flow *flow;
+   while ((flow = static_cast<Flow *>(ipx_ring_pop(m_queue))) != nullptr) {
+      flows++;
+
+      bool created_after = flow->src_port == 1002;
+      EXPECT_EQ(flow->src_packets + flow->dst_packets, created_after ? 4U : 8U);
+      EXPECT_EQ(flow->get_extension(RecordExtPSTATS::REGISTERED_ID) != nullptr, created_after);
+      EXPECT_EQ(flow->get_extension(RecordExtPHISTS::REGISTERED_ID) != nullptr, created_after);
+      EXPECT_EQ(flow->get_extension(RecordExtIDPCONTENT::REGISTERED_ID) != nullptr, created_after);
+      EXPECT_EQ(flow->get_extension(RecordExtBSTATS::REGISTERED_ID) != nullptr, created_after);
+      EXPECT_EQ(flow->get_extension(RecordExtBASICPLUS::REGISTERED_ID) != nullptr, created_after);
+      EXPECT_EQ(flow->get_extension(RecordExtOVPN::REGISTERED_ID) != nullptr, created_after);
+      EXPECT_EQ(flow->get_extension(RecordExtSSDP::REGISTERED_ID) != nullptr, created_after);
+   }
+   EXPECT_EQ(flows, 3U);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+   // invoking the tests
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -44,35 +44,81 @@
 #include <unistd.h>
 #include <sys/time.h>
 
+#include <ipfixprobe/clock.hpp>
+
 #include "workers.hpp"
 #include "ipfixprobe.hpp"
 
 namespace ipxp {
 
+/**
+ * \brief Replace processing plugins of storage plugin when update is pending.
+ *
+ * Called by worker between packet blocks, where no plugin is running.
+ */
+static inline void update_plugins(StoragePlugin *cache, PluginsUpdate *plugins_update)
+{
+   std::vector<ProcessPlugin *> *plugins = plugins_update->load(std::memory_order_relaxed);
+   if (plugins != nullptr && plugins_update->compare_exchange_strong(plugins, nullptr)) {
+      cache->set_plugins(*plugins);
+   }
+}
+
 #define MICRO_SEC 1000000L
 
+static void load_input_counters(InputStats &stats, const InputPlugin *plugin)
+{
+   stats.packets = plugin->m_seen;
+   stats.parsed = plugin->m_parsed;
+   stats.dropped = plugin->m_dropped;
+   stats.malformed_l2 = plugin->m_malformed[PARSER_TRUNCATED_L2];
+   stats.malformed_l3 = plugin->m_malformed[PARSER_TRUNCATED_L3];
+   stats.malformed_l4 = plugin->m_malformed[PARSER_TRUNCATED_L4];
+   stats.malformed_tcp_opt = plugin->m_malformed[PARSER_BAD_TCP_OPTIONS];
+   stats.malformed_hdr_len = plugin->m_malformed[PARSER_BAD_HDR_LEN];
+}
+
+/**
+ * \brief Pass packets and flows aggregated by input plugin to storage plugin.
+ * \param [in] ts Timestamp of the last packet of previous blocks.
+ * \return Timestamp of the last packet.
+ */
+static timestamp_t put_block(StoragePlugin *cache, PacketBlock *block, timestamp_t ts)
+{
+   for (unsigned i = 0; i < block->cnt; i++) {
+      cache->put_pkt(block->pkts[i]);
+   }
+   for (size_t i = 0; i < block->flow_cnt; i++) {
+      cache->put_flow(block->flows[i]);
+   }
+   return block->cnt ? block->pkts[block->cnt - 1].ts : ts;
+}
+
 void input_worker(InputPlugin *plugin, PacketBlock *pkts, size_t block_cnt, uint64_t pkt_limit, ipx_ring_t *queue,
-                  std::promise<WorkerResult> *out, std::atomic<InputStats> *out_stats)
+                  QueuePolicy policy, std::promise<WorkerResult> *out, std::atomic<InputStats> *out_stats)
 {
-   struct timespec start;
-   struct timespec end;
+   uint64_t start;
    size_t i = 0;
    InputPlugin::Result ret;
-   InputStats stats = {0, 0, 0, 0, 0};
+   InputStats stats = {};
    WorkerResult res = {false, ""};
-   while (!terminate_input) {
+   bool flush = false;
+   while (1) {
       PacketBlock *block = &pkts[i];
       block->cnt = 0;
       block->bytes = 0;
+      block->flow_cnt = 0;
 
-      if (pkt_limit && plugin->m_parsed + block->size >= pkt_limit) {
+      // After termination the plugin passes data it holds until end of file is returned
+      flush = flush || terminate_input;
+      if (!flush && pkt_limit && plugin->m_parsed + block->size >= pkt_limit) {
          if (plugin->m_parsed >= pkt_limit) {
             break;
          }
          block->size = pkt_limit - plugin->m_parsed;
       }
       try {
-         ret = plugin->get(*block);
+         ret = flush ? plugin->flush(*block) : plugin->get(*block);
       } catch (PluginError &e) {
          res.error = true;
          res.msg = e.what();
@@ -82,25 +128,22 @@ void input_worker(InputPlugin *plugin, PacketBlock *pkts, size_t block_cnt, uint
          usleep(1);
          continue;
       } else if (ret == InputPlugin::Result::PARSED) {
-         stats.packets = plugin->m_seen;
-         stats.parsed = plugin->m_parsed;
-         stats.dropped = plugin->m_dropped;
+         load_input_counters(stats, plugin);
          stats.bytes += block->bytes;
-#ifdef __linux__
-         const clockid_t clk_id = CLOCK_MONOTONIC_COARSE;
-#else
-         const clockid_t clk_id = CLOCK_MONOTONIC;
-#endif
-         clock_gettime(clk_id, &start);
-         ipx_ring_push(queue, static_cast<void *>(block));
-         clock_gettime(clk_id, &end);
-
-         int64_t time = end.tv_nsec - start.tv_nsec;
-         if (start.tv_sec != end.tv_sec) {
-            time += 1000000000;
+         if (ipx_ring_try_push(queue, static_cast<void *>(block))) {
+            i = (i + 1) % block_cnt;
+         } else if (policy == QueuePolicy::DROP) {
+            // Block is reused for next packets, packets of aggregated flows are counted too
+            stats.qdropped += block->cnt;
+            for (size_t j = 0; j < block->flow_cnt; j++) {
+               stats.qdropped += block->flows[j].src_packets + block->flows[j].dst_packets;
+            }
+         } else {
+            start = clock_monotonic_precise();
+            ipx_ring_push(queue, static_cast<void *>(block));
+            stats.qtime += clock_monotonic_precise() - start;
+            i = (i + 1) % block_cnt;
          }
-         stats.qtime += time;
-         i = (i + 1) % block_cnt;
 
          out_stats->store(stats);
       } else if (ret == InputPlugin::Result::ERROR) {
@@ -112,58 +155,138 @@ void input_worker(InputPlugin *plugin, PacketBlock *pkts, size_t block_cnt, uint
       }
    }
 
-   stats.packets = plugin->m_seen;
-   stats.parsed = plugin->m_parsed;
-   stats.dropped = plugin->m_dropped;
+   load_input_counters(stats, plugin);
    out_stats->store(stats);
    out->set_value(res);
 }
 
-void storage_worker(StoragePlugin *cache, ipx_ring_t *queue, std::promise<WorkerResult> *out)
+void storage_worker(StoragePlugin *cache, ipx_ring_t *queue, PluginsUpdate *plugins_update, std::promise<WorkerResult> *out,
+                    std::atomic<StorageStats> *out_stats)
 {
    WorkerResult res = {false, ""};
+   StorageStats stats = {0, 0};
    bool timeout = false;
-   struct timeval ts = {0, 0};
-   struct timespec begin = {0, 0};
-   struct timespec end = {0, 0};
-#ifdef __linux__
-   const clockid_t clk_id = CLOCK_MONOTONIC_COARSE;
-#else
-   const clockid_t clk_id = CLOCK_MONOTONIC;
-#endif
+   timestamp_t ts = 0;
+   uint64_t begin = 0;
    while (1) {
+      update_plugins(cache, plugins_update);
       PacketBlock *block = static_cast<PacketBlock *>(ipx_ring_pop(queue));
       if (block) {
          try {
-            for (unsigned i = 0; i < block->cnt; i++) {
-               cache->put_pkt(block->pkts[i]);
-            }
-            ts = block->pkts[block->cnt - 1].ts;
+            ts = put_block(cache, block, ts);
          } catch (PluginError &e) {
             res.error = true;
             res.msg = e.what();
             break;
          }
          timeout = false;
+         stats.qtime = cache->m_qtime;
+         stats.dropped = cache->m_qdropped;
+         out_stats->store(stats);
       } else if (terminate_storage && !ipx_ring_cnt(queue)) {
          break;
       } else {
-         clock_gettime(clk_id, &end);
+         uint64_t now = clock_monotonic();
          if (!timeout) {
             timeout = true;
-            begin = end;
+            begin = now;
+         }
+         cache->export_expired(ts_sec(ts + (now - begin)));
+         usleep(1);
+      }
+   }
+
+   cache->finish();
+   stats.qtime = cache->m_qtime;
+   stats.dropped = cache->m_qdropped;
+   out_stats->store(stats);
+   auto outq = cache->get_queue();
+   while (ipx_ring_cnt(outq)) {
+      usleep(1);
+   }
+   out->set_value(res);
+}
+
+/**
+ * \brief Run-to-completion worker, input and storage plugins are called from the same thread.
+ *
+ * Packets are read into a single working block which is passed directly to the storage plugin,
+ * so no input queue is needed between the plugins.
+ */
+void rtc_worker(InputPlugin *plugin, StoragePlugin *cache, PacketBlock *block, uint64_t pkt_limit,
+                PluginsUpdate *plugins_update, std::promise<WorkerResult> *out, std::atomic<InputStats> *out_stats,
+                std::atomic<StorageStats> *out_storage_stats)
+{
+   InputPlugin::Result ret;
+   InputStats stats = {};
+   StorageStats storage_stats = {0, 0};
+   WorkerResult res = {false, ""};
+   bool timeout = false;
+   timestamp_t ts = 0;
+   uint64_t begin = 0;
+   bool flush = false;
+   while (1) {
+      update_plugins(cache, plugins_update);
+      block->cnt = 0;
+      block->bytes = 0;
+      block->flow_cnt = 0;
+
+      // After termination the plugin passes data it holds until end of file is returned
+      flush = flush || terminate_input;
+      if (!flush && pkt_limit && plugin->m_parsed + block->size >= pkt_limit) {
+         if (plugin->m_parsed >= pkt_limit) {
+            break;
          }
-         struct timespec diff = {end.tv_sec - begin.tv_sec, end.tv_nsec - begin.tv_nsec};
-         if (diff.tv_nsec < 0) {
-            diff.tv_nsec += 1000000000;
-            diff.tv_sec--;
+         block->size = pkt_limit - plugin->m_parsed;
+      }
+      try {
+         ret = flush ? plugin->flush(*block) : plugin->get(*block);
+      } catch (PluginError &e) {
+         res.error = true;
+         res.msg = e.what();
+         break;
+      }
+      if (ret == InputPlugin::Result::TIMEOUT) {
+         uint64_t now = clock_monotonic();
+         if (!timeout) {
+            timeout = true;
+            begin = now;
          }
-         cache->export_expired(ts.tv_sec + diff.tv_sec);
+         cache->export_expired(ts_sec(ts + (now - begin)));
          usleep(1);
+         continue;
+      } else if (ret == InputPlugin::Result::PARSED) {
+         load_input_counters(stats, plugin);
+         stats.bytes += block->bytes;
+         out_stats->store(stats);
+
+         try {
+            ts = put_block(cache, block, ts);
+         } catch (PluginError &e) {
+            res.error = true;
+            res.msg = e.what();
+            break;
+         }
+         timeout = false;
+         storage_stats.qtime = cache->m_qtime;
+         storage_stats.dropped = cache->m_qdropped;
+         out_storage_stats->store(storage_stats);
+      } else if (ret == InputPlugin::Result::ERROR) {
+         res.error = true;
+         res.msg = "error occured during reading";
+         break;
+      } else if (ret == InputPlugin::Result::END_OF_FILE) {
+         break;
       }
    }
 
+   load_input_counters(stats, plugin);
+   out_stats->store(stats);
+
    cache->finish();
+   storage_stats.qtime = cache->m_qtime;
+   storage_stats.dropped = cache->m_qdropped;
+   out_storage_stats->store(storage_stats);
    auto outq = cache->get_queue();
    while (ipx_ring_cnt(outq)) {
       usleep(1);
@@ -194,10 +317,10 @@ void output_worker(OutputPlugin *exp, ipx_ring_t *queue, std::promise<WorkerResu
    }
 
    // Rate limiting algorithm from https://github.com/CESNET/ipfixcol2/blob/master/src/tools/ipfixsend/sender.c#L98
-   gettimeofday(&begin, nullptr);
+   clock_realtime(&begin);
    last_flush = begin;
    while (1) {
-      gettimeofday(&end, nullptr);
+      clock_realtime(&end);
 
       Flow *flow = static_cast<Flow *>(ipx_ring_pop(queue));
       if (!flow) {
@@ -252,7 +375,7 @@ void output_worker(OutputPlugin *exp, ipx_ring_t *queue, std::promise<WorkerResu
 
       if (pkts_from_begin >= fps) {
          // Restart counter
-         gettimeofday(&begin, nullptr);
+         clock_realtime(&begin);
          pkts_from_begin = 0;
       }
    }
@@ -65,6 +65,8 @@ struct WorkerResult {
    std::string msg;
 };
 
+typedef std::atomic<std::vector<ProcessPlugin *> *> PluginsUpdate;
+
 struct WorkPipeline {
    struct {
       InputPlugin *plugin;
@@ -77,6 +79,8 @@ struct WorkPipeline {
       std::thread *thread;
       std::promise<WorkerResult> *promise;
       std::vector<ProcessPlugin *> plugins;
+      PluginsUpdate *plugins_update;
+      std::atomic<StorageStats> *stats;
    } storage;
    ipx_ring_t *queue;
 };
@@ -90,8 +94,12 @@ struct OutputWorker {
 };
 
 void input_worker(InputPlugin *plugin, PacketBlock *pkts, size_t block_cnt, uint64_t pkt_limit, ipx_ring_t *queue,
-      std::promise<WorkerResult> *out, std::atomic<InputStats> *out_stats);
-void storage_worker(StoragePlugin *cache, ipx_ring_t *queue, std::promise<WorkerResult> *out);
+      QueuePolicy policy, std::promise<WorkerResult> *out, std::atomic<InputStats> *out_stats);
+void storage_worker(StoragePlugin *cache, ipx_ring_t *queue, PluginsUpdate *plugins_update, std::promise<WorkerResult> *out,
+      std::atomic<StorageStats> *out_stats);
+void rtc_worker(InputPlugin *plugin, StoragePlugin *cache, PacketBlock *block, uint64_t pkt_limit,
+      PluginsUpdate *plugins_update, std::promise<WorkerResult> *out, std::atomic<InputStats> *out_stats,
+      std::atomic<StorageStats> *out_storage_stats);
 void output_worker(OutputPlugin *exp, ipx_ring_t *queue, std::promise<WorkerResult> *out, std::atomic<OutputStats> *out_stats,
       uint32_t fps);
 